@@ -263,6 +263,12 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to point to the given SyncedMemory, which
+   *        must hold at least count() elements -- used by Net to let blobs
+   *        whose lifetimes do not overlap share memory.
+   */
+  void ShareData(const shared_ptr<SyncedMemory>& data);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -1,6 +1,7 @@
 #ifndef CAFFE_COMMON_HPP_
 #define CAFFE_COMMON_HPP_
 
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -166,6 +167,14 @@ class Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+  // The number of threads of parallel_for, shared by all the threads of the
+  // process. It is initially $CAFFE_CPU_THREADS or 1; 0 means one per
+  // hardware thread.
+  static int cpu_threads();
+  static void set_cpu_threads(int threads);
+  // The minimum number of elements a thread of parallel_for works on.
+  static int parallel_grain_size();
+  static void set_parallel_grain_size(int size);
 
  protected:
 #ifndef CPU_ONLY
@@ -188,6 +197,20 @@ class Caffe {
   DISABLE_COPY_AND_ASSIGN(Caffe);
 };
 
+/**
+ * @brief Calls body(begin, end) for consecutive ranges covering [0, n) in
+ *        parallel in Caffe::cpu_threads() threads, and returns when all of
+ *        them are done.
+ *
+ * Each of the n items is item_size elements of work; the range of a thread
+ * has at least Caffe::parallel_grain_size() elements, so small arrays, one
+ * thread or calls from the tasks of a ThreadPool (including those of another
+ * parallel_for) run body(0, n) in the calling thread. The threads are those
+ * of OpenMP if Caffe is compiled with it, else of a ThreadPool.
+ */
+void parallel_for(int n, const boost::function<void(int, int)>& body,
+    int item_size = 1);
+
 }  // namespace caffe
 
 #endif  // CAFFE_COMMON_HPP_
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
 
 namespace caffe {
 
@@ -37,6 +38,19 @@ class DataTransformer {
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation to a DatumView, which reads the
+   * pixels directly from the serialized record. Encoded records are not
+   * supported, use a Datum for them.
+   *
+   * @param datum
+   *    DatumView containing the data to be transformed.
+   * @param transformed_blob
+   *    This is destination blob. It can be part of top blob's data if
+   *    set_cpu_data() is used. See data_layer.cpp for an example.
+   */
+  void Transform(const DatumView& datum, Blob<Dtype>* transformed_blob);
+
   /**
    * @brief Applies the transformation defined in the data layer's
    * transform_param block to a vector of Datum.
@@ -90,6 +104,23 @@ class DataTransformer {
    */
   void Transform(Blob<Dtype>* input_blob, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the label_transform defined in the data layer's
+   * transform_param block to the float_data labels of a Datum.
+   *
+   * @param datum
+   *    Datum containing the labels in its float_data field.
+   * @param label_dim
+   *    The number of labels to transform. Must match the number of
+   *    label_transform entries, unless there are none at all.
+   * @param transformed_label
+   *    Destination of the label_dim transformed labels.
+   */
+  void TransformLabel(const Datum& datum, const int label_dim,
+                      Dtype* transformed_label);
+  void TransformLabel(const DatumView& datum, const int label_dim,
+                      Dtype* transformed_label);
+
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -98,6 +129,7 @@ class DataTransformer {
    *    Datum containing the data to be transformed.
    */
   vector<int> InferBlobShape(const Datum& datum);
+  vector<int> InferBlobShape(const DatumView& datum);
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -139,6 +171,17 @@ class DataTransformer {
   virtual int Rand(int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  // Transforms an image given either as uint8 data or as float_data (data
+  // is NULL then), which is shared by Datum and DatumView.
+  void Transform(const int datum_channels, const int datum_height,
+      const int datum_width, const uint8_t* data, const float* float_data,
+      Dtype* transformed_data);
+  void CheckBlobShape(const int datum_channels, const int datum_height,
+      const int datum_width, const Blob<Dtype>* transformed_blob) const;
+  void TransformLabel(const float* labels, const int size,
+      const int label_dim, Dtype* transformed_label);
+  vector<int> InferBlobShape(const int datum_channels, const int datum_height,
+      const int datum_width);
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -147,6 +190,12 @@ class DataTransformer {
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
+  vector<Dtype> label_scale_;
+  vector<Dtype> label_shift_;
+  vector<Dtype> label_min_;
+  vector<Dtype> label_max_;
+  // uint8 Datum are transformed by the vectorized kernel (no crop or mirror)
+  bool uint8_fast_path_;
 };
 
 }  // namespace caffe
@@ -10,6 +10,7 @@
 #include "caffe/layer_factory.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 /**
  Forward declare boost::thread instead of including boost/thread.hpp
@@ -291,6 +292,16 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Lets the layer take its temporary buffers from a workspace shared
+   *        with the other layers of a Net, unless the share_workspace of its
+   *        layer_param is false. Call before SetUp.
+   */
+  inline void set_workspace(const shared_ptr<Workspace>& workspace) {
+    if (layer_param_.share_workspace()) {
+      workspace_ = workspace;
+    }
+  }
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -305,6 +316,8 @@ class Layer {
   /** The vector that indicates whether each top blob has a non-zero weight in
    *  the objective function. */
   vector<Dtype> loss_;
+  /** The workspace shared with the other layers of the Net, if any. */
+  shared_ptr<Workspace> workspace_;
 
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
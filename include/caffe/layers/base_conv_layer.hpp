@@ -1,18 +1,32 @@
 #ifndef CAFFE_BASE_CONVOLUTION_LAYER_HPP_
 #define CAFFE_BASE_CONVOLUTION_LAYER_HPP_
 
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/conv_algorithms.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 /**
  * @brief Abstract base class that factors out the BLAS code common to
  *        ConvolutionLayer and DeconvolutionLayer.
+ *
+ * The groups of a convolution are computed one after the other with the
+ * columns of one group, so the column buffer has the size of one group.
+ * With several cpu_threads, the forward pass runs the groups of the images
+ * in parallel. In a Net, the column buffers and workspaces come from the
+ * workspace shared by the layers, unless the layer opts out.
+ *
+ * Convolutions with an NHWC input_layout read the columns of the CPU forward
+ * pass directly from the interleaved channels; they have no backward pass
+ * and no GPU implementation.
  */
 template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
@@ -31,15 +45,36 @@ class BaseConvolutionLayer : public Layer<Dtype> {
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
-  // we just called weight_cpu_gemm with the same input.
+  // we just called weight_cpu_gemm with the same input (without groups, since
+  // the column buffer holds one group). With the TILED cpu_algorithm,
+  // backward_cpu_gemm and weight_cpu_gemm use column tiles instead of the
+  // column buffer.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  /// @brief Computes the output of the num_ images of the input, with the
+  ///        bias (unless it is NULL) and the fused ReLU. The images run in
+  ///        parallel with the cpu_threads of the convolution_param, with the
+  ///        algorithm of its cpu_algorithm.
+  void forward_cpu_batch(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, Dtype* output);
+  /// @brief Adds the bias (unless it is NULL) and applies the fused ReLU of
+  ///        the relu_param in one pass over the output channels
+  ///        [begin, end).
+  void forward_cpu_bias_relu(Dtype* output, const Dtype* bias, int begin,
+      int end);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  /// @brief Whether forward_cpu_quantized is used, in the TEST phase with a
+  ///        reduced precision of the quantization_param.
+  bool use_quantized_weights() const;
+  /// @brief Like forward_cpu_gemm, but with reduced precision weights, which
+  ///        are quantized at the first call and after the weights changed.
+  void forward_cpu_quantized(const Dtype* input, const Dtype* weights,
+      Dtype* output);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -70,7 +105,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   Blob<int> pad_;
   /// @brief The spatial dimensions of the dilation.
   Blob<int> dilation_;
-  /// @brief The spatial dimensions of the convolution input.
+  /// @brief The channels of a group and the spatial dimensions of the
+  ///        convolution input.
   Blob<int> conv_input_shape_;
   /// @brief The spatial dimensions of the col_buffer.
   vector<int> col_buffer_shape_;
@@ -92,12 +128,57 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief Whether the input is NHWC, see the input_layout of the
+  ///        convolution_param.
+  bool nhwc_input_;
 
  private:
-  // wrap im2col/col2im so we don't have to remember the (long) argument lists
+  void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
+      Dtype* output, Dtype* col_buffer, bool skip_im2col);
+  // computes the output channels of the group g of one image with the
+  // columns of the group in col_buffer
+  void forward_cpu_group(const Dtype* input, const Dtype* weights,
+      Dtype* output, Dtype* col_buffer, int g, bool skip_im2col);
+  // computes image n of forward_cpu_batch with the buffers[thread]
+  void forward_cpu_image(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, Dtype* output, const vector<Dtype*>& buffers,
+      int n, int thread);
+  // computes the group task % group_ of the image task / group_ of
+  // forward_cpu_batch with the buffers[thread], including its bias
+  void forward_cpu_image_group(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, Dtype* output, const vector<Dtype*>& buffers,
+      int task, int thread);
+  // sets up the cpu_algorithm_ for the weights and returns the buffers of
+  // the threads
+  vector<Dtype*> prepare_cpu_algorithm(const Dtype* weights, int threads);
+  // sets the buffers to workspaces of size values
+  void prepare_workspaces(int size, vector<Dtype*>* buffers);
+  // the values of the workspace of a thread of forward_cpu_batch, for
+  // AUTOTUNE the largest one of the algorithms it measures
+  int cpu_workspace_size() const;
+  // the column buffer of one group, from the shared workspace_ if there is
+  // one
+  Dtype* col_buffer_cpu();
+#ifndef CPU_ONLY
+  Dtype* col_buffer_gpu();
+#endif
+  // measures the algorithms with the first image and selects the fastest
+  void autotune_cpu_algorithm(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  string cpu_algorithm_key() const;
+
+  // wrap im2col/col2im so we don't have to remember the (long) argument lists;
+  // they convert the input channels of one group
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
-    if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      im2col_cpu(data, conv_in_channels_,
+    if (nhwc_input_) {
+      im2col_hwc_cpu(data, conv_in_channels_ / group_, conv_in_channels_,
+          conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+          kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+          pad_.cpu_data()[0], pad_.cpu_data()[1],
+          stride_.cpu_data()[0], stride_.cpu_data()[1],
+          dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
+      im2col_cpu(data, conv_in_channels_ / group_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
@@ -111,7 +192,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   }
   inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      col2im_cpu(col_buff, conv_in_channels_,
+      col2im_cpu(col_buff, conv_in_channels_ / group_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
@@ -126,7 +207,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 #ifndef CPU_ONLY
   inline void conv_im2col_gpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      im2col_gpu(data, conv_in_channels_,
+      im2col_gpu(data, conv_in_channels_ / group_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
@@ -141,7 +222,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   }
   inline void conv_col2im_gpu(const Dtype* col_buff, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
-      col2im_gpu(col_buff, conv_in_channels_,
+      col2im_gpu(col_buff, conv_in_channels_ / group_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
           kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
           pad_.cpu_data()[0], pad_.cpu_data()[1],
@@ -162,11 +243,34 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int conv_in_channels_;
   int conv_out_spatial_dim_;
   int kernel_dim_;
-  int col_offset_;
+  // the offset of the input of a group: the channels of a group of an NHWC
+  // input follow each other in each pixel
+  int input_offset_;
   int output_offset_;
+  // the shape of an NHWC input in the NCHW order, for bottom_shape_
+  vector<int> nchw_bottom_shape_;
 
+  // the shape of the column buffer, and its memory without a workspace_
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // the weights of each group of forward_cpu_quantized, and the weights they
+  // are derived from
+  vector<QuantizedMatrix<Dtype> > quantized_weights_;
+  SyncedMemoryVersion derived_weights_;
+  // the threads of forward_cpu_batch (if there are several) and the column
+  // buffers of all but the first one without a workspace_
+  shared_ptr<ThreadPool> thread_pool_;
+  vector<shared_ptr<Blob<Dtype> > > thread_col_buffers_;
+  // the algorithm of forward_cpu_batch, AUTOTUNE until it is measured
+  ConvolutionParameter::CPUAlgorithm cpu_algorithm_;
+  Conv2DShape conv_2d_shape_;
+  // the WINOGRAD forward pass, and the weights it transformed
+  WinogradConvolution<Dtype> winograd_;
+  SyncedMemoryVersion winograd_weights_;
+  // the TILED forward pass, and the backward pass if it is the algorithm
+  TiledConvolution<Dtype> tiled_;
+  // the workspaces of the threads of WINOGRAD and TILED without a workspace_
+  vector<vector<Dtype> > thread_workspaces_;
 };
 
 }  // namespace caffe
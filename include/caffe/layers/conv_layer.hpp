@@ -26,6 +26,11 @@ namespace caffe {
  *   inputs so that the im2col matrix has a column for each input region to
  *   be filtered. col2im restores the output spatial structure by rolling up
  *   the output channel N' columns of the output matrix.
+ *
+ *   In the TEST phase on the CPU, the filters can have the reduced precision
+ *   of the quantization_param; they are quantized at the first forward pass.
+ *   With a relu_param, a ReLU is applied to the output on the CPU (inference
+ *   only, see caffe/util/fuse_layers.hpp).
  */
 template <typename Dtype>
 class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
@@ -9,9 +9,10 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/dataset_cache.hpp"
+#include "caffe/util/datum_view.hpp"
 #include "caffe/util/db.hpp"
-
-#include <random>
+#include "caffe/util/philox.hpp"
 
 namespace caffe {
 
@@ -32,12 +33,33 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   void Next();
   bool Skip();
+  void Read(Datum* datum);
+  bool ReadView(DatumView* datum);
+  void SyncCursor();
+  void ReadWindow(vector<const Datum*>* window);
+  const Datum& ReadFrame(int64_t key);
+  vector<int> WindowShape(const vector<int>& frame_shape, int batch_size);
   virtual void load_batch(Batch<Dtype>* batch);
 
   shared_ptr<db::DB> db_;
   shared_ptr<db::Cursor> cursor_;
   uint64_t offset_;
-  std::mt19937 RandomGenerator;
+  // the skips of the random order, seeded from the Caffe RNG
+  Philox RandomGenerator;
+  // optional shared memory cache of decoded records
+  shared_ptr<DatasetCache> cache_;
+  // numeric key of the current record, the cursor is only moved to it when
+  // it is not cached
+  int64_t current_key_;
+  int64_t last_key_;
+  bool cursor_synced_;
+  // temporal windows: the last decoded frames, the slot of a frame is its key
+  // modulo the window span
+  int frames_;
+  int frame_stride_;
+  int64_t first_key_;
+  vector<Datum> ring_;
+  vector<int64_t> ring_keys_;
 };
 
 }  // namespace caffe
@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/packed_matrix.hpp"
+#include "caffe/util/quantize.hpp"
 
 namespace caffe {
 
@@ -13,6 +15,14 @@ namespace caffe {
  * @brief Also known as a "fully-connected" layer, computes an inner product
  *        with a set of learned weights, and (optionally) adds biases.
  *
+ * In the TEST phase on the CPU, the weights can have the reduced precision of
+ * the quantization_param; they are quantized at the first forward pass, and
+ * again after the weights changed. With pack_weights, float weights are
+ * packed the same way for the products of small batches (see
+ * caffe/util/packed_matrix.hpp).
+ * With a relu_param, a ReLU is applied to the output on the CPU (inference
+ * only, see caffe/util/fuse_layers.hpp).
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -45,6 +55,10 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  QuantizedMatrix<Dtype> quantized_weights_;
+  PackedMatrix<Dtype> packed_weights_;
+  // the weights the quantized or packed weights are derived from
+  SyncedMemoryVersion derived_weights_;
 };
 
 }  // namespace caffe
@@ -6,12 +6,22 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
+ * With an lrn_param, an LRN across channels is applied to each pooled image on
+ * the CPU (inference only, see caffe/util/fuse_layers.hpp).
+ *
+ * On the CPU, the max and average pooling without a mask (max pooling with
+ * store_mask off and a single top, and average pooling) pool the rows of a
+ * window first and then the columns of the pooled rows, in loops the
+ * compiler vectorizes, specialized for the 3x3 and 2x2 kernels of stride 2
+ * and the 3x3 kernels of stride 1.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -43,6 +53,21 @@ class PoolingLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief Pools the planes [task * task_planes, (task + 1) * task_planes)
+  ///        of the planes of the batch; with the fused LRN, task_planes is
+  ///        the number of channels and the LRN is applied to the image.
+  void forward_cpu_task(const Dtype* bottom_data, Dtype* top_data,
+      Dtype* top_mask, int* mask, int planes, int task_planes, int task,
+      int thread);
+  /// @brief Max pools one plane, storing the index of each max in top_mask
+  ///        or mask.
+  void max_pool_plane_masked(const Dtype* input, Dtype* output,
+      Dtype* top_mask, int* mask);
+  /// @brief Max or average pools one plane without mask, row needs
+  ///        (pooled_width_ - 1) * stride_w_ + kernel_w_ values.
+  void pool_plane(const Dtype* input, Dtype* output, Dtype* row);
+  /// @brief Applies the fused LRN of the lrn_param to one pooled image.
+  void lrn_forward_cpu(Dtype* data);
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
@@ -53,6 +78,9 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  shared_ptr<ThreadPool> thread_pool_;
+  // the row buffer of each thread for pool_plane
+  vector<vector<Dtype> > row_buffers_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,48 @@
+#ifndef CAFFE_REORDER_LAYER_HPP_
+#define CAFFE_REORDER_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Changes the layout of a 4D blob of images between NCHW and NHWC,
+ *        as set by the reorder_param, e.g. for an Input layer of interleaved
+ *        images (see caffe/util/insert_reorders.hpp).
+ *
+ * The shape of the top is the shape of the bottom in the order of the top
+ * layout. The images are transposed in parallel with parallel_for; on the
+ * GPU, the layer uses the CPU implementation.
+ */
+template <typename Dtype>
+class ReorderLayer : public Layer<Dtype> {
+ public:
+  explicit ReorderLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "Reorder"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Each image of the bottom is a rows_ x cols_ matrix, which is transposed;
+  // if the layouts are the same, the blob is copied.
+  int num_;
+  int rows_;
+  int cols_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_REORDER_LAYER_HPP_
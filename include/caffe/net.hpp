@@ -214,6 +214,10 @@ class Net {
   bool has_layer(const string& layer_name) const;
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
+  /// @brief The temporary memory shared by the layers, NULL without the
+  ///        share_workspace of the NetParameter.
+  inline const shared_ptr<Workspace>& workspace() const { return workspace_; }
+
   void set_debug_info(const bool value) { debug_info_ = value; }
 
   // Helpers for Init.
@@ -266,6 +270,11 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Let blobs whose lifetimes in Forward do not overlap share memory.
+  void PlanMemory();
+  /// @brief Give the blobs shared by PlanMemory their own memory back.
+  void ReleaseMemoryPlan();
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -330,6 +339,15 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether PlanMemory lets the blobs share memory.
+  bool optimize_memory_;
+  /// The memory shared by the blobs, and for each blob the index of its
+  /// shared memory (-1 if none) and its own memory.
+  vector<shared_ptr<SyncedMemory> > shared_memory_;
+  vector<int> blob_shared_memory_;
+  vector<shared_ptr<SyncedMemory> > blob_own_memory_;
+  /// The temporary buffers of the layers.
+  shared_ptr<Workspace> workspace_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
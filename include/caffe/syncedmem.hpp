@@ -3,11 +3,8 @@
 
 #include <cstdlib>
 
-#ifdef USE_MKL
-  #include "mkl.h"
-#endif
-
 #include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 namespace caffe {
 
@@ -16,35 +13,33 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// Otherwise the current HostAllocator allocates the memory, which must be
+// freed by the same allocator.
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+    HostAllocator** allocator) {
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
     *use_cuda = true;
+    *allocator = NULL;
     return;
   }
 #endif
-#ifdef USE_MKL
-  *ptr = mkl_malloc(size ? size:1, 64);
-#else
-  *ptr = malloc(size);
-#endif
+  *allocator = GetHostAllocator();
+  *ptr = (*allocator)->Allocate(size);
   *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, size_t size, bool use_cuda,
+    HostAllocator* allocator) {
 #ifndef CPU_ONLY
   if (use_cuda) {
     CUDA_CHECK(cudaFreeHost(ptr));
     return;
   }
 #endif
-#ifdef USE_MKL
-  mkl_free(ptr);
-#else
-  free(ptr);
-#endif
+  allocator->Free(ptr, size);
 }
 
 
@@ -68,6 +63,9 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /// @brief Counts the accesses which may change the data (mutable_*_data
+  ///        and set_*_data).
+  size_t version() const { return version_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -84,12 +82,30 @@ class SyncedMemory {
   SyncedHead head_;
   bool own_cpu_data_;
   bool cpu_malloc_use_cuda_;
+  HostAllocator* cpu_allocator_;
   bool own_gpu_data_;
   int device_;
+  size_t version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
 
+/**
+ * @brief Remembers a SyncedMemory and its version, to tell when data derived
+ *        from it (e.g. packed or quantized weights) has to be derived again.
+ */
+class SyncedMemoryVersion {
+ public:
+  SyncedMemoryVersion() : version_(0) {}
+  /// @brief Returns whether memory is another one or may have changed since
+  ///        the last call, and remembers its current version.
+  bool Update(const shared_ptr<SyncedMemory>& memory);
+
+ private:
+  shared_ptr<SyncedMemory> memory_;
+  size_t version_;
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_SYNCEDMEM_HPP_
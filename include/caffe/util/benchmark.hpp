@@ -3,6 +3,8 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <vector>
+
 #include "caffe/util/device_alternate.hpp"
 
 namespace caffe {
@@ -47,6 +49,17 @@ class CPUTimer : public Timer {
   virtual float MicroSeconds();
 };
 
+/// @brief Statistics of repeated time measurements, e.g. in ms.
+struct TimeStats {
+  double mean;
+  double median;
+  /// the 99th percentile (nearest rank)
+  double p99;
+};
+
+/// @brief Returns the statistics of the given times, zero if there are none.
+TimeStats GetTimeStats(std::vector<double> times);
+
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_BENCHMARK_H_
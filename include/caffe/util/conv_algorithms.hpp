@@ -0,0 +1,160 @@
+#ifndef CAFFE_UTIL_CONV_ALGORITHMS_HPP_
+#define CAFFE_UTIL_CONV_ALGORITHMS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief The geometry of the 2D convolution of one image (C x H x W) with
+///        the weights (num_output x channels / group x kernel_h x kernel_w).
+struct Conv2DShape {
+  int channels;
+  int height;
+  int width;
+  int num_output;
+  int group;
+  int kernel_h;
+  int kernel_w;
+  int pad_h;
+  int pad_w;
+  int stride_h;
+  int stride_w;
+  int dilation_h;
+  int dilation_w;
+
+  int output_h() const {
+    return (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) /
+        stride_h + 1;
+  }
+  int output_w() const {
+    return (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) /
+        stride_w + 1;
+  }
+  /// @brief Describes the shape, e.g. as the key of ConvAlgorithmCache.
+  string ToString() const;
+};
+
+/**
+ * @brief Computes the convolution of one image without the bias, by
+ *        accumulating the input rows times each weight into the output
+ *        rows, which needs no column buffer.
+ *
+ * The rows of stride 1 convolutions are contiguous, so the inner loop is
+ * vectorized by the compiler. With many channels it is slower than GEMM.
+ */
+template <typename Dtype>
+void conv_direct_cpu(const Conv2DShape& shape, const Dtype* input,
+    const Dtype* weights, Dtype* output);
+
+/**
+ * @brief The Winograd F(2x2, 3x3) convolution of one image without the bias,
+ *        for 3x3 kernels with stride 1 and no dilation.
+ *
+ * Each 4x4 input tile gives 2x2 outputs with 16 instead of 36
+ * multiplications, done as 16 GEMMs of the transformed weights with the
+ * transformed tiles. The results differ from the direct convolution by
+ * rounding errors of a few times the float epsilon relative to the inputs.
+ */
+template <typename Dtype>
+class WinogradConvolution {
+ public:
+  WinogradConvolution() {}
+
+  static bool Supports(const Conv2DShape& shape);
+  /// @brief The number of values of the workspace of Forward for a shape.
+  static int WorkspaceSize(const Conv2DShape& shape);
+
+  /// @brief Transforms the weights, which must be set again after changes.
+  void SetWeights(const Conv2DShape& shape, const Dtype* weights);
+  /// @brief The number of values of the workspace of Forward.
+  int workspace_size() const;
+  /// @brief Computes the output of one image; threads can compute images in
+  ///        parallel with their own workspace.
+  void Forward(const Dtype* input, Dtype* output, Dtype* workspace) const;
+
+ private:
+  Conv2DShape shape_;
+  int tiles_h_;
+  int tiles_w_;
+  // the 16 transformed weight matrices of each group
+  vector<Dtype> weights_;
+
+  DISABLE_COPY_AND_ASSIGN(WinogradConvolution);
+};
+
+/**
+ * @brief The GEMM convolution of one image with tiles of the column buffer:
+ *        the columns of a few output rows, which fit in the L2 cache, are
+ *        computed and multiplied in turn, for the forward and the backward
+ *        pass.
+ *
+ * The workspace holds one tile instead of the columns of a whole group
+ * (e.g. 193 KB instead of 4.7 MB for the 11x11 kernels of the DeepDriving
+ * conv1), and the GEMMs read each tile while it is in the cache. The GEMMs
+ * write the output rows of a tile in place. Convolutions with 1x1 kernels,
+ * stride 1 and no padding multiply the input directly.
+ */
+template <typename Dtype>
+class TiledConvolution {
+ public:
+  TiledConvolution() : tile_rows_(0) {}
+
+  void SetShape(const Conv2DShape& shape);
+  /// @brief The number of values of the workspace of the passes.
+  int workspace_size() const;
+  /// @brief Computes the output of one image; threads can compute images in
+  ///        parallel with their own workspace.
+  void Forward(const Dtype* input, const Dtype* weights, Dtype* output,
+      Dtype* workspace) const;
+  /// @brief Computes the gradient of one image from the gradient of its
+  ///        output, overwriting input_diff.
+  void Backward(const Dtype* output_diff, const Dtype* weights,
+      Dtype* input_diff, Dtype* workspace) const;
+  /// @brief Adds the gradient of the weights of one image to weight_diff.
+  void WeightGradient(const Dtype* input, const Dtype* output_diff,
+      Dtype* weight_diff, Dtype* workspace) const;
+
+ private:
+  bool is_1x1() const;
+  int kernel_dim() const;
+  // returns the columns of the output rows [begin, end) of the group g of
+  // the input, computed in the workspace, and the distance of their rows
+  const Dtype* tile_columns(const Dtype* input, int g, int begin, int end,
+      Dtype* workspace, int* ld) const;
+
+  Conv2DShape shape_;
+  // the output rows of a tile
+  int tile_rows_;
+
+  DISABLE_COPY_AND_ASSIGN(TiledConvolution);
+};
+
+/**
+ * @brief Remembers the fastest CPUAlgorithm of the convolution shapes
+ *        autotuned by Convolution layers.
+ *
+ * If the environment variable CAFFE_CONV_ALGORITHM_CACHE names a file, the
+ * results are read from it and appended to it, so later processes skip the
+ * autotuning; otherwise they are kept for the current process. The keys
+ * contain the Platform(), since the file may be shared by other machines or
+ * builds.
+ */
+class ConvAlgorithmCache {
+ public:
+  /// @brief Describes the BLAS library and the widest vector instruction set
+  ///        of the CPU, e.g. "cblas_AVX2".
+  static string Platform();
+  /// @brief Returns whether the algorithm of the key is known.
+  static bool Find(const string& key,
+      ConvolutionParameter::CPUAlgorithm* algorithm);
+  static void Store(const string& key,
+      ConvolutionParameter::CPUAlgorithm algorithm);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CONV_ALGORITHMS_HPP_
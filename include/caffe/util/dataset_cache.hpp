@@ -0,0 +1,92 @@
+#ifndef CAFFE_UTIL_DATASET_CACHE_HPP_
+#define CAFFE_UTIL_DATASET_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A size limited cache of decoded uint8 records (image and float_data
+ *        labels) in System V shared memory.
+ *
+ * All DatasetCache objects which are created for the same source, also in
+ * other processes, attach to the same memory segment. The first one creates
+ * and initializes it, the others only attach. Thus the train and test net of
+ * one solver as well as parallel jobs on one machine read each record only
+ * once from the database.
+ *
+ * Records are identified by their numeric key (the "%08d" keys of
+ * torcs_record). The cache is organized in sets of a few slots each, a record
+ * is stored in the set given by its key and replaces the least recently used
+ * slot of this set. Each set is protected by its own process-shared mutex.
+ * The segment is removed when the last DatasetCache using it is destroyed.
+ *
+ * The segment records the path, the size and the modification time of the
+ * database. A segment of another database (whose path gives the same ftok
+ * key) or of a rebuilt one is replaced, as well as a segment which no
+ * process is attached to any more (left behind by a crashed process).
+ */
+class DatasetCache {
+ public:
+  /**
+   * @param source
+   *    The path of the database, which identifies the shared memory segment.
+   * @param size
+   *    The maximal size of the cache in bytes, rounded up to one set.
+   * @param example
+   *    A record of the database, all records must have the same shape.
+   * @param label_dim
+   *    The number of float_data labels which are cached per record.
+   */
+  DatasetCache(const string& source, size_t size, const Datum& example,
+      int label_dim);
+  ~DatasetCache();
+
+  /// @brief Copies the cached record to datum; returns false if not cached.
+  bool Get(int64_t key, Datum* datum);
+  /// @brief Stores a record, evicting the least recently used one of its set.
+  void Put(int64_t key, const Datum& datum);
+
+  /// @brief Returns true if this object created the shared memory segment.
+  bool created() const { return created_; }
+  /// @brief The number of records, which fit into the cache.
+  int capacity() const;
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Header;
+  struct Set;
+  struct Slot;
+
+  static size_t PayloadOffset(int num_sets, int ways);
+  void Map();
+  void Initialize(const Datum& example, int label_dim, int num_sets,
+      uint64_t source_hash, uint64_t source_size, int64_t source_mtime);
+  void WaitForInitialization();
+  void Lock(Set* set);
+  Set* GetSet(int64_t key);
+  Slot* GetSlot(Set* set, int way);
+  uint8_t* GetPayload(Slot* slot);
+
+  int shm_id_;
+  char* memory_;
+  Header* header_;
+  Set* sets_;
+  Slot* slots_;
+  uint8_t* payloads_;
+  bool created_;
+  uint64_t hits_;
+  uint64_t misses_;
+
+  DISABLE_COPY_AND_ASSIGN(DatasetCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATASET_CACHE_HPP_
@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_DATUM_VIEW_HPP_
+#define CAFFE_UTIL_DATUM_VIEW_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A read-only Datum, which is decoded from its wire format without
+ *        copying the image bytes.
+ *
+ * data() points into the serialized buffer, e.g. the value of a database
+ * cursor (see db::Cursor::value_data), so the buffer must stay valid and
+ * unchanged as long as the view is used. Only the float_data labels are
+ * copied, since they are not stored contiguously in the wire format.
+ */
+class DatumView {
+ public:
+  DatumView() { Clear(); }
+
+  /// @brief Decodes a serialized Datum; returns false if it is malformed.
+  bool Parse(const void* buffer, size_t size);
+  /// @brief Copies the view into a Datum.
+  void ToDatum(Datum* datum) const;
+
+  int channels() const { return channels_; }
+  int height() const { return height_; }
+  int width() const { return width_; }
+  int label() const { return label_; }
+  bool encoded() const { return encoded_; }
+  const uint8_t* data() const { return data_; }
+  size_t data_size() const { return data_size_; }
+  int float_data_size() const { return float_data_.size(); }
+  float float_data(int index) const { return float_data_[index]; }
+  const float* float_data() const {
+    return float_data_.empty() ? NULL : &float_data_[0];
+  }
+
+ private:
+  void Clear();
+
+  int channels_;
+  int height_;
+  int width_;
+  int label_;
+  bool encoded_;
+  const uint8_t* data_;
+  size_t data_size_;
+  vector<float> float_data_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATUM_VIEW_HPP_
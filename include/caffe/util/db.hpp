@@ -16,10 +16,15 @@ class Cursor {
   virtual ~Cursor() { }
   virtual void SeekToFirst() = 0;
   virtual void SeekToLast() = 0;
+  // Moves to the first key which is not smaller than the given one.
+  virtual void Seek(const string& key) = 0;
   virtual void Next() = 0;
   virtual void Next(int KeyDiff) = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  // Points to the value without copying it. The memory belongs to the
+  // database and is only valid until the cursor is moved.
+  virtual void value_data(const void** data, size_t* size) = 0;
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
@@ -21,6 +21,7 @@ class LevelDBCursor : public Cursor {
   ~LevelDBCursor() { delete iter_; }
   virtual void SeekToFirst() { iter_->SeekToFirst(); }
   virtual void SeekToLast() { iter_->SeekToLast(); }
+  virtual void Seek(const string& key) { iter_->Seek(leveldb::Slice(key)); }
 
   virtual void Next(int KeyDiff)
   {
@@ -41,6 +42,11 @@ class LevelDBCursor : public Cursor {
 
   virtual string key() { return iter_->key().ToString(); }
   virtual string value() { return iter_->value().ToString(); }
+  virtual void value_data(const void** data, size_t* size) {
+    const leveldb::Slice value = iter_->value();
+    *data = value.data();
+    *size = value.size();
+  }
   virtual bool valid() { return iter_->Valid(); }
 
  private:
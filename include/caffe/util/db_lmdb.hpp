@@ -2,12 +2,14 @@
 #ifndef CAFFE_UTIL_DB_LMDB_HPP
 #define CAFFE_UTIL_DB_LMDB_HPP
 
+#include <cstdlib>
 #include <string>
 #include <vector>
 
 #include "lmdb.h"
 
 #include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
 
 namespace caffe { namespace db {
 
@@ -27,8 +29,15 @@ class LMDBCursor : public Cursor {
   }
   virtual void SeekToFirst() { Seek(MDB_FIRST); }
   virtual void SeekToLast() { Seek(MDB_LAST); }
+  virtual void Seek(const string& key) {
+    mdb_key_.mv_size = key.size();
+    mdb_key_.mv_data = const_cast<char*>(key.data());
+    Seek(MDB_SET_RANGE);
+  }
   virtual void Next() { Seek(MDB_NEXT); }
-  virtual void Next(int KeyDiff) { Next(); CHECK(false) << "Next(Diff) is not implemented yet!"; }
+  virtual void Next(int KeyDiff) {
+    Seek(format_int(std::atoi(key().c_str()) + KeyDiff, 8));
+  }
   virtual string key() {
     return string(static_cast<const char*>(mdb_key_.mv_data), mdb_key_.mv_size);
   }
@@ -36,6 +45,11 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
         mdb_value_.mv_size);
   }
+  virtual void value_data(const void** data, size_t* size) {
+    // points into the read-only memory map
+    *data = mdb_value_.mv_data;
+    *size = mdb_value_.mv_size;
+  }
   virtual bool valid() { return valid_; }
 
  private:
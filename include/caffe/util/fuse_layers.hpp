@@ -0,0 +1,31 @@
+#ifndef CAFFE_UTIL_FUSE_LAYERS_HPP_
+#define CAFFE_UTIL_FUSE_LAYERS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Copies the NetParameter of an inference (TEST) net with layers
+ *        fused for the CPU, so their outputs are not written and read again:
+ *  - BatchNorm and Scale layers after a Convolution or InnerProduct layer are
+ *    folded into its weights and bias,
+ *  - a ReLU after them is applied by the layer as its relu_param, together
+ *    with the bias,
+ *  - an LRN across channels after a Pooling layer is applied by the Pooling
+ *    layer as its lrn_param, to each image right after pooling it.
+ * A layer is only fused into the previous one if it is the only consumer of
+ * its output. The fused layers have no backward pass and no GPU
+ * implementation.
+ *
+ * The layer blobs are taken from the layer of the same name in weights (like
+ * Net::CopyTrainedLayersFrom) or else from param; param_fused contains them,
+ * so a Net created from it needs no further weights. Layers without float
+ * blobs (e.g. with quantized weights) are not folded.
+ */
+void FuseLayers(const NetParameter& param, const NetParameter& weights,
+    NetParameter* param_fused);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSE_LAYERS_HPP_
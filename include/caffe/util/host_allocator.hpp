@@ -0,0 +1,73 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace caffe {
+
+/// @brief Statistics of a HostAllocator; sizes are in bytes.
+struct HostAllocatorStats {
+  HostAllocatorStats()
+      : allocations(0), pool_hits(0), system_allocations(0), bytes_in_use(0),
+        peak_bytes_in_use(0), bytes_cached(0) {}
+
+  /// calls of Allocate
+  size_t allocations;
+  /// allocations served from memory freed before
+  size_t pool_hits;
+  /// allocations that requested memory from the system
+  size_t system_allocations;
+  /// the allocated memory, including the rounding to the size classes
+  size_t bytes_in_use;
+  size_t peak_bytes_in_use;
+  /// freed memory kept for later allocations
+  size_t bytes_cached;
+};
+
+/**
+ * @brief Allocates the host memory of SyncedMemory (unless it is pinned
+ *        memory for the GPU).
+ *
+ * The available allocators are
+ *  - "malloc": every allocation goes to the system,
+ *  - "pool": freed memory is kept in pools of size classes (at most 25%
+ *    larger than the requested size) and reused, which avoids allocator and
+ *    page fault costs when blobs are reshaped back and forth,
+ *  - "pool_hugepages": like "pool", but allocations of 2 MB and more are
+ *    mapped with transparent huge pages (on Linux).
+ * All memory is aligned to 64 bytes. The pools keep at most
+ * CAFFE_HOST_POOL_MAX_MB (default 1024) MB of freed memory.
+ * The allocators are thread safe.
+ */
+class HostAllocator {
+ public:
+  virtual ~HostAllocator() {}
+
+  virtual void* Allocate(size_t size) = 0;
+  /// @brief Frees memory of Allocate, size must be the allocated size.
+  virtual void Free(void* ptr, size_t size) = 0;
+  /// @brief Returns the cached memory to the system.
+  virtual void Trim() {}
+  virtual HostAllocatorStats stats() const = 0;
+  virtual const char* type() const = 0;
+};
+
+/**
+ * @brief Returns the allocator for new host memory, initially the one named
+ *        by the environment variable CAFFE_HOST_ALLOCATOR or else "malloc".
+ *
+ * Memory is always freed by the allocator that allocated it, so the
+ * allocator can be changed at any time.
+ */
+HostAllocator* GetHostAllocator();
+/**
+ * @brief Selects the allocator for new host memory by its type.
+ *
+ * Call it at startup or while no other thread allocates host memory.
+ */
+void SetHostAllocator(const std::string& type);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
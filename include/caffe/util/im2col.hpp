@@ -16,6 +16,26 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_col);
 
+/// @brief Like im2col_cpu for the output rows [row_begin, row_end) only, the
+///        columns are a (channels * kernel_h * kernel_w) x
+///        ((row_end - row_begin) * output_w) matrix.
+template <typename Dtype>
+void im2col_rows_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_col);
+
+/// @brief Like im2col_cpu for an image in the NHWC layout, in which the
+///        channels of a pixel are pixel_stride values apart; the columns are
+///        those of the first channels of each pixel.
+template <typename Dtype>
+void im2col_hwc_cpu(const Dtype* data_im, const int channels,
+    const int pixel_stride, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* data_col);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
@@ -29,6 +49,15 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_im);
 
+/// @brief Adds the columns of the output rows [row_begin, row_end) of
+///        im2col_rows_cpu to data_im, which unlike col2im_cpu is not reset.
+template <typename Dtype>
+void col2im_rows_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_im);
+
 template <typename Dtype>
 void im2col_nd_gpu(const Dtype* data_im, const int num_spatial_axes,
     const int col_size, const int* im_shape, const int* col_shape,
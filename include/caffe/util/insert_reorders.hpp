@@ -0,0 +1,26 @@
+#ifndef CAFFE_UTIL_INSERT_REORDERS_HPP_
+#define CAFFE_UTIL_INSERT_REORDERS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Copies a NetParameter with the NHWC tops of its Input layers (with
+ *        the layout NHWC of their input_param) converted for the layers
+ *        reading them, which all expect NCHW blobs:
+ *  - if nhwc_convolutions is set (for the CPU inference of Net::Init) and
+ *    all the readers of a top are 2D Convolution layers supporting NHWC
+ *    inputs, their input_layout is set to NHWC, so they read the interleaved
+ *    channels directly,
+ *  - otherwise a Reorder layer converting the top to NCHW is inserted after
+ *    the Input layer, and the readers read its top "<top>_nchw" instead;
+ *    in-place readers also write "<top>_nchw", which the later readers read.
+ * The inputs of the Net keep the NHWC layout, e.g. for interleaved images.
+ */
+void InsertReorders(const NetParameter& param, bool nhwc_convolutions,
+    NetParameter* param_reordered);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INSERT_REORDERS_HPP_
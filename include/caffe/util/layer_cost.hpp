@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_LAYER_COST_HPP_
+#define CAFFE_UTIL_LAYER_COST_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Analytic estimate of the work of one Forward and Backward pass of
+ *        a layer, used to report throughput in benchmarks.
+ *
+ * Floating point operations are counted for the compute bound layer types
+ * (Convolution, Deconvolution, InnerProduct, Pooling and LRN, a multiply-add
+ * counts as two), all other layers count as zero. The memory traffic is the
+ * size of all bottom, top and parameter blobs the pass reads or writes once.
+ */
+struct LayerCost {
+  LayerCost()
+      : forward_flops(0), backward_flops(0), forward_bytes(0),
+        backward_bytes(0) {}
+
+  double forward_flops;
+  double backward_flops;
+  double forward_bytes;
+  double backward_bytes;
+};
+
+template <typename Dtype>
+LayerCost EstimateLayerCost(Layer<Dtype>* layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_LAYER_COST_HPP_
@@ -0,0 +1,35 @@
+#ifndef CAFFE_UTIL_LRN_HPP_
+#define CAFFE_UTIL_LRN_HPP_
+
+namespace caffe {
+
+/**
+ * @brief Computes the LRN across channels of one image (channels x
+ *        spatial_dim), output = input * (k + alpha / size * sum)^-beta where
+ *        sum is the sum of the squares of the size channels around each one.
+ *
+ * The image is processed in tiles of pixels, the sliding sum, the power and
+ * the product of each channel of a tile are done in one pass over data in the
+ * L1 cache. Beta 0.75 (the AlexNet and DeepDriving value), 0.5 and 1 are
+ * computed with square roots and divisions instead of pow. output may be
+ * input. If scale is not NULL, the scales k + alpha / size * sum are stored
+ * in it for lrn_across_channels_backward_cpu.
+ */
+template <typename Dtype>
+void lrn_across_channels_cpu(int channels, int spatial_dim, int size,
+    Dtype alpha, Dtype beta, Dtype k, const Dtype* input, Dtype* output,
+    Dtype* scale);
+
+/**
+ * @brief Computes the input diff of the LRN across channels of one image from
+ *        its input, output, scale and output diff, in the same tiled pass as
+ *        lrn_across_channels_cpu.
+ */
+template <typename Dtype>
+void lrn_across_channels_backward_cpu(int channels, int spatial_dim, int size,
+    Dtype alpha, Dtype beta, const Dtype* input, const Dtype* output,
+    const Dtype* scale, const Dtype* output_diff, Dtype* input_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_LRN_HPP_
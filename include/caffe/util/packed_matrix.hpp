@@ -0,0 +1,52 @@
+#ifndef CAFFE_UTIL_PACKED_MATRIX_HPP_
+#define CAFFE_UTIL_PACKED_MATRIX_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A weight matrix (N outputs x K inputs) packed for the products with
+ *        a few inputs, e.g. of an InnerProductLayer at batch size 1.
+ *
+ * The weights are stored in panels of kPanelSize outputs, with the weights of
+ * an input contiguous, so that a product reads them once and in order and
+ * each input multiplies a whole vector of weights. This is a matrix-vector
+ * product, which is bound by the memory bandwidth for large matrices; the
+ * rows of the input reuse each panel while it is in the cache. The panels are
+ * computed in parallel with parallel_for and the loops are compiled for the
+ * instruction sets of vector_math, selected by the CPU.
+ */
+template <typename Dtype>
+class PackedMatrix {
+ public:
+  /// The number of outputs of a panel.
+  static const int kPanelSize = 16;
+  /// The number of input rows up to which Multiply is faster than gemm.
+  static const int kMaxRows = 8;
+
+  PackedMatrix() : N_(0), K_(0) {}
+
+  /// @brief Packs the weights, which are N x K or else K x N (transposed).
+  void Pack(int N, int K, const Dtype* weights, bool transposed);
+  bool initialized() const { return N_ > 0; }
+
+  /// @brief Computes output = input * weights^T + bias for the M x K input
+  ///        and the M x N output, then a ReLU with negative_slope if relu is
+  ///        set; bias may be NULL.
+  void Multiply(int M, const Dtype* input, const Dtype* bias, bool relu,
+      Dtype negative_slope, Dtype* output) const;
+
+ private:
+  int N_;
+  int K_;
+  vector<Dtype> panels_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedMatrix);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_MATRIX_HPP_
@@ -0,0 +1,69 @@
+#ifndef CAFFE_UTIL_PHILOX_HPP_
+#define CAFFE_UTIL_PHILOX_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief The Philox4x32-10 counter-based random number generator of Salmon
+ *        et al., "Parallel Random Numbers: As Easy as 1, 2, 3" (SC 2011).
+ *
+ * The value at position i of the stream of a key is a function of the key
+ * and i only, so any range of a stream can be generated directly, e.g. by the
+ * threads of parallel_for, with the same values as a sequential generation.
+ * A Philox object is a sequential generator reading a stream from a
+ * position.
+ */
+class Philox {
+ public:
+  explicit Philox(uint64_t key = 0, uint64_t position = 0);
+
+  /// @brief Returns the next value of the stream.
+  uint32_t operator()() {
+    if ((position_ & 3) == 0) {
+      Generate(key_, position_, 4, block_);
+    }
+    return block_[position_++ & 3];
+  }
+  /// @brief Returns a value in [0, n) (with a bias of at most n / 2^32).
+  uint32_t Uniform(uint32_t n) {
+    return (static_cast<uint64_t>((*this)()) * n) >> 32;
+  }
+
+  uint64_t key() const { return key_; }
+  uint64_t position() const { return position_; }
+  void Seek(uint64_t position);
+
+  /// @brief Computes the block of 4 values of a 128 bit counter and key.
+  static void Block(const uint32_t counter[4], const uint32_t key[2],
+      uint32_t block[4]);
+  /// @brief Stores the n values at [position, position + n) of the stream of
+  ///        key in r; the values at 4 * i are the block of the counter
+  ///        {i, i >> 32, 0, 0} and key {key, key >> 32}.
+  static void Generate(uint64_t key, uint64_t position, int n, uint32_t* r);
+
+ private:
+  uint64_t key_;
+  uint64_t position_;
+  uint32_t block_[4];
+};
+
+/**
+ * @brief Sets r[i] to 1 with probability p and to 0 otherwise, from the values
+ *        at [position, position + n) of the stream of key.
+ *
+ * The fill runs in parallel with parallel_for, the results do not depend on
+ * the number of threads.
+ */
+void philox_bernoulli(int n, double p, uint64_t key, uint64_t position,
+    unsigned int* r);
+
+/// @brief Fills r with uniform values in [a, b] like philox_bernoulli.
+template <typename Dtype>
+void philox_uniform(int n, Dtype a, Dtype b, uint64_t key, uint64_t position,
+    Dtype* r);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PHILOX_HPP_
@@ -0,0 +1,80 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief Converts to IEEE half precision, rounding to the nearest value.
+uint16_t caffe_float_to_half(float value);
+float caffe_half_to_float(uint16_t value);
+
+/// @brief Returns the maximum of the absolute values.
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x);
+
+/// @brief Quantizes x symmetrically to round(x / scale), clipped to +-127.
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y);
+
+/// @brief Computes C = A * B^T with the 8 bit matrices A (M x K) and
+///        B (N x K) and 32 bit sums, C is M x N.
+void caffe_cpu_gemm_s8(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int32_t* C);
+
+/**
+ * @brief A weight matrix (N outputs x K inputs) stored with the precision of
+ *        a QuantizationParameter, which multiplies inputs on the CPU.
+ *
+ * INT8 weights are quantized with a scale per output, the inputs with a
+ * single scale from the calibrated input_max (or the maximum of the input).
+ * FP16 weights are converted back in blocks of rows that stay in the cache;
+ * they halve the memory of the weights, but are not faster than float.
+ */
+template <typename Dtype>
+class QuantizedMatrix {
+ public:
+  QuantizedMatrix() : N_(0), K_(0) {}
+
+  /// @brief Stores the weights, which are N x K or else K x N (transposed).
+  void Quantize(const QuantizationParameter& param, int N, int K,
+      const Dtype* weights, bool transposed);
+  bool initialized() const { return N_ > 0; }
+
+  /// @brief Computes output = input * weights^T for the M x K input and the
+  ///        M x N output, which are stored transposed if the flags are set.
+  void Multiply(int M, const Dtype* input, bool input_transposed,
+      Dtype* output, bool output_transposed);
+
+ private:
+  QuantizationParameter param_;
+  int N_;
+  int K_;
+  vector<int8_t> weights_int8_;
+  vector<Dtype> weight_scales_;
+  vector<uint16_t> weights_half_;
+  // buffers of Multiply
+  vector<int8_t> input_int8_;
+  vector<int32_t> output_int32_;
+  vector<Dtype> buffer_;
+  vector<Dtype> output_buffer_;
+};
+
+/// @brief Replaces the data of a float BlobProto by its reduced precision
+///        half_data or int8_data (see BlobProto), which Blob::FromProto reads.
+void QuantizeBlobProto(QuantizationParameter::Precision precision,
+    BlobProto* proto);
+
+/// @brief Copies the quantization_param of the layers of the weights (e.g. a
+///        .caffemodel of torcs_quantize) to the layers with the same name.
+void CopyQuantizationParams(const NetParameter& weights, NetParameter* param);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
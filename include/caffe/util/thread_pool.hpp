@@ -0,0 +1,50 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed number of threads that run the tasks of Run in parallel.
+ *
+ * The threads wait between the calls of Run, so a pool can be kept by a
+ * layer for all its forward passes. The thread calling Run is one of the
+ * threads of the pool.
+ */
+class ThreadPool {
+ public:
+  /// @brief Starts threads - 1 threads, 0 means one per hardware thread.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  int threads() const { return threads_; }
+
+  /// @brief Whether the calling thread runs a task of a ThreadPool with
+  ///        several threads, where further threads would oversubscribe the
+  ///        cores.
+  static bool InTask();
+
+  /**
+   * @brief Calls work(task, thread) for each task in [0, tasks) and returns
+   *        when all of them are done.
+   *
+   * The tasks are handed out one by one to the threads, thread is the index
+   * of the running thread in [0, threads()), e.g. to select its buffers.
+   */
+  void Run(int tasks, const boost::function<void(int, int)>& work);
+
+ private:
+  struct State;
+
+  int threads_;
+  shared_ptr<State> state_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
@@ -0,0 +1,49 @@
+#ifndef CAFFE_UTIL_VECTOR_MATH_HPP_
+#define CAFFE_UTIL_VECTOR_MATH_HPP_
+
+namespace caffe {
+
+/**
+ * @brief The instruction sets of the float exp, log, pow and tanh functions
+ *        used by caffe_exp, caffe_log, caffe_powx and caffe_tanh without MKL.
+ *
+ * The fastest instruction set supported by the CPU and the compiler (GCC 9
+ * or newer on x86) is selected at the first call; VECTOR_MATH_SCALAR calls
+ * libm for each value.
+ */
+enum VectorMathISA {
+  VECTOR_MATH_SCALAR = 0,
+  VECTOR_MATH_SSE2 = 1,
+  VECTOR_MATH_AVX2 = 2,
+  VECTOR_MATH_AVX512 = 3
+};
+
+VectorMathISA vector_math_isa();
+bool vector_math_supports(VectorMathISA isa);
+/// @brief Selects a supported instruction set, e.g. to compare them.
+void set_vector_math_isa(VectorMathISA isa);
+const char* vector_math_isa_name(VectorMathISA isa);
+
+/**
+ * The vectorized functions evaluate the Cephes polynomials of expf, logf and
+ * tanhf, for finite inputs their relative errors to the exact values are at
+ * most:
+ *   - vector_exp: 2 * FLT_EPSILON, results below FLT_MIN are flushed to zero
+ *     (inputs below -87.33), results above FLT_MAX are infinite;
+ *   - vector_log: 2 * FLT_EPSILON, or an absolute error of FLT_EPSILON for
+ *     inputs close to 1;
+ *   - vector_powx: (3 + |b log(a)|) * FLT_EPSILON, since a^b is computed as
+ *     exp(b log(a)); b = 0.5, 1, 2 and -1 are exact;
+ *   - vector_tanh: 2 * FLT_EPSILON.
+ * Zeros, infinities and NaNs give the results of libm, except for the sign of
+ * zero and infinite results; a negative a with a non-integer b, including
+ * -inf, gives NaN.
+ */
+void vector_exp(const int n, const float* a, float* y);
+void vector_log(const int n, const float* a, float* y);
+void vector_powx(const int n, const float* a, const float b, float* y);
+void vector_tanh(const int n, const float* a, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_VECTOR_MATH_HPP_
@@ -0,0 +1,50 @@
+#ifndef CAFFE_UTIL_WORKSPACE_HPP_
+#define CAFFE_UTIL_WORKSPACE_HPP_
+
+#include <map>
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Temporary memory shared by the layers of a Net, e.g. for the column
+ *        buffers of the convolutions, of which one is used at a time.
+ *
+ * The layers reserve their size at Reshape, so after the set up the memory
+ * has the size of the largest request, which is allocated at the first use.
+ * The contents are only valid within a Forward or Backward call of a layer;
+ * layers whose buffers must persist between calls keep their own memory.
+ */
+class Workspace {
+ public:
+  Workspace() : size_(0) {}
+
+  /// @brief Grows the memory to at least size bytes, for the owner.
+  void Reserve(const void* owner, size_t size);
+  /// @brief Returns at least size bytes, which may reallocate the memory.
+  void* mutable_cpu_data(size_t size);
+#ifndef CPU_ONLY
+  void* mutable_gpu_data(size_t size);
+#endif
+
+  /// @brief The size of the memory in bytes.
+  size_t size() const { return size_; }
+  /// @brief The sum of the largest reservations of each owner, that is the
+  ///        memory without sharing.
+  size_t reserved() const;
+
+ private:
+  void Grow(size_t size);
+
+  shared_ptr<SyncedMemory> memory_;
+  size_t size_;
+  std::map<const void*, size_t> reservations_;
+
+  DISABLE_COPY_AND_ASSIGN(Workspace);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WORKSPACE_HPP_
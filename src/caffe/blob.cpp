@@ -1,10 +1,12 @@
 #include <climits>
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
 
 namespace caffe {
 
@@ -158,6 +160,13 @@ void Blob<Dtype>::ShareData(const Blob& other) {
   data_ = other.data();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareData(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  data_ = data;
+}
+
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
@@ -492,6 +501,24 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
     }
+  } else if (proto.has_half_data()) {
+    const string& half_data = proto.half_data();
+    CHECK_EQ(2 * count_, half_data.size());
+    for (int i = 0; i < count_; ++i) {
+      const uint16_t value = static_cast<uint8_t>(half_data[2 * i])
+          | (static_cast<uint8_t>(half_data[2 * i + 1]) << 8);
+      data_vec[i] = caffe_half_to_float(value);
+    }
+  } else if (proto.has_int8_data()) {
+    const string& int8_data = proto.int8_data();
+    CHECK_EQ(count_, int8_data.size());
+    const int rows = num_axes() > 0 ? shape(0) : 1;
+    CHECK_EQ(rows, proto.int8_scale_size());
+    const int cols = rows > 0 ? count_ / rows : 0;
+    for (int i = 0; i < count_; ++i) {
+      data_vec[i] = static_cast<int8_t>(int8_data[i])
+          * proto.int8_scale(i / cols);
+    }
   } else {
     CHECK_EQ(count_, proto.data_size());
     for (int i = 0; i < count_; ++i) {
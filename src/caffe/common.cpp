@@ -1,11 +1,21 @@
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -322,4 +332,122 @@ const char* curandGetErrorString(curandStatus_t error) {
 
 #endif  // CPU_ONLY
 
+namespace {
+
+// The settings of parallel_for are atomic, since every call reads them.
+// -1 until read from CAFFE_CPU_THREADS
+boost::atomic<int> parallel_threads_(-1);
+boost::atomic<int> parallel_grain_size_(32768);
+
+int HardwareThreads(int threads) {
+  return threads > 0 ? threads
+      : std::max(1u, boost::thread::hardware_concurrency());
+}
+
+int ParallelThreads() {
+  int threads = parallel_threads_.load(boost::memory_order_relaxed);
+  if (threads < 0) {
+    const char* env_threads = getenv("CAFFE_CPU_THREADS");
+    threads = HardwareThreads(env_threads ? atoi(env_threads) : 1);
+    // unless set_cpu_threads was called in the meantime
+    int unset = -1;
+    if (!parallel_threads_.compare_exchange_strong(unset, threads)) {
+      threads = unset;
+    }
+  }
+  return threads;
+}
+
+// Calls body on the range of task, the ranges of items smaller than a cache
+// line start at multiples of 16 items.
+void RunParallelRange(const boost::function<void(int, int)>& body, int n,
+    int tasks, bool align, int task) {
+  int begin = static_cast<int64_t>(n) * task / tasks;
+  int end = static_cast<int64_t>(n) * (task + 1) / tasks;
+  if (align) {
+    begin &= ~15;
+    end = task == tasks - 1 ? n : end & ~15;
+  }
+  if (begin < end) {
+    body(begin, end);
+  }
+}
+
+#ifndef _OPENMP
+// held while a parallel_for uses the pool, other calls run serially
+boost::mutex parallel_pool_mutex;
+shared_ptr<ThreadPool> parallel_pool;
+
+void RunParallelTask(const boost::function<void(int, int)>& body, int n,
+    int tasks, bool align, int task, int thread) {
+  RunParallelRange(body, n, tasks, align, task);
+}
+#endif
+
+}  // namespace
+
+int Caffe::cpu_threads() {
+  return ParallelThreads();
+}
+
+void Caffe::set_cpu_threads(int threads) {
+  CHECK_GE(threads, 0);
+  parallel_threads_ = HardwareThreads(threads);
+}
+
+int Caffe::parallel_grain_size() {
+  return parallel_grain_size_;
+}
+
+void Caffe::set_parallel_grain_size(int size) {
+  CHECK_GT(size, 0);
+  parallel_grain_size_ = size;
+}
+
+void parallel_for(int n, const boost::function<void(int, int)>& body,
+    int item_size) {
+  CHECK_GE(n, 0);
+  CHECK_GT(item_size, 0);
+  // Small ranges and the tasks of other thread pools (e.g. of a convolution)
+  // run serially.
+  const int64_t grain_size =
+      parallel_grain_size_.load(boost::memory_order_relaxed);
+  const int64_t size = static_cast<int64_t>(n) * item_size;
+  if (size < 2 * grain_size || ThreadPool::InTask()) {
+    if (n > 0) {
+      body(0, n);
+    }
+    return;
+  }
+  const int threads = ParallelThreads();
+  const int tasks = std::min(static_cast<int64_t>(std::min(threads, n)),
+      size / grain_size);
+  if (tasks <= 1) {
+    body(0, n);
+    return;
+  }
+  const bool align = item_size < 16;
+#ifdef _OPENMP
+  if (omp_in_parallel()) {
+    body(0, n);
+    return;
+  }
+#pragma omp parallel for num_threads(tasks) schedule(static, 1)
+  for (int task = 0; task < tasks; ++task) {
+    RunParallelRange(body, n, tasks, align, task);
+  }
+#else
+  boost::mutex::scoped_lock lock(parallel_pool_mutex, boost::try_to_lock);
+  if (!lock.owns_lock()) {
+    body(0, n);
+    return;
+  }
+  if (!parallel_pool || parallel_pool->threads() != threads) {
+    parallel_pool.reset(new ThreadPool(threads));
+  }
+  parallel_pool->Run(tasks, boost::bind(&RunParallelTask, boost::cref(body),
+      n, tasks, align, _1, _2));
+#endif
+}
+
 }  // namespace caffe
@@ -2,6 +2,13 @@
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -12,6 +19,72 @@
 
 namespace caffe {
 
+// Computes transformed_data[i] = (data[i] - mean[i]) * scale for a whole
+// uint8 image without crop or mirror. The mean may be NULL.
+template <typename Dtype>
+static void TransformUint8Scalar(const int count, const uint8_t* data,
+    const Dtype* mean, const Dtype scale, Dtype* transformed_data) {
+  if (mean) {
+    for (int i = 0; i < count; ++i) {
+      transformed_data[i] = (static_cast<Dtype>(data[i]) - mean[i]) * scale;
+    }
+  } else {
+    for (int i = 0; i < count; ++i) {
+      transformed_data[i] = static_cast<Dtype>(data[i]) * scale;
+    }
+  }
+}
+
+template <typename Dtype>
+static void TransformUint8(const int count, const uint8_t* data,
+    const Dtype* mean, const Dtype scale, Dtype* transformed_data) {
+  TransformUint8Scalar(count, data, mean, scale, transformed_data);
+}
+
+#ifdef __SSE2__
+// Widens 16 uint8 pixels to four vectors of 4 floats each.
+static inline void Uint8ToFloat16(const uint8_t* data, __m128* values) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bytes =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  const __m128i words_lo = _mm_unpacklo_epi8(bytes, zero);
+  const __m128i words_hi = _mm_unpackhi_epi8(bytes, zero);
+  values[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words_lo, zero));
+  values[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words_lo, zero));
+  values[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words_hi, zero));
+  values[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words_hi, zero));
+}
+
+template <>
+void TransformUint8<float>(const int count, const uint8_t* data,
+    const float* mean, const float scale, float* transformed_data) {
+  const __m128 scale4 = _mm_set1_ps(scale);
+  __m128 values[4];
+  int i = 0;
+  if (mean) {
+    for (; i + 16 <= count; i += 16) {
+      Uint8ToFloat16(data + i, values);
+      for (int j = 0; j < 4; ++j) {
+        const __m128 mean4 = _mm_loadu_ps(mean + i + 4 * j);
+        _mm_storeu_ps(transformed_data + i + 4 * j,
+            _mm_mul_ps(_mm_sub_ps(values[j], mean4), scale4));
+      }
+    }
+  } else {
+    for (; i + 16 <= count; i += 16) {
+      Uint8ToFloat16(data + i, values);
+      for (int j = 0; j < 4; ++j) {
+        _mm_storeu_ps(transformed_data + i + 4 * j,
+            _mm_mul_ps(values[j], scale4));
+      }
+    }
+  }
+  // remaining pixels
+  TransformUint8Scalar<float>(count - i, data + i, mean ? mean + i : NULL,
+      scale, transformed_data + i);
+}
+#endif  // __SSE2__
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -36,21 +109,41 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
       mean_values_.push_back(param_.mean_value(c));
     }
   }
+  // unpack the per-dimension label transformation
+  for (int i = 0; i < param_.label_transform_size(); ++i) {
+    const LabelTransformParameter& label_param = param_.label_transform(i);
+    label_scale_.push_back(label_param.scale());
+    label_shift_.push_back(label_param.shift());
+    label_min_.push_back(label_param.has_min() ? label_param.min() :
+        -std::numeric_limits<Dtype>::max());
+    label_max_.push_back(label_param.has_max() ? label_param.max() :
+        std::numeric_limits<Dtype>::max());
+    CHECK_LE(label_min_[i], label_max_[i])
+        << "label_transform " << i << " has min > max";
+  }
+  // Without crop, mirror and mean values, uint8 data can be transformed by
+  // a single vectorized pass over the image instead of the generic loop.
+  uint8_fast_path_ = param_.crop_size() == 0 && !param_.mirror() &&
+      param_.mean_value_size() == 0;
 }
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data) {
   const string& data = datum.data();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
+  Transform(datum.channels(), datum.height(), datum.width(),
+      data.size() > 0 ? reinterpret_cast<const uint8_t*>(data.data()) : NULL,
+      datum.float_data().data(), transformed_data);
+}
 
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const int datum_channels,
+    const int datum_height, const int datum_width, const uint8_t* data,
+    const float* float_data, Dtype* transformed_data) {
   const int crop_size = param_.crop_size();
   const Dtype scale = param_.scale();
-  const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = data != NULL;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
@@ -64,6 +157,14 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     CHECK_EQ(datum_width, data_mean_.width());
     mean = data_mean_.mutable_cpu_data();
   }
+
+  if (uint8_fast_path_ && has_uint8) {
+    TransformUint8(datum_channels * datum_height * datum_width, data, mean,
+        scale, transformed_data);
+    return;
+  }
+
+  const bool do_mirror = param_.mirror() && Rand(2);
   if (has_mean_values) {
     CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
      "Specify either 1 mean_value or as many as channels: " << datum_channels;
@@ -105,10 +206,9 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
           top_index = (c * height + h) * width + w;
         }
         if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
+          datum_element = static_cast<Dtype>(data[data_index]);
         } else {
-          datum_element = datum.float_data(data_index);
+          datum_element = float_data[data_index];
         }
         if (has_mean_file) {
           transformed_data[top_index] =
@@ -153,10 +253,31 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
+  CheckBlobShape(datum.channels(), datum.height(), datum.width(),
+      transformed_blob);
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  Transform(datum, transformed_data);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const DatumView& datum,
+                                       Blob<Dtype>* transformed_blob) {
+  CHECK(!datum.encoded()) << "Encoded records need to be parsed to a Datum.";
+  if (param_.force_color() || param_.force_gray()) {
+    LOG(ERROR) << "force_color and force_gray only for encoded datum";
+  }
+  CheckBlobShape(datum.channels(), datum.height(), datum.width(),
+      transformed_blob);
+  Transform(datum.channels(), datum.height(), datum.width(),
+      datum.data_size() > 0 ? datum.data() : NULL, datum.float_data(),
+      transformed_blob->mutable_cpu_data());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::CheckBlobShape(const int datum_channels,
+    const int datum_height, const int datum_width,
+    const Blob<Dtype>* transformed_blob) const {
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
 
   // Check dimensions.
   const int channels = transformed_blob->channels();
@@ -176,9 +297,6 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     CHECK_EQ(datum_height, height);
     CHECK_EQ(datum_width, width);
   }
-
-  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data);
 }
 
 template<typename Dtype>
@@ -438,6 +556,42 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
   }
 }
 
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformLabel(const Datum& datum,
+                                            const int label_dim,
+                                            Dtype* transformed_label) {
+  TransformLabel(datum.float_data().data(), datum.float_data_size(),
+      label_dim, transformed_label);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformLabel(const DatumView& datum,
+                                            const int label_dim,
+                                            Dtype* transformed_label) {
+  TransformLabel(datum.float_data(), datum.float_data_size(), label_dim,
+      transformed_label);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformLabel(const float* labels,
+    const int size, const int label_dim, Dtype* transformed_label) {
+  CHECK_GE(size, label_dim)
+      << "Datum does not contain enough float_data labels";
+  if (label_scale_.empty()) {
+    for (int i = 0; i < label_dim; ++i) {
+      transformed_label[i] = labels[i];
+    }
+    return;
+  }
+  CHECK_EQ(label_scale_.size(), label_dim)
+      << "Specify either no label_transform or one per label dimension";
+  for (int i = 0; i < label_dim; ++i) {
+    const Dtype label = labels[i] * label_scale_[i] + label_shift_[i];
+    transformed_label[i] = std::min(std::max(label, label_min_[i]),
+                                    label_max_[i]);
+  }
+}
+
 template<typename Dtype>
 vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
   if (datum.encoded()) {
@@ -457,10 +611,19 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
   }
+  return InferBlobShape(datum.channels(), datum.height(), datum.width());
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const DatumView& datum) {
+  CHECK(!datum.encoded()) << "Encoded records need to be parsed to a Datum.";
+  return InferBlobShape(datum.channels(), datum.height(), datum.width());
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const int datum_channels,
+    const int datum_height, const int datum_width) {
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
   // Check dimensions.
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
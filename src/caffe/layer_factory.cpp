@@ -50,7 +50,7 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
 #ifdef USE_CUDNN
-    if (!use_dilation) {
+    if (!use_dilation && conv_param.input_layout() == NCHW) {
       engine = ConvolutionParameter_Engine_CUDNN;
     }
 #endif
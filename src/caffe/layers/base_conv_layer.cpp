@@ -1,8 +1,14 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
+#include <cfloat>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -19,6 +25,17 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const int num_axes = bottom[0]->num_axes();
   num_spatial_axes_ = num_axes - first_spatial_axis;
   CHECK_GE(num_spatial_axes_, 0);
+  nhwc_input_ = conv_param.input_layout() == NHWC;
+  if (nhwc_input_) {
+    CHECK(!reverse_dimensions())
+        << "Deconvolutions do not support NHWC inputs.";
+    CHECK(channel_axis_ == 1 && num_spatial_axes_ == 2 && !force_nd_im2col_)
+        << "Only 2D convolutions of N x H x W x C inputs support NHWC.";
+    CHECK(conv_param.cpu_algorithm() == ConvolutionParameter_CPUAlgorithm_GEMM
+        || conv_param.cpu_algorithm() ==
+        ConvolutionParameter_CPUAlgorithm_AUTOTUNE)
+        << "NHWC inputs are only supported by the GEMM cpu_algorithm.";
+  }
   vector<int> bottom_dim_blob_shape(1, num_spatial_axes_ + 1);
   vector<int> spatial_dim_blob_shape(1, std::max(num_spatial_axes_, 1));
   // Setup filter kernel dimensions (kernel_shape_).
@@ -114,8 +131,10 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         kernel_shape_data[i] == 1 && stride_data[i] == 1 && pad_data[i] == 0;
     if (!is_1x1_) { break; }
   }
+  // The columns of an NHWC input are always gathered by im2col.
+  is_1x1_ &= !nhwc_input_;
   // Configure output channels and groups.
-  channels_ = bottom[0]->shape(channel_axis_);
+  channels_ = bottom[0]->shape(nhwc_input_ ? 3 : channel_axis_);
   num_output_ = this->layer_param_.convolution_param().num_output();
   CHECK_GT(num_output_, 0);
   group_ = this->layer_param_.convolution_param().group();
@@ -178,6 +197,15 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
+  // Set up the threads of forward_cpu_batch.
+  const int cpu_threads = this->layer_param_.convolution_param().cpu_threads();
+  if (cpu_threads != 1 && !reverse_dimensions()) {
+    thread_pool_.reset(new ThreadPool(cpu_threads));
+    thread_col_buffers_.resize(thread_pool_->threads() - 1);
+    for (int i = 0; i < thread_col_buffers_.size(); ++i) {
+      thread_col_buffers_[i].reset(new Blob<Dtype>());
+    }
+  }
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -189,7 +217,16 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   CHECK_EQ(bottom[0]->num_axes(), first_spatial_axis + num_spatial_axes_)
       << "bottom num_axes may not change.";
   num_ = bottom[0]->count(0, channel_axis_);
-  CHECK_EQ(bottom[0]->shape(channel_axis_), channels_)
+  bottom_shape_ = &bottom[0]->shape();
+  if (nhwc_input_) {
+    nchw_bottom_shape_.resize(4);
+    nchw_bottom_shape_[0] = bottom[0]->shape(0);
+    nchw_bottom_shape_[1] = bottom[0]->shape(3);
+    nchw_bottom_shape_[2] = bottom[0]->shape(1);
+    nchw_bottom_shape_[3] = bottom[0]->shape(2);
+    bottom_shape_ = &nchw_bottom_shape_;
+  }
+  CHECK_EQ((*bottom_shape_)[channel_axis_], channels_)
       << "Input size incompatible with convolution kernel.";
   // TODO: generalize to handle inputs of different shapes.
   for (int bottom_id = 1; bottom_id < bottom.size(); ++bottom_id) {
@@ -197,7 +234,6 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         << "All inputs must have the same shape.";
   }
   // Shape the tops.
-  bottom_shape_ = &bottom[0]->shape();
   compute_output_shape();
   vector<int> top_shape(bottom[0]->shape().begin(),
       bottom[0]->shape().begin() + channel_axis_);
@@ -213,9 +249,8 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   } else {
     conv_out_spatial_dim_ = top[0]->count(first_spatial_axis);
   }
-  col_offset_ = kernel_dim_ * conv_out_spatial_dim_;
   output_offset_ = conv_out_channels_ * conv_out_spatial_dim_ / group_;
-  // Setup input dimensions (conv_input_shape_).
+  // Setup input dimensions (conv_input_shape_) of the channels of a group.
   vector<int> bottom_dim_blob_shape(1, num_spatial_axes_ + 1);
   conv_input_shape_.Reshape(bottom_dim_blob_shape);
   int* conv_input_shape_data = conv_input_shape_.mutable_cpu_data();
@@ -223,14 +258,15 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     if (reverse_dimensions()) {
       conv_input_shape_data[i] = top[0]->shape(channel_axis_ + i);
     } else {
-      conv_input_shape_data[i] = bottom[0]->shape(channel_axis_ + i);
+      conv_input_shape_data[i] = (*bottom_shape_)[channel_axis_ + i];
     }
   }
-  // The im2col result buffer will only hold one image at a time to avoid
-  // overly large memory usage. In the special case of 1x1 convolution
-  // it goes lazily unused to save memory.
+  conv_input_shape_data[0] /= group_;
+  // The im2col result buffer will only hold one group of one image at a time
+  // to avoid overly large memory usage. In the special case of 1x1
+  // convolution it goes lazily unused to save memory.
   col_buffer_shape_.clear();
-  col_buffer_shape_.push_back(kernel_dim_ * group_);
+  col_buffer_shape_.push_back(kernel_dim_);
   for (int i = 0; i < num_spatial_axes_; ++i) {
     if (reverse_dimensions()) {
       col_buffer_shape_.push_back(input_shape(i + 1));
@@ -241,8 +277,12 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   col_buffer_.Reshape(col_buffer_shape_);
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
-  num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
-  num_kernels_col2im_ = reverse_dimensions() ? top_dim_ : bottom_dim_;
+  input_offset_ = (reverse_dimensions() ? top_dim_ : bottom_dim_) / group_;
+  if (nhwc_input_) {
+    input_offset_ = conv_in_channels_ / group_;
+  }
+  num_kernels_im2col_ = conv_in_channels_ / group_ * conv_out_spatial_dim_;
+  num_kernels_col2im_ = input_offset_;
   // Set up the all ones "bias multiplier" for adding biases by BLAS
   out_spatial_dim_ = top[0]->count(first_spatial_axis);
   if (bias_term_) {
@@ -251,24 +291,113 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     caffe_set(bias_multiplier_.count(), Dtype(1),
         bias_multiplier_.mutable_cpu_data());
   }
+  // Select the CPU forward algorithm for this shape.
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  cpu_algorithm_ = ConvolutionParameter_CPUAlgorithm_GEMM;
+  if (!reverse_dimensions() && num_spatial_axes_ == 2 && !force_nd_im2col_) {
+    conv_2d_shape_.channels = conv_in_channels_;
+    conv_2d_shape_.height = conv_input_shape_.cpu_data()[1];
+    conv_2d_shape_.width = conv_input_shape_.cpu_data()[2];
+    conv_2d_shape_.num_output = conv_out_channels_;
+    conv_2d_shape_.group = group_;
+    conv_2d_shape_.kernel_h = kernel_shape_.cpu_data()[0];
+    conv_2d_shape_.kernel_w = kernel_shape_.cpu_data()[1];
+    conv_2d_shape_.pad_h = pad_.cpu_data()[0];
+    conv_2d_shape_.pad_w = pad_.cpu_data()[1];
+    conv_2d_shape_.stride_h = stride_.cpu_data()[0];
+    conv_2d_shape_.stride_w = stride_.cpu_data()[1];
+    conv_2d_shape_.dilation_h = dilation_.cpu_data()[0];
+    conv_2d_shape_.dilation_w = dilation_.cpu_data()[1];
+    tiled_.SetShape(conv_2d_shape_);
+    // the transformed weights depend on the shape as well
+    winograd_weights_ = SyncedMemoryVersion();
+    cpu_algorithm_ = conv_param.cpu_algorithm();
+    if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_WINOGRAD) {
+      CHECK(WinogradConvolution<Dtype>::Supports(conv_2d_shape_))
+          << "Winograd convolutions need 3x3 kernels with stride 1 and no "
+          << "dilation.";
+    } else if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_AUTOTUNE) {
+      ConvAlgorithmCache::Find(cpu_algorithm_key(), &cpu_algorithm_);
+    }
+  } else {
+    CHECK(conv_param.cpu_algorithm() == ConvolutionParameter_CPUAlgorithm_GEMM
+        || conv_param.cpu_algorithm() ==
+        ConvolutionParameter_CPUAlgorithm_AUTOTUNE)
+        << "Only 2D convolutions have other CPU algorithms than GEMM.";
+  }
+  if (nhwc_input_) {
+    cpu_algorithm_ = ConvolutionParameter_CPUAlgorithm_GEMM;
+  }
+  // Reserve the workspaces of the threads in the shared workspace, the
+  // backward pass and the quantized weights use one column buffer.
+  if (this->workspace_) {
+    size_t size = is_1x1_ ? 0 : col_buffer_.count();
+    if (Caffe::mode() == Caffe::CPU) {
+      const int threads = thread_pool_ ? thread_pool_->threads() : 1;
+      size = std::max(size,
+          static_cast<size_t>(threads) * cpu_workspace_size());
+    }
+    this->workspace_->Reserve(this, size * sizeof(Dtype));
+  }
+}
+
+template <typename Dtype>
+int BaseConvolutionLayer<Dtype>::cpu_workspace_size() const {
+  const int gemm_size = is_1x1_ ? 0 : col_buffer_.count();
+  switch (cpu_algorithm_) {
+  case ConvolutionParameter_CPUAlgorithm_DIRECT:
+    return 0;
+  case ConvolutionParameter_CPUAlgorithm_WINOGRAD:
+    return WinogradConvolution<Dtype>::WorkspaceSize(conv_2d_shape_);
+  case ConvolutionParameter_CPUAlgorithm_TILED:
+    return tiled_.workspace_size();
+  case ConvolutionParameter_CPUAlgorithm_AUTOTUNE: {
+    int size = std::max(gemm_size, tiled_.workspace_size());
+    if (WinogradConvolution<Dtype>::Supports(conv_2d_shape_)) {
+      size = std::max(size,
+          WinogradConvolution<Dtype>::WorkspaceSize(conv_2d_shape_));
+    }
+    return size;
+  }
+  default:
+    return gemm_size;
+  }
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
-  const Dtype* col_buff = input;
+  forward_cpu_gemm(input, weights, output,
+      is_1x1_ ? NULL : col_buffer_cpu(), skip_im2col);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
+    const Dtype* weights, Dtype* output, Dtype* col_buffer,
+    bool skip_im2col) {
+  // the buffer holds the columns of the last group only
+  for (int g = 0; g < group_; ++g) {
+    forward_cpu_group(input, weights, output, col_buffer, g,
+        skip_im2col && group_ == 1);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_group(const Dtype* input,
+    const Dtype* weights, Dtype* output, Dtype* col_buffer, int g,
+    bool skip_im2col) {
+  const Dtype* col_buff = input + input_offset_ * g;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input + input_offset_ * g, col_buffer);
     }
-    col_buff = col_buffer_.cpu_data();
-  }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+    col_buff = col_buffer;
   }
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+      group_, conv_out_spatial_dim_, kernel_dim_,
+      (Dtype)1., weights + weight_offset_ * g, col_buff,
+      (Dtype)0., output + output_offset_ * g);
 }
 
 template <typename Dtype>
@@ -279,36 +408,293 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_bias_relu(Dtype* output,
+    const Dtype* bias, int begin, int end) {
+  const Dtype negative_slope =
+      this->layer_param_.relu_param().negative_slope();
+  for (int c = begin; c < end; ++c) {
+    const Dtype channel_bias = bias ? bias[c] : Dtype(0);
+    Dtype* channel_output = output + c * out_spatial_dim_;
+    for (int i = 0; i < out_spatial_dim_; ++i) {
+      const Dtype value = channel_output[i] + channel_bias;
+      channel_output[i] = value > 0 ? value : value * negative_slope;
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_batch(const Dtype* input,
+    const Dtype* weights, const Dtype* bias, Dtype* output) {
+  if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_AUTOTUNE &&
+      !use_quantized_weights()) {
+    autotune_cpu_algorithm(input, weights, output);
+  }
+  // The buffers are set up before the threads start, since the synchronization
+  // of SyncedMemory is not thread safe.
+  if (bias && !this->layer_param_.has_relu_param()) {
+    bias_multiplier_.cpu_data();
+  }
+  if (!thread_pool_ || use_quantized_weights()) {
+    const vector<Dtype*> buffers = prepare_cpu_algorithm(weights, 1);
+    for (int n = 0; n < num_; ++n) {
+      forward_cpu_image(input, weights, bias, output, buffers, n, 0);
+    }
+    return;
+  }
+  const vector<Dtype*> buffers =
+      prepare_cpu_algorithm(weights, thread_pool_->threads());
+  if (group_ > 1 && cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_GEMM) {
+    // the groups are independent GEMMs, which run in parallel with the
+    // column buffers of one group, also for a single image
+    thread_pool_->Run(num_ * group_, boost::bind(
+        &BaseConvolutionLayer<Dtype>::forward_cpu_image_group, this, input,
+        weights, bias, output, boost::cref(buffers), _1, _2));
+    return;
+  }
+  thread_pool_->Run(num_, boost::bind(
+      &BaseConvolutionLayer<Dtype>::forward_cpu_image, this, input, weights,
+      bias, output, boost::cref(buffers), _1, _2));
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_image(const Dtype* input,
+    const Dtype* weights, const Dtype* bias, Dtype* output,
+    const vector<Dtype*>& buffers, int n, int thread) {
+  const Dtype* image_input = input + n * bottom_dim_;
+  Dtype* image_output = output + n * top_dim_;
+  if (use_quantized_weights()) {
+    forward_cpu_quantized(image_input, weights, image_output);
+  } else if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_DIRECT) {
+    conv_direct_cpu(conv_2d_shape_, image_input, weights, image_output);
+  } else if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_WINOGRAD) {
+    winograd_.Forward(image_input, image_output, buffers[thread]);
+  } else if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_TILED) {
+    tiled_.Forward(image_input, weights, image_output, buffers[thread]);
+  } else {
+    forward_cpu_gemm(image_input, weights, image_output, buffers[thread],
+        false);
+  }
+  if (this->layer_param_.has_relu_param()) {
+    forward_cpu_bias_relu(image_output, bias, 0, num_output_);
+  } else if (bias) {
+    forward_cpu_bias(image_output, bias);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_image_group(const Dtype* input,
+    const Dtype* weights, const Dtype* bias, Dtype* output,
+    const vector<Dtype*>& buffers, int task, int thread) {
+  const int n = task / group_;
+  const int g = task % group_;
+  Dtype* image_output = output + n * top_dim_;
+  forward_cpu_group(input + n * bottom_dim_, weights, image_output,
+      buffers[thread], g, false);
+  const int channels = conv_out_channels_ / group_;
+  if (this->layer_param_.has_relu_param()) {
+    forward_cpu_bias_relu(image_output, bias, g * channels,
+        (g + 1) * channels);
+  } else if (bias) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels,
+        out_spatial_dim_, 1, (Dtype)1., bias + g * channels,
+        bias_multiplier_.cpu_data(), (Dtype)1.,
+        image_output + output_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+vector<Dtype*> BaseConvolutionLayer<Dtype>::prepare_cpu_algorithm(
+    const Dtype* weights, int threads) {
+  vector<Dtype*> buffers(threads, NULL);
+  if (use_quantized_weights() ||
+      cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_DIRECT) {
+    return buffers;
+  }
+  if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_WINOGRAD) {
+    if (winograd_weights_.Update(this->blobs_[0]->data())) {
+      winograd_.SetWeights(conv_2d_shape_, weights);
+    }
+    prepare_workspaces(winograd_.workspace_size(), &buffers);
+  } else if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_TILED) {
+    prepare_workspaces(tiled_.workspace_size(), &buffers);
+  } else if (this->workspace_ && !is_1x1_) {
+    prepare_workspaces(col_buffer_.count(), &buffers);
+  } else if (!is_1x1_) {
+    buffers[0] = col_buffer_.mutable_cpu_data();
+    for (int i = 1; i < threads; ++i) {
+      thread_col_buffers_[i - 1]->Reshape(col_buffer_shape_);
+      buffers[i] = thread_col_buffers_[i - 1]->mutable_cpu_data();
+    }
+  }
+  return buffers;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::prepare_workspaces(int size,
+    vector<Dtype*>* buffers) {
+  if (this->workspace_) {
+    // the workspaces of the threads follow each other
+    Dtype* workspace = static_cast<Dtype*>(this->workspace_->mutable_cpu_data(
+        buffers->size() * size * sizeof(Dtype)));
+    for (int i = 0; i < buffers->size(); ++i) {
+      (*buffers)[i] = size > 0 ? workspace + i * size : NULL;
+    }
+    return;
+  }
+  // the workspaces of more threads are kept for the next passes
+  if (thread_workspaces_.size() < buffers->size()) {
+    thread_workspaces_.resize(buffers->size());
+  }
+  for (int i = 0; i < buffers->size(); ++i) {
+    thread_workspaces_[i].resize(size);
+    (*buffers)[i] = size > 0 ? &thread_workspaces_[i][0] : NULL;
+  }
+}
+
+template <typename Dtype>
+Dtype* BaseConvolutionLayer<Dtype>::col_buffer_cpu() {
+  if (this->workspace_) {
+    return static_cast<Dtype*>(this->workspace_->mutable_cpu_data(
+        col_buffer_.count() * sizeof(Dtype)));
+  }
+  return col_buffer_.mutable_cpu_data();
+}
+
+#ifndef CPU_ONLY
+template <typename Dtype>
+Dtype* BaseConvolutionLayer<Dtype>::col_buffer_gpu() {
+  if (this->workspace_) {
+    return static_cast<Dtype*>(this->workspace_->mutable_gpu_data(
+        col_buffer_.count() * sizeof(Dtype)));
+  }
+  return col_buffer_.mutable_gpu_data();
+}
+#endif
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::autotune_cpu_algorithm(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  vector<ConvolutionParameter::CPUAlgorithm> algorithms;
+  algorithms.push_back(ConvolutionParameter_CPUAlgorithm_GEMM);
+  algorithms.push_back(ConvolutionParameter_CPUAlgorithm_DIRECT);
+  if (WinogradConvolution<Dtype>::Supports(conv_2d_shape_)) {
+    algorithms.push_back(ConvolutionParameter_CPUAlgorithm_WINOGRAD);
+  }
+  algorithms.push_back(ConvolutionParameter_CPUAlgorithm_TILED);
+  ConvolutionParameter::CPUAlgorithm fastest = algorithms[0];
+  float fastest_time = FLT_MAX;
+  std::ostringstream times;
+  CPUTimer timer;
+  for (int i = 0; i < algorithms.size(); ++i) {
+    cpu_algorithm_ = algorithms[i];
+    const vector<Dtype*> buffers = prepare_cpu_algorithm(weights, 1);
+    // the fastest of 3 runs, the first one also loads the caches
+    float time = FLT_MAX;
+    for (int run = 0; run < 3; ++run) {
+      timer.Start();
+      forward_cpu_image(input, weights, NULL, output, buffers, 0, 0);
+      timer.Stop();
+      time = std::min(time, timer.MicroSeconds() / 1000);
+    }
+    times << " " << ConvolutionParameter::CPUAlgorithm_Name(algorithms[i])
+          << " " << time << " ms";
+    if (time < fastest_time) {
+      fastest = algorithms[i];
+      fastest_time = time;
+    }
+  }
+  cpu_algorithm_ = fastest;
+  ConvAlgorithmCache::Store(cpu_algorithm_key(), fastest);
+  LOG(INFO) << "Convolution " << this->layer_param_.name() << " uses "
+            << ConvolutionParameter::CPUAlgorithm_Name(fastest)
+            << " (per image:" << times.str() << ")";
+}
+
+template <typename Dtype>
+string BaseConvolutionLayer<Dtype>::cpu_algorithm_key() const {
+  // the threads of a batch share the memory bandwidth and caches
+  std::ostringstream key;
+  key << (sizeof(Dtype) == sizeof(float) ? "float_" : "double_")
+      << conv_2d_shape_.ToString() << "_t"
+      << (thread_pool_ ? thread_pool_->threads() : 1) << "_"
+      << ConvAlgorithmCache::Platform();
+  return key.str();
+}
+
+template <typename Dtype>
+bool BaseConvolutionLayer<Dtype>::use_quantized_weights() const {
+  return this->phase_ == TEST &&
+      this->layer_param_.quantization_param().precision() !=
+      QuantizationParameter_Precision_FLOAT;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_quantized(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  if (derived_weights_.Update(this->blobs_[0]->data())) {
+    quantized_weights_.resize(group_);
+    for (int g = 0; g < group_; ++g) {
+      quantized_weights_[g].Quantize(this->layer_param_.quantization_param(),
+          conv_out_channels_ / group_, kernel_dim_,
+          weights + weight_offset_ * g, false);
+    }
+  }
+  // The columns are kernel_dim_ x conv_out_spatial_dim_, that is the
+  // transposed input of the matrix, likewise the output.
+  for (int g = 0; g < group_; ++g) {
+    const Dtype* col_buff = input + input_offset_ * g;
+    if (!is_1x1_) {
+      Dtype* col_buffer = col_buffer_cpu();
+      conv_im2col_cpu(col_buff, col_buffer);
+      col_buff = col_buffer;
+    }
+    quantized_weights_[g].Multiply(conv_out_spatial_dim_, col_buff, true,
+        output + output_offset_ * g, true);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_TILED) {
+    vector<Dtype*> workspace(1);
+    prepare_workspaces(tiled_.workspace_size(), &workspace);
+    tiled_.Backward(output, weights, input, workspace[0]);
+    return;
   }
   for (int g = 0; g < group_; ++g) {
+    Dtype* col_buff = is_1x1_ ? input + input_offset_ * g :
+        col_buffer_cpu();
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
         conv_out_spatial_dim_, conv_out_channels_ / group_,
         (Dtype)1., weights + weight_offset_ * g, output + output_offset_ * g,
-        (Dtype)0., col_buff + col_offset_ * g);
-  }
-  if (!is_1x1_) {
-    conv_col2im_cpu(col_buff, input);
+        (Dtype)0., col_buff);
+    if (!is_1x1_) {
+      conv_col2im_cpu(col_buff, input + input_offset_ * g);
+    }
   }
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
-  const Dtype* col_buff = input;
-  if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+  if (cpu_algorithm_ == ConvolutionParameter_CPUAlgorithm_TILED) {
+    vector<Dtype*> workspace(1);
+    prepare_workspaces(tiled_.workspace_size(), &workspace);
+    tiled_.WeightGradient(input, output, weights, workspace[0]);
+    return;
   }
   for (int g = 0; g < group_; ++g) {
+    const Dtype* col_buff = input + input_offset_ * g;
+    if (!is_1x1_) {
+      Dtype* col_buffer = col_buffer_cpu();
+      conv_im2col_cpu(col_buff, col_buffer);
+      col_buff = col_buffer;
+    }
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
         kernel_dim_, conv_out_spatial_dim_,
-        (Dtype)1., output + output_offset_ * g, col_buff + col_offset_ * g,
+        (Dtype)1., output + output_offset_ * g, col_buff,
         (Dtype)1., weights + weight_offset_ * g);
   }
 }
@@ -325,17 +711,18 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
-  const Dtype* col_buff = input;
-  if (!is_1x1_) {
-    if (!skip_im2col) {
-      conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
-    }
-    col_buff = col_buffer_.gpu_data();
-  }
+  // the buffer holds the columns of the last group only
   for (int g = 0; g < group_; ++g) {
+    const Dtype* col_buff = input + input_offset_ * g;
+    if (!is_1x1_) {
+      if (!skip_im2col || group_ > 1) {
+        conv_im2col_gpu(col_buff, col_buffer_gpu());
+      }
+      col_buff = col_buffer_gpu();
+    }
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
+        (Dtype)1., weights + weight_offset_ * g, col_buff,
         (Dtype)0., output + output_offset_ * g);
   }
 }
@@ -351,33 +738,32 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
-  if (is_1x1_) {
-    col_buff = input;
-  }
   for (int g = 0; g < group_; ++g) {
+    Dtype* col_buff = is_1x1_ ? input + input_offset_ * g :
+        col_buffer_gpu();
     caffe_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
         conv_out_spatial_dim_, conv_out_channels_ / group_,
         (Dtype)1., weights + weight_offset_ * g, output + output_offset_ * g,
-        (Dtype)0., col_buff + col_offset_ * g);
-  }
-  if (!is_1x1_) {
-    conv_col2im_gpu(col_buff, input);
+        (Dtype)0., col_buff);
+    if (!is_1x1_) {
+      conv_col2im_gpu(col_buff, input + input_offset_ * g);
+    }
   }
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
-  const Dtype* col_buff = input;
-  if (!is_1x1_) {
-    conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
-    col_buff = col_buffer_.gpu_data();
-  }
   for (int g = 0; g < group_; ++g) {
+    const Dtype* col_buff = input + input_offset_ * g;
+    if (!is_1x1_) {
+      Dtype* col_buffer = col_buffer_gpu();
+      conv_im2col_gpu(col_buff, col_buffer);
+      col_buff = col_buffer;
+    }
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
         kernel_dim_, conv_out_spatial_dim_,
-        (Dtype)1., output + output_offset_ * g, col_buff + col_offset_ * g,
+        (Dtype)1., output + output_offset_ * g, col_buff,
         (Dtype)1., weights + weight_offset_ * g);
   }
 }
@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <vector>
 
 #include "caffe/filler.hpp"
@@ -6,6 +8,24 @@
 
 namespace caffe {
 
+namespace {
+
+// Adds bias_data[p % bias_dim] to the planes p in [begin, end) of inner_dim
+// values; run by parallel_for.
+template <typename Dtype>
+void bias_planes(const Dtype* bias_data, int bias_dim, int inner_dim,
+    Dtype* top_data, int begin, int end) {
+  for (int p = begin; p < end; ++p) {
+    const Dtype bias = bias_data[p % bias_dim];
+    Dtype* plane = top_data + p * inner_dim;
+    for (int i = 0; i < inner_dim; ++i) {
+      plane[i] += bias;
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void BiasLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -78,12 +98,8 @@ void BiasLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const Dtype* bottom_data = bottom[0]->cpu_data();
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
-  for (int n = 0; n < outer_dim_; ++n) {
-    caffe_cpu_gemm(CblasNoTrans, CblasNoTrans, bias_dim_,
-        inner_dim_, 1, Dtype(1), bias_data,
-        bias_multiplier_.cpu_data(), Dtype(1), top_data);
-    top_data += dim_;
-  }
+  parallel_for(outer_dim_ * bias_dim_, boost::bind(&bias_planes<Dtype>,
+      bias_data, bias_dim_, inner_dim_, top_data, _1, _2), inner_dim_);
 }
 
 template <typename Dtype>
@@ -7,6 +7,9 @@ namespace caffe {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  CHECK(!this->layer_param_.has_relu_param())
+      << "Fused ReLUs are only supported on the CPU.";
+  CHECK(!this->nhwc_input_) << "NHWC inputs are only supported on the CPU.";
   const Dtype* weight = this->blobs_[0]->gpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->gpu_data();
@@ -3,11 +3,15 @@
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #define LabelDimension 14
 
@@ -16,13 +20,17 @@ namespace caffe {
 template <typename Dtype>
 DataLayer<Dtype>::DataLayer(const LayerParameter& param)
   : BasePrefetchingDataLayer<Dtype>(param),
-    offset_() {
+    offset_(), current_key_(), last_key_(), cursor_synced_(true),
+    frames_(param.data_param().frames()),
+    frame_stride_(param.data_param().frame_stride()), first_key_() {
   db_.reset(db::GetDB(param.data_param().backend()));
   db_->Open(param.data_param().source(), db::READ);
   cursor_.reset(db_->NewCursor());
+  current_key_ = std::atoi(cursor_->key().c_str());
+  first_key_ = current_key_;
 
-  std::random_device RandomDevice;
-  RandomGenerator.seed(RandomDevice());
+  const uint64_t seed = caffe_rng_rand();
+  RandomGenerator = Philox(seed << 32 | caffe_rng_rand());
 }
 
 template <typename Dtype>
@@ -38,21 +46,50 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   Datum datum;
   datum.ParseFromString(cursor_->value());
 
+  const uint32_t cache_size_mb =
+      this->layer_param_.data_param().cache_size_mb();
+  if (cache_size_mb > 0) {
+    cache_.reset(new DatasetCache(this->layer_param_.data_param().source(),
+        static_cast<size_t>(cache_size_mb) << 20, datum, LabelDimension));
+    cursor_->SeekToLast();
+    last_key_ = std::atoi(cursor_->key().c_str());
+    cursor_->SeekToFirst();
+  }
+
+  CHECK_GT(frames_, 0) << "A sample needs at least one frame.";
+  if (frames_ > 1) {
+    CHECK_GT(frame_stride_, 0) << "The frames of a window must be different.";
+    const TransformationParameter& transform_param =
+        this->layer_param_.transform_param();
+    CHECK(transform_param.crop_size() == 0 && !transform_param.mirror())
+        << "Temporal windows do not support crop_size and mirror, since all "
+        << "frames of a window must be transformed the same way.";
+    // Frames which are at most the window span apart never share a slot.
+    const int span = (frames_ - 1) * frame_stride_ + 1;
+    ring_.resize(span);
+    ring_keys_.assign(span, -1);
+  }
+
   // Use data_transformer to infer the expected blob shape from datum.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
-  this->transformed_data_.Reshape(top_shape);
+  // transformed_data_ always holds a single frame.
+  const vector<int> frame_shape =
+      this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(frame_shape);
   // Reshape top[0] and prefetch_data according to the batch_size.
-  top_shape[0] = batch_size;
+  vector<int> top_shape = WindowShape(frame_shape, batch_size);
   top[0]->Reshape(top_shape);
   for (int i = 0; i < this->prefetch_.size(); ++i) {
     this->prefetch_[i]->data_.Reshape(top_shape);
   }
   LOG_IF(INFO, Caffe::root_solver())
-      << "output data size: " << top[0]->num() << ","
-      << top[0]->channels() << "," << top[0]->height() << ","
-      << top[0]->width();
+      << "output data size: " << top[0]->shape_string();
   // label
   if (this->output_labels_) {
+    const int label_transform_size =
+        this->layer_param_.transform_param().label_transform_size();
+    CHECK(label_transform_size == 0 || label_transform_size == LabelDimension)
+        << "Specify either no label_transform or " << LabelDimension
+        << " of them (one per label dimension).";
     vector<int> label_shape(4);
     label_shape[0] = batch_size;
     label_shape[1] = 1;
@@ -75,8 +112,6 @@ bool DataLayer<Dtype>::Skip() {
   return !keep;
 }
 
-#include <random>
-
 template<typename Dtype>
 void DataLayer<Dtype>::Next() {
   // DeepDrivingChanges: Introduce a random shuffle for the leveldb database by sometimes
@@ -86,26 +121,135 @@ void DataLayer<Dtype>::Next() {
   // the decision to not randomly shuffle LevelDB databases in Caffe by default, I can
   // not understand why there is no option to force shuffle anyway, if the customer is
   // willing to pay the performance penalty.
-  std::uniform_int_distribution<int> Random(0, 0xFFF);
-  int SkipFrames = Random(RandomGenerator);
-  //int SkipFrames = 0;
+  int SkipFrames = this->layer_param_.data_param().shuffle() ?
+      RandomGenerator.Uniform(0x1000) : 0;
+
+  // With a dataset cache the cursor is only moved by Read(), if the record is
+  // not cached. Only the wrap around at the end of the database needs it.
+  if (cache_ && current_key_ + SkipFrames + 1 <= last_key_) {
+    current_key_ += SkipFrames + 1;
+    cursor_synced_ = false;
+    offset_++;
+    return;
+  }
+
+  SyncCursor();
   cursor_->Next(SkipFrames+1);
 
   while(!cursor_->valid()) {
     /*LOG_IF(INFO, Caffe::root_solver())
         << "Restarting data prefetching from start.";*/
     cursor_->SeekToFirst();
-    std::uniform_int_distribution<int> Random(0, SkipFrames);
-    SkipFrames = Random(RandomGenerator);
+    SkipFrames = RandomGenerator.Uniform(SkipFrames + 1);
     cursor_->Next(SkipFrames);
   }
 
   //std::cout << "*** Chose frame " << cursor_->key() << " by random." << std::endl;
   //std::cout.flush();
 
+  current_key_ = std::atoi(cursor_->key().c_str());
   offset_++;
 }
 
+template<typename Dtype>
+void DataLayer<Dtype>::SyncCursor() {
+  if (!cursor_synced_) {
+    cursor_->Seek(format_int(current_key_, 8));
+    cursor_synced_ = true;
+  }
+}
+
+template<typename Dtype>
+void DataLayer<Dtype>::Read(Datum* datum) {
+  if (cache_ && cache_->Get(current_key_, datum)) {
+    return;
+  }
+  // If the key does not exist, the cursor moves to the next existing one.
+  SyncCursor();
+  current_key_ = std::atoi(cursor_->key().c_str());
+  datum->ParseFromString(cursor_->value());
+  if (cache_) {
+    cache_->Put(current_key_, *datum);
+  }
+}
+
+// Decodes the current record in place, without copying the image out of the
+// database. Returns false if the record needs to be read as a Datum.
+template<typename Dtype>
+bool DataLayer<Dtype>::ReadView(DatumView* datum) {
+  SyncCursor();
+  current_key_ = std::atoi(cursor_->key().c_str());
+  const void* data;
+  size_t size;
+  cursor_->value_data(&data, &size);
+  CHECK(datum->Parse(data, size)) << "Record " << cursor_->key()
+                                  << " is not a Datum.";
+  return !datum->encoded();
+}
+
+template<typename Dtype>
+vector<int> DataLayer<Dtype>::WindowShape(const vector<int>& frame_shape,
+    int batch_size) {
+  vector<int> shape = frame_shape;
+  shape[0] = batch_size;
+  if (frames_ > 1) {
+    if (this->layer_param_.data_param().frame_stacking() ==
+        DataParameter_FrameStacking_TIME) {
+      shape.insert(shape.begin() + 1, frames_);
+    } else {
+      shape[1] *= frames_;
+    }
+  }
+  return shape;
+}
+
+template<typename Dtype>
+const Datum& DataLayer<Dtype>::ReadFrame(int64_t key) {
+  int slot = key % ring_.size();
+  if (ring_keys_[slot] == key) {
+    return ring_[slot];
+  }
+  if (cache_ && cache_->Get(key, &ring_[slot])) {
+    ring_keys_[slot] = key;
+    return ring_[slot];
+  }
+  // The cursor does not point to the current record anymore. If the key does
+  // not exist, the cursor moves to the next existing one, which is the key
+  // the record is stored under.
+  cursor_->Seek(format_int(key, 8));
+  cursor_synced_ = false;
+  key = std::atoi(cursor_->key().c_str());
+  slot = key % ring_.size();
+  if (ring_keys_[slot] != key) {
+    ring_[slot].ParseFromString(cursor_->value());
+    ring_keys_[slot] = key;
+    if (cache_) {
+      cache_->Put(key, ring_[slot]);
+    }
+  }
+  return ring_[slot];
+}
+
+template<typename Dtype>
+void DataLayer<Dtype>::ReadWindow(vector<const Datum*>* window) {
+  const int frames = window->size();
+  // The current record is read first, since this resolves missing keys.
+  int slot = current_key_ % ring_.size();
+  if (ring_keys_[slot] != current_key_) {
+    Datum datum;
+    Read(&datum);
+    slot = current_key_ % ring_.size();
+    ring_[slot].Swap(&datum);
+    ring_keys_[slot] = current_key_;
+  }
+  (*window)[frames - 1] = &ring_[slot];
+  for (int f = frames - 2; f >= 0; --f) {
+    const int64_t key = std::max(first_key_,
+        current_key_ - static_cast<int64_t>(frames - 1 - f) * frame_stride_);
+    (*window)[f] = &ReadFrame(key);
+  }
+}
+
 // This function is called on prefetch thread
 template<typename Dtype>
 void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
@@ -119,40 +263,65 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   const int batch_size = this->layer_param_.data_param().batch_size();
 
   Datum datum;
+  DatumView view;
+  vector<const Datum*> window(frames_);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
     timer.Start();
     while (Skip()) {
       Next();
     }
-    datum.ParseFromString(cursor_->value());
+    // Single uncached frames are transformed straight from the database.
+    const bool use_view = frames_ == 1 && !cache_ && ReadView(&view);
+    if (use_view) {
+      window[0] = NULL;
+    } else if (frames_ > 1) {
+      ReadWindow(&window);
+    } else {
+      Read(&datum);
+      window[0] = &datum;
+    }
+    const Datum* current = window.back();
     read_time += timer.MicroSeconds();
 
     if (item_id == 0) {
       // Reshape according to the first datum of each batch
       // on single input batches allows for inputs of varying dimension.
       // Use data_transformer to infer the expected blob shape from datum.
-      vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
-      this->transformed_data_.Reshape(top_shape);
+      const vector<int> frame_shape = use_view ?
+          this->data_transformer_->InferBlobShape(view) :
+          this->data_transformer_->InferBlobShape(*current);
+      this->transformed_data_.Reshape(frame_shape);
       // Reshape batch according to the batch_size.
-      top_shape[0] = batch_size;
-      batch->data_.Reshape(top_shape);
+      batch->data_.Reshape(WindowShape(frame_shape, batch_size));
     }
 
-    // Apply data transformations (mirror, scale, crop...)
+    // Apply data transformations (mirror, scale, crop...), the frames of a
+    // window are stored one after the other.
     timer.Start();
-    int offset = batch->data_.offset(item_id);
-    Dtype* top_data = batch->data_.mutable_cpu_data();
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
+    const int frame_size = this->transformed_data_.count();
+    Dtype* top_data = batch->data_.mutable_cpu_data() +
+        item_id * frames_ * frame_size;
+    if (use_view) {
+      this->transformed_data_.set_cpu_data(top_data);
+      this->data_transformer_->Transform(view, &(this->transformed_data_));
+    } else {
+      for (int f = 0; f < frames_; ++f) {
+        this->transformed_data_.set_cpu_data(top_data + f * frame_size);
+        this->data_transformer_->Transform(*window[f],
+            &(this->transformed_data_));
+      }
+    }
 
-    // Copy labels (all 14)
+    // Copy labels (all 14) and apply the label transformation
     if (this->output_labels_)
     {
       Dtype* top_label = batch->label_.mutable_cpu_data();
-
-      for (int j = 0; j < LabelDimension; ++j)
-      {
-        top_label[item_id*LabelDimension+j] = datum.float_data(j);
+      if (use_view) {
+        this->data_transformer_->TransformLabel(view, LabelDimension,
+            top_label + item_id * LabelDimension);
+      } else {
+        this->data_transformer_->TransformLabel(*current, LabelDimension,
+            top_label + item_id * LabelDimension);
       }
     }
 
@@ -164,6 +333,10 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  if (cache_) {
+    DLOG(INFO) << "    Cache hits: " << cache_->hits() << ", misses: "
+               << cache_->misses();
+  }
 }
 
 INSTANTIATE_CLASS(DataLayer);
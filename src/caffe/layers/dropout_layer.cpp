@@ -1,12 +1,28 @@
 // TODO (sergeyk): effect should not be dependent on phase. wasted memcpy.
 
+#include <boost/bind.hpp>
+
 #include <vector>
 
 #include "caffe/layers/dropout_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/philox.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Computes y = x * mask * scale on [begin, end), run by parallel_for.
+template <typename Dtype>
+void dropout_range(const Dtype* x, const unsigned int* mask, Dtype scale,
+    Dtype* y, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    y[i] = x[i] * mask[i] * scale;
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void DropoutLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -35,11 +51,13 @@ void DropoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   unsigned int* mask = rand_vec_.mutable_cpu_data();
   const int count = bottom[0]->count();
   if (this->phase_ == TRAIN) {
-    // Create random numbers
-    caffe_rng_bernoulli(count, 1. - threshold_, mask);
-    for (int i = 0; i < count; ++i) {
-      top_data[i] = bottom_data[i] * mask[i] * scale_;
-    }
+    // The mask is generated in parallel from a Philox stream whose key is
+    // drawn from the Caffe RNG, so it is reproducible from the random seed
+    uint64_t key = static_cast<uint64_t>(caffe_rng_rand()) << 32;
+    key |= caffe_rng_rand();
+    philox_bernoulli(count, 1. - threshold_, key, 0, mask);
+    parallel_for(count, boost::bind(&dropout_range<Dtype>, bottom_data, mask,
+        scale_, top_data, _1, _2));
   } else {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -55,9 +73,8 @@ void DropoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (this->phase_ == TRAIN) {
       const unsigned int* mask = rand_vec_.cpu_data();
       const int count = bottom[0]->count();
-      for (int i = 0; i < count; ++i) {
-        bottom_diff[i] = top_diff[i] * mask[i] * scale_;
-      }
+      parallel_for(count, boost::bind(&dropout_range<Dtype>, top_diff, mask,
+          scale_, bottom_diff, _1, _2));
     } else {
       caffe_copy(top[0]->count(), top_diff, bottom_diff);
     }
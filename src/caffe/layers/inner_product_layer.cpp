@@ -86,13 +86,50 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
-  if (bias_term_) {
+  const QuantizationParameter& quantization_param =
+      this->layer_param_.quantization_param();
+  const bool fused_relu = this->layer_param_.has_relu_param();
+  const Dtype negative_slope = fused_relu ?
+      this->layer_param_.relu_param().negative_slope() : Dtype(0);
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  if (this->phase_ == TEST &&
+      this->layer_param_.inner_product_param().pack_weights() &&
+      quantization_param.precision() == QuantizationParameter_Precision_FLOAT
+      && M_ <= PackedMatrix<Dtype>::kMaxRows) {
+    if (derived_weights_.Update(this->blobs_[0]->data())) {
+      packed_weights_.Pack(N_, K_, weight, transpose_);
+    }
+    // the bias and the fused ReLU are applied to the outputs of each panel
+    packed_weights_.Multiply(M_, bottom_data, bias, fused_relu,
+                             negative_slope, top_data);
+    return;
+  }
+  if (this->phase_ == TEST && quantization_param.precision() !=
+      QuantizationParameter_Precision_FLOAT) {
+    if (derived_weights_.Update(this->blobs_[0]->data())) {
+      quantized_weights_.Quantize(quantization_param, N_, K_, weight,
+                                  transpose_);
+    }
+    quantized_weights_.Multiply(M_, bottom_data, false, top_data, false);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
+  if (fused_relu) {
+    // the bias and the fused ReLU in one pass over the output
+    for (int m = 0; m < M_; ++m) {
+      Dtype* top_row = top_data + m * N_;
+      for (int n = 0; n < N_; ++n) {
+        const Dtype value = bias ? top_row[n] + bias[n] : top_row[n];
+        top_row[n] = value > 0 ? value : value * negative_slope;
+      }
+    }
+  } else if (M_ == 1 && bias) {
+    caffe_axpy<Dtype>(N_, Dtype(1), bias, top_data);
+  } else if (bias) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
-        bias_multiplier_.cpu_data(),
-        this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
+        bias_multiplier_.cpu_data(), bias, (Dtype)1., top_data);
   }
 }
 
@@ -100,6 +137,8 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.has_relu_param())
+      << "Fused ReLUs are only supported for inference.";
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
@@ -1,8 +1,11 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
 #include <cfloat>
 #include <vector>
 
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/lrn.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -73,6 +76,16 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT(pad_h_, kernel_h_);
     CHECK_LT(pad_w_, kernel_w_);
   }
+  if (this->layer_param_.has_lrn_param()) {
+    const LRNParameter& lrn_param = this->layer_param_.lrn_param();
+    CHECK_EQ(lrn_param.norm_region(), LRNParameter_NormRegion_ACROSS_CHANNELS)
+        << "Pooling layers only fuse LRNs across channels.";
+    CHECK_EQ(lrn_param.local_size() % 2, 1)
+        << "LRN only supports odd values for local_size";
+  }
+  if (pool_param.cpu_threads() != 1) {
+    thread_pool_.reset(new ThreadPool(pool_param.cpu_threads()));
+  }
 }
 
 template <typename Dtype>
@@ -122,101 +135,60 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+namespace {
+
+// Max or average pools a row of pooled_width outputs from the pooled rows
+// of a window, whose columns are padded to (pooled_width - 1) * stride +
+// kernel values. The common kernels and strides are template parameters, 0
+// means the kernel or stride argument.
+template <typename Dtype, int K, int S>
+void pool_row(bool is_max, const Dtype* row, int kernel, int stride,
+    int pooled_width, Dtype* output) {
+  const int k = K ? K : kernel;
+  const int s = S ? S : stride;
+  if (is_max) {
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      const Dtype* window = row + pw * s;
+      Dtype value = window[0];
+      for (int i = 1; i < k; ++i) {
+        value = std::max(value, window[i]);
+      }
+      output[pw] = value;
+    }
+  } else {
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      const Dtype* window = row + pw * s;
+      Dtype value = window[0];
+      for (int i = 1; i < k; ++i) {
+        value += window[i];
+      }
+      output[pw] = value;
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
+  int* mask = NULL;
   Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
+    // The mask is only used by the backward pass, which nets that only run
+    // forward turn off.
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
+    } else if (this->layer_param_.pooling_param().store_mask()) {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -224,11 +196,156 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   default:
     LOG(FATAL) << "Unknown pooling method.";
   }
+  // The planes are pooled in tasks of a few planes each. The fused LRN is
+  // applied to each image right after it is pooled, while the image is still
+  // in the cache, so each task pools an image.
+  const int threads = thread_pool_ ? thread_pool_->threads() : 1;
+  row_buffers_.resize(threads);
+  for (int i = 0; i < threads; ++i) {
+    row_buffers_[i].resize((pooled_width_ - 1) * stride_w_ + kernel_w_);
+  }
+  const int planes = bottom[0]->num() * channels_;
+  const int task_planes = this->layer_param_.has_lrn_param() ? channels_
+      : (planes + 4 * threads - 1) / (4 * threads);
+  const int tasks = (planes + task_planes - 1) / task_planes;
+  if (thread_pool_) {
+    thread_pool_->Run(tasks, boost::bind(
+        &PoolingLayer<Dtype>::forward_cpu_task, this, bottom_data, top_data,
+        top_mask, mask, planes, task_planes, _1, _2));
+  } else {
+    for (int task = 0; task < tasks; ++task) {
+      forward_cpu_task(bottom_data, top_data, top_mask, mask, planes,
+          task_planes, task, 0);
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::forward_cpu_task(const Dtype* bottom_data,
+    Dtype* top_data, Dtype* top_mask, int* mask, int planes, int task_planes,
+    int task, int thread) {
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  const int begin = task * task_planes;
+  const int end = min(begin + task_planes, planes);
+  for (int p = begin; p < end; ++p) {
+    if (top_mask || mask) {
+      max_pool_plane_masked(bottom_data + p * bottom_dim,
+          top_data + p * top_dim, top_mask ? top_mask + p * top_dim : NULL,
+          mask ? mask + p * top_dim : NULL);
+    } else {
+      pool_plane(bottom_data + p * bottom_dim, top_data + p * top_dim,
+          &row_buffers_[thread][0]);
+    }
+  }
+  if (this->layer_param_.has_lrn_param()) {
+    lrn_forward_cpu(top_data + begin * top_dim);
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::max_pool_plane_masked(const Dtype* input,
+    Dtype* output, Dtype* top_mask, int* mask) {
+  for (int ph = 0; ph < pooled_height_; ++ph) {
+    for (int pw = 0; pw < pooled_width_; ++pw) {
+      int hstart = ph * stride_h_ - pad_h_;
+      int wstart = pw * stride_w_ - pad_w_;
+      int hend = min(hstart + kernel_h_, height_);
+      int wend = min(wstart + kernel_w_, width_);
+      hstart = max(hstart, 0);
+      wstart = max(wstart, 0);
+      const int pool_index = ph * pooled_width_ + pw;
+      Dtype value = -FLT_MAX;
+      int max_index = -1;
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          const int index = h * width_ + w;
+          if (input[index] > value) {
+            value = input[index];
+            max_index = index;
+          }
+        }
+      }
+      output[pool_index] = value;
+      if (top_mask) {
+        top_mask[pool_index] = static_cast<Dtype>(max_index);
+      } else {
+        mask[pool_index] = max_index;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::pool_plane(const Dtype* input, Dtype* output,
+    Dtype* row) {
+  const bool is_max = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  // The row holds the columns [-pad_w_, (pooled_width_ - 1) * stride_w_ +
+  // kernel_w_ - pad_w_) of the pooled rows of a window, the columns outside
+  // of the input are padded with values that do not change the result.
+  const int row_size = (pooled_width_ - 1) * stride_w_ + kernel_w_;
+  const int row_width = min(width_, row_size - pad_w_);
+  const Dtype padding = is_max ? Dtype(-FLT_MAX) : Dtype(0);
+  caffe_set(pad_w_, padding, row);
+  caffe_set(row_size - pad_w_ - row_width, padding,
+      row + pad_w_ + row_width);
+  Dtype* row_data = row + pad_w_;
+  for (int ph = 0; ph < pooled_height_; ++ph) {
+    const int hstart = ph * stride_h_ - pad_h_;
+    const int hend = min(hstart + kernel_h_, height_ + pad_h_);
+    const int first_h = max(hstart, 0);
+    const int last_h = min(hend, height_);
+    caffe_copy(row_width, input + first_h * width_, row_data);
+    for (int h = first_h + 1; h < last_h; ++h) {
+      const Dtype* input_row = input + h * width_;
+      if (is_max) {
+        for (int w = 0; w < row_width; ++w) {
+          row_data[w] = max(row_data[w], input_row[w]);
+        }
+      } else {
+        for (int w = 0; w < row_width; ++w) {
+          row_data[w] += input_row[w];
+        }
+      }
+    }
+    Dtype* output_row = output + ph * pooled_width_;
+    if (kernel_w_ == 3 && stride_w_ == 2) {
+      pool_row<Dtype, 3, 2>(is_max, row, 3, 2, pooled_width_, output_row);
+    } else if (kernel_w_ == 2 && stride_w_ == 2) {
+      pool_row<Dtype, 2, 2>(is_max, row, 2, 2, pooled_width_, output_row);
+    } else if (kernel_w_ == 3 && stride_w_ == 1) {
+      pool_row<Dtype, 3, 1>(is_max, row, 3, 1, pooled_width_, output_row);
+    } else {
+      pool_row<Dtype, 0, 0>(is_max, row, kernel_w_, stride_w_, pooled_width_,
+          output_row);
+    }
+    if (!is_max) {
+      // the pool size includes the padding but not the columns and rows
+      // after it
+      const int pool_h = hend - hstart;
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        const int wstart = pw * stride_w_ - pad_w_;
+        const int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        output_row[pw] /= pool_h * (wend - wstart);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::lrn_forward_cpu(Dtype* data) {
+  const LRNParameter& lrn_param = this->layer_param_.lrn_param();
+  lrn_across_channels_cpu<Dtype>(channels_, pooled_height_ * pooled_width_,
+      lrn_param.local_size(), lrn_param.alpha(), lrn_param.beta(),
+      lrn_param.k(), data, data, NULL);
 }
 
 template <typename Dtype>
 void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.has_lrn_param())
+      << "Fused LRNs are only supported for inference.";
   if (!propagate_down[0]) {
     return;
   }
@@ -247,6 +364,9 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
+      CHECK(this->layer_param_.pooling_param().store_mask())
+          << "Max pooling stores no mask for the backward pass, set "
+          << "store_mask or use a second top for the mask.";
       mask = max_idx_.cpu_data();
     }
     for (int n = 0; n < top[0]->num(); ++n) {
@@ -0,0 +1,93 @@
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include "caffe/layers/reorder_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Transposes the rows [begin, end) of the rows x cols matrices of in, counted
+// over all the images, into the columns of the cols x rows matrices of out.
+template <typename Dtype>
+static void transpose_rows(const Dtype* in, int rows, int cols, Dtype* out,
+    int begin, int end) {
+  const int dim = rows * cols;
+  for (int i = begin; i < end; ++i) {
+    const int n = i / rows;
+    const int row = i % rows;
+    const Dtype* in_row = in + n * dim + row * cols;
+    Dtype* out_column = out + n * dim + row;
+    for (int col = 0; col < cols; ++col) {
+      out_column[col * rows] = in_row[col];
+    }
+  }
+}
+
+template <typename Dtype>
+static void transpose_images(int num, int rows, int cols, const Dtype* in,
+    Dtype* out) {
+  parallel_for(num * rows, boost::bind(&transpose_rows<Dtype>, in, rows, cols,
+      out, _1, _2), cols);
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  CHECK_NE(top[0], bottom[0]) << this->type() << " Layer does not "
+      "allow in-place computation.";
+  CHECK_EQ(bottom[0]->num_axes(), 4) << "Only 4D blobs can be reordered.";
+  const ReorderParameter& param = this->layer_param_.reorder_param();
+  vector<int> top_shape = bottom[0]->shape();
+  num_ = bottom[0]->shape(0);
+  if (param.bottom_layout() == param.top_layout()) {
+    rows_ = 1;
+    cols_ = bottom[0]->count(1);
+  } else if (param.bottom_layout() == NHWC) {
+    // H x W x C to C x H x W
+    rows_ = bottom[0]->count(1, 3);
+    cols_ = bottom[0]->shape(3);
+    top_shape[1] = bottom[0]->shape(3);
+    top_shape[2] = bottom[0]->shape(1);
+    top_shape[3] = bottom[0]->shape(2);
+  } else {
+    // C x H x W to H x W x C
+    rows_ = bottom[0]->shape(1);
+    cols_ = bottom[0]->count(2);
+    top_shape[1] = bottom[0]->shape(2);
+    top_shape[2] = bottom[0]->shape(3);
+    top_shape[3] = bottom[0]->shape(1);
+  }
+  top[0]->Reshape(top_shape);
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  if (rows_ == 1) {
+    caffe_copy(bottom[0]->count(), bottom[0]->cpu_data(),
+        top[0]->mutable_cpu_data());
+    return;
+  }
+  transpose_images(num_, rows_, cols_, bottom[0]->cpu_data(),
+      top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ReorderLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  if (rows_ == 1) {
+    caffe_copy(top[0]->count(), top[0]->cpu_diff(),
+        bottom[0]->mutable_cpu_diff());
+    return;
+  }
+  // the top images are cols_ x rows_
+  transpose_images(num_, cols_, rows_, top[0]->cpu_diff(),
+      bottom[0]->mutable_cpu_diff());
+}
+
+INSTANTIATE_CLASS(ReorderLayer);
+REGISTER_LAYER_CLASS(Reorder);
+
+}  // namespace caffe
@@ -1,3 +1,5 @@
+#include <boost/bind.hpp>
+
 #include <algorithm>
 #include <vector>
 
@@ -8,6 +10,21 @@
 
 namespace caffe {
 
+namespace {
+
+// Scales the planes [begin, end) of inner_dim values, plane p by
+// scale_data[p % scale_dim]; run by parallel_for.
+template <typename Dtype>
+void scale_planes(const Dtype* bottom_data, const Dtype* scale_data,
+    int scale_dim, int inner_dim, Dtype* top_data, int begin, int end) {
+  for (int p = begin; p < end; ++p) {
+    caffe_cpu_scale(inner_dim, scale_data[p % scale_dim],
+        bottom_data + p * inner_dim, top_data + p * inner_dim);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void ScaleLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -128,14 +145,9 @@ void ScaleLayer<Dtype>::Forward_cpu(
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < outer_dim_; ++n) {
-    for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
-      bottom_data += inner_dim_;
-      top_data += inner_dim_;
-    }
-  }
+  parallel_for(outer_dim_ * scale_dim_, boost::bind(&scale_planes<Dtype>,
+      bottom_data, scale_data, scale_dim_, inner_dim_, top_data, _1, _2),
+      inner_dim_);
   if (bias_layer_) {
     bias_layer_->Forward(bias_bottom_vec_, top);
   }
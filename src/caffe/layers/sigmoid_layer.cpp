@@ -1,23 +1,21 @@
-#include <cmath>
 #include <vector>
 
 #include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
-template <typename Dtype>
-inline Dtype sigmoid(Dtype x) {
-  return 1. / (1. + exp(-x));
-}
-
 template <typename Dtype>
 void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
+  // sigmoid(x) = 0.5 * tanh(0.5 * x) + 0.5, with the vectorized tanh
+  caffe_cpu_scale(count, Dtype(0.5), bottom_data, top_data);
+  caffe_tanh(count, top_data, top_data);
   for (int i = 0; i < count; ++i) {
-    top_data[i] = sigmoid(bottom_data[i]);
+    top_data[i] = Dtype(0.5) * top_data[i] + Dtype(0.5);
   }
 }
 
@@ -13,6 +13,7 @@
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/insert_reorders.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
@@ -51,14 +52,23 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
-  // Create a copy of filtered_param with splits added where necessary.
+  // Convert the NHWC inputs for the layers reading them; only the CPU
+  // inference of convolutions reads them directly.
+  NetParameter reordered_param;
+  InsertReorders(filtered_param, phase_ == TEST &&
+      Caffe::mode() == Caffe::CPU && !filtered_param.force_backward(),
+      &reordered_param);
+  // Create a copy of reordered_param with splits added where necessary.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  InsertSplits(reordered_param, &param);
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
   set<string> available_blobs;
   memory_used_ = 0;
+  if (param.share_workspace()) {
+    workspace_.reset(new Workspace());
+  }
   // For each layer, set up its input and output
   bottom_vecs_.resize(param.layer_size());
   top_vecs_.resize(param.layer_size());
@@ -80,6 +90,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
           << "either 0 or bottom_size times ";
     }
     layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+    layers_.back()->set_workspace(workspace_);
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
         << "Creating Layer " << layer_param.name();
@@ -250,11 +261,186 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   for (size_t layer_id = 0; layer_id < layer_names_.size(); ++layer_id) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
+  if (workspace_ && workspace_->reserved() > 0) {
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Workspace: the layers share " << workspace_->size()
+        << " bytes of temporary buffers instead of "
+        << workspace_->reserved() << " bytes.";
+  }
   ShareWeights();
   debug_info_ = param.debug_info();
+  optimize_memory_ = param.optimize_memory() && phase_ == TEST &&
+      !param.force_backward();
+  if (optimize_memory_) {
+    PlanMemory();
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+// Returns whether the tops of a layer share the data of its (first) bottom
+// after Forward.
+static bool SharesBottomData(const string& type) {
+  return type == "Split" || type == "Flatten" || type == "Reshape";
+}
+
+// Returns the group a group was merged into.
+static int FindGroup(vector<int>* merged_into, int group) {
+  while ((*merged_into)[group] != group) {
+    group = (*merged_into)[group];
+  }
+  return group;
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  // Blobs with the same SyncedMemory form a group with a joint lifetime,
+  // from the first to the last layer that uses one of them. Split and
+  // Flatten layers share their bottom with their tops only in Forward, so
+  // their groups are merged.
+  map<SyncedMemory*, int> memory_group;
+  vector<int> blob_group(blobs_.size());
+  vector<int> merged_into;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    SyncedMemory* memory = blobs_[blob_id]->data().get();
+    if (memory_group.find(memory) == memory_group.end()) {
+      memory_group[memory] = merged_into.size();
+      merged_into.push_back(merged_into.size());
+    }
+    blob_group[blob_id] = memory_group[memory];
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (!SharesBottomData(layers_[layer_id]->layer_param().type())) {
+      continue;
+    }
+    const int group =
+        FindGroup(&merged_into, blob_group[bottom_id_vecs_[layer_id][0]]);
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      merged_into[FindGroup(&merged_into,
+                            blob_group[top_id_vecs_[layer_id][i]])] = group;
+    }
+  }
+  const int num_groups = merged_into.size();
+  vector<int> group_first(num_groups, layers_.size());
+  vector<int> group_last(num_groups, -1);
+  // The size of the memory, not of the blob, since a blob does not
+  // reallocate when it grows again up to its capacity.
+  vector<size_t> group_size(num_groups, 0);
+  vector<bool> group_fixed(num_groups, false);
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    blob_group[blob_id] = FindGroup(&merged_into, blob_group[blob_id]);
+    group_size[blob_group[blob_id]] = std::max(group_size[blob_group[blob_id]],
+        blobs_[blob_id]->data()->size());
+  }
+  // The inputs and outputs must stay valid outside of Forward. The tops of
+  // data layers keep their own memory, since data layers may point them to
+  // their prefetch buffers.
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    group_fixed[blob_group[net_input_blob_indices_[i]]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    group_fixed[blob_group[net_output_blob_indices_[i]]] = true;
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int group = blob_group[bottom_id_vecs_[layer_id][i]];
+      group_first[group] = std::min(group_first[group], layer_id);
+      group_last[group] = std::max(group_last[group], layer_id);
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int group = blob_group[top_id_vecs_[layer_id][i]];
+      group_first[group] = std::min(group_first[group], layer_id);
+      group_last[group] = std::max(group_last[group], layer_id);
+      if (bottom_id_vecs_[layer_id].empty()) {
+        group_fixed[group] = true;
+      }
+    }
+  }
+
+  // In the order of their first use, each group gets the smallest free
+  // memory that is large enough, or else the largest free memory (which
+  // grows), or else new memory. Memory is free after the last layer using it.
+  vector<pair<int, int> > order;
+  for (int group = 0; group < group_size.size(); ++group) {
+    if (!group_fixed[group] && group_last[group] >= 0) {
+      order.push_back(std::make_pair(group_first[group], group));
+    }
+  }
+  std::sort(order.begin(), order.end());
+  vector<size_t> memory_size;
+  vector<int> memory_last;
+  vector<int> group_memory(group_size.size(), -1);
+  size_t unshared_bytes = 0;
+  for (int i = 0; i < order.size(); ++i) {
+    const int group = order[i].second;
+    const size_t size = group_size[group];
+    int best = -1;
+    for (int memory = 0; memory < memory_size.size(); ++memory) {
+      if (memory_last[memory] >= group_first[group]) {
+        continue;
+      }
+      if (best < 0) {
+        best = memory;
+      } else if (memory_size[memory] >= size) {
+        if (memory_size[best] < size ||
+            memory_size[memory] < memory_size[best]) {
+          best = memory;
+        }
+      } else if (memory_size[best] < size &&
+                 memory_size[memory] > memory_size[best]) {
+        best = memory;
+      }
+    }
+    if (best < 0) {
+      best = memory_size.size();
+      memory_size.push_back(0);
+      memory_last.push_back(-1);
+    }
+    memory_size[best] = std::max(memory_size[best], size);
+    memory_last[best] = group_last[group];
+    group_memory[group] = best;
+    unshared_bytes += size;
+  }
+
+  shared_memory_.resize(memory_size.size());
+  size_t shared_bytes = 0;
+  for (int memory = 0; memory < memory_size.size(); ++memory) {
+    shared_memory_[memory].reset(new SyncedMemory(memory_size[memory]));
+    shared_bytes += memory_size[memory];
+  }
+  blob_shared_memory_.assign(blobs_.size(), -1);
+  blob_own_memory_.resize(blobs_.size());
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const int memory = group_memory[blob_group[blob_id]];
+    if (memory >= 0) {
+      blob_shared_memory_[blob_id] = memory;
+      blob_own_memory_[blob_id] = blobs_[blob_id]->data();
+      blobs_[blob_id]->ShareData(shared_memory_[memory]);
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory planning: " << order.size() << " blob groups share "
+      << shared_memory_.size() << " buffers of " << shared_bytes
+      << " bytes instead of " << unshared_bytes << " bytes.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::ReleaseMemoryPlan() {
+  set<SyncedMemory*> shared_memory;
+  for (int i = 0; i < shared_memory_.size(); ++i) {
+    shared_memory.insert(shared_memory_[i].get());
+  }
+  for (int blob_id = 0; blob_id < blob_shared_memory_.size(); ++blob_id) {
+    // A blob that grew beyond the shared memory has already reallocated.
+    if (blob_shared_memory_[blob_id] >= 0 &&
+        shared_memory.count(blobs_[blob_id]->data().get())) {
+      blobs_[blob_id]->ShareData(blob_own_memory_[blob_id]);
+    }
+  }
+  shared_memory_.clear();
+  blob_shared_memory_.clear();
+  blob_own_memory_.clear();
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -724,9 +910,15 @@ void Net<Dtype>::Backward() {
 
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
+  if (optimize_memory_) {
+    ReleaseMemoryPlan();
+  }
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  if (optimize_memory_) {
+    PlanMemory();
+  }
 }
 
 template <typename Dtype>
@@ -1,8 +1,15 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -10,6 +17,156 @@ namespace caffe {
 
 class CommonTest : public ::testing::Test {};
 
+class ParallelForTest : public ::testing::Test {
+ public:
+  ParallelForTest()
+      : threads_(Caffe::cpu_threads()),
+        grain_size_(Caffe::parallel_grain_size()), ranges_(0) {}
+
+  virtual ~ParallelForTest() {
+    Caffe::set_cpu_threads(threads_);
+    Caffe::set_parallel_grain_size(grain_size_);
+  }
+
+  // Counts the calls of each item and of the body.
+  void Count(int begin, int end) {
+    EXPECT_LT(begin, end);
+    for (int i = begin; i < end; ++i) {
+      ++calls_[i];
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    ++ranges_;
+  }
+
+  // Counts the items of the range with a nested parallel_for.
+  void CountNested(int begin, int end) {
+    parallel_for(end - begin, boost::bind(&ParallelForTest::CountOffset, this,
+        begin, _1, _2));
+  }
+
+  void CountOffset(int offset, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      ++calls_[offset + i];
+    }
+  }
+
+  // Counts the 250 items of a ThreadPool task and the ranges of their
+  // parallel_for.
+  void CountTask(int task, int thread) {
+    parallel_for(250, boost::bind(&ParallelForTest::CountRange, this,
+        task * 250, _1, _2));
+  }
+
+  void CountRange(int offset, int begin, int end) {
+    Count(offset + begin, offset + end);
+  }
+
+ protected:
+
+  void CheckCalls(int n) {
+    ASSERT_EQ(n, calls_.size());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(1, calls_[i]) << i;
+    }
+  }
+
+  const int threads_;
+  const int grain_size_;
+  vector<int> calls_;
+  boost::mutex mutex_;
+  int ranges_;
+};
+
+TEST_F(ParallelForTest, TestRanges) {
+  Caffe::set_cpu_threads(4);
+  Caffe::set_parallel_grain_size(100);
+  const int sizes[] = {0, 1, 99, 250, 1000, 12345};
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    const int n = sizes[s];
+    calls_.assign(n, 0);
+    ranges_ = 0;
+    parallel_for(n, boost::bind(&ParallelForTest::Count, this, _1, _2));
+    CheckCalls(n);
+    // split into at most 4 ranges of at least 100 items
+    EXPECT_EQ(std::max(1, std::min(4, n / 100)), n ? ranges_ : 1) << n;
+  }
+}
+
+TEST_F(ParallelForTest, TestItemSize) {
+  Caffe::set_cpu_threads(3);
+  Caffe::set_parallel_grain_size(1000);
+  calls_.assign(17, 0);
+  parallel_for(17, boost::bind(&ParallelForTest::Count, this, _1, _2), 500);
+  CheckCalls(17);
+  EXPECT_EQ(3, ranges_);
+}
+
+TEST_F(ParallelForTest, TestSerial) {
+  Caffe::set_cpu_threads(1);
+  Caffe::set_parallel_grain_size(1);
+  calls_.assign(1000, 0);
+  parallel_for(1000, boost::bind(&ParallelForTest::Count, this, _1, _2));
+  CheckCalls(1000);
+  EXPECT_EQ(1, ranges_);
+}
+
+TEST_F(ParallelForTest, TestNested) {
+  Caffe::set_cpu_threads(4);
+  Caffe::set_parallel_grain_size(10);
+  calls_.assign(1000, 0);
+  parallel_for(1000, boost::bind(&ParallelForTest::CountNested, this, _1,
+      _2));
+  CheckCalls(1000);
+}
+
+TEST_F(ParallelForTest, TestInThreadPool) {
+  Caffe::set_cpu_threads(4);
+  Caffe::set_parallel_grain_size(10);
+  calls_.assign(1000, 0);
+  // the tasks of a pool with several threads do not start more threads
+  ThreadPool pool(2);
+  pool.Run(4, boost::bind(&ParallelForTest::CountTask, this, _1, _2));
+  CheckCalls(1000);
+  EXPECT_EQ(4, ranges_);
+  // a pool of one thread runs the tasks in the calling thread
+  ThreadPool serial_pool(1);
+  calls_.assign(1000, 0);
+  ranges_ = 0;
+  serial_pool.Run(4, boost::bind(&ParallelForTest::CountTask, this, _1, _2));
+  CheckCalls(1000);
+  EXPECT_EQ(16, ranges_);
+}
+
+TEST_F(ParallelForTest, TestMathFunctions) {
+  const int n = 10007;
+  vector<float> a(n);
+  vector<float> b(n);
+  caffe_rng_gaussian<float>(n, 0, 1, &a[0]);
+  caffe_rng_uniform<float>(n, 1, 2, &b[0]);
+  // the results of one thread and of 3 threads are the same
+  vector<float> results[2];
+  for (int run = 0; run < 2; ++run) {
+    Caffe::set_cpu_threads(run ? 3 : 1);
+    Caffe::set_parallel_grain_size(64);
+    vector<float>& y = results[run];
+    y.assign(7 * n, 0);
+    caffe_add(n, &a[0], &b[0], &y[0]);
+    caffe_mul(n, &a[0], &b[0], &y[n]);
+    caffe_exp(n, &a[0], &y[2 * n]);
+    caffe_powx(n, &b[0], 0.75f, &y[3 * n]);
+    caffe_copy(n, &a[0], &y[4 * n]);
+    caffe_axpy(n, 2.f, &b[0], &y[4 * n]);
+    caffe_cpu_scale(n, 3.f, &a[0], &y[5 * n]);
+    caffe_add_scalar(n, 1.f, &y[5 * n]);
+    caffe_set(n, 5.f, &y[6 * n]);
+    caffe_scal(n, 0.5f, &y[6 * n]);
+  }
+  for (int i = 0; i < 7 * n; ++i) {
+    EXPECT_EQ(results[0][i], results[1][i]) << i;
+  }
+  EXPECT_EQ(2.5f, results[1][7 * n - 1]);
+}
+
 #ifndef CPU_ONLY  // GPU Caffe singleton test.
 
 TEST_F(CommonTest, TestCublasHandlerGPU) {
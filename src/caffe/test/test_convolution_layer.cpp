@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -495,6 +497,323 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestMultiThreadedConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // a larger batch than threads, so threads run several images
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[0] = 7;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_cpu_threads(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestMultiThreadedConvolutionGroups) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // a single image, whose groups run in parallel, with a fused ReLU which is
+  // applied to the channels of each group
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[0] = 1;
+  bottom_shape[1] = 4;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  layer_param.mutable_relu_param()->set_negative_slope(0.1);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  convolution_param->set_cpu_threads(2);
+  ConvolutionLayer<Dtype> threaded_layer(layer_param);
+  threaded_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    threaded_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  threaded_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], this->blob_top_->cpu_data()[i], 1e-5);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestCPUAlgorithms) {
+  typedef typename TypeParam::Dtype Dtype;
+  // odd sizes, so the Winograd tiles are cut at the borders
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[2] = 7;
+  bottom_shape[3] = 5;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const ConvolutionParameter::CPUAlgorithm algorithms[] = {
+      ConvolutionParameter_CPUAlgorithm_DIRECT,
+      ConvolutionParameter_CPUAlgorithm_WINOGRAD,
+      ConvolutionParameter_CPUAlgorithm_TILED,
+      ConvolutionParameter_CPUAlgorithm_AUTOTUNE};
+  for (int i = 0; i < 4; ++i) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_pad(1);
+    convolution_param->set_num_output(6);
+    convolution_param->set_group(3);
+    convolution_param->set_cpu_algorithm(algorithms[i]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("constant");
+    convolution_param->mutable_bias_filler()->set_value(0.1);
+    shared_ptr<Layer<Dtype> > layer(
+        new ConvolutionLayer<Dtype>(layer_param));
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Check against reference convolution.
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int j = 0; j < this->blob_top_->count(); ++j) {
+      EXPECT_NEAR(top_data[j], ref_top_data[j], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestWinogradChangedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->set_cpu_algorithm(
+      ConvolutionParameter_CPUAlgorithm_WINOGRAD);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // the weights are transformed again after they changed, and after the
+  // shape of the input changed
+  for (int pass = 0; pass < 3; ++pass) {
+    if (pass == 1) {
+      caffe_scal<Dtype>(layer->blobs()[0]->count(), Dtype(-2),
+          layer->blobs()[0]->mutable_cpu_data());
+    } else if (pass == 2) {
+      vector<int> bottom_shape = this->blob_bottom_->shape();
+      bottom_shape[2] = 4;
+      this->blob_bottom_->Reshape(bottom_shape);
+      layer->Reshape(this->blob_bottom_vec_, this->blob_top_vec_);
+    }
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectConvolutionStrided) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_kernel_h(3);
+  convolution_param->set_kernel_w(2);
+  convolution_param->set_stride_h(2);
+  convolution_param->set_stride_w(3);
+  convolution_param->set_pad_h(2);
+  convolution_param->set_pad_w(1);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(4);
+  convolution_param->set_cpu_algorithm(
+      ConvolutionParameter_CPUAlgorithm_DIRECT);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestTiledConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // wide enough for several column tiles, the last one partial
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[1] = 32;
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 40;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  // kernel size, stride, pad, dilation and group; the last one is 1x1
+  const int configs[][5] = {{5, 1, 2, 1, 2}, {3, 2, 1, 2, 1}, {1, 1, 0, 1, 4}};
+  for (int i = 0; i < 3; ++i) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(configs[i][0]);
+    convolution_param->add_stride(configs[i][1]);
+    convolution_param->add_pad(configs[i][2]);
+    convolution_param->add_dilation(configs[i][3]);
+    convolution_param->set_group(configs[i][4]);
+    convolution_param->set_num_output(8);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> gemm_layer(layer_param);
+    gemm_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    gemm_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> gemm_top;
+    gemm_top.CopyFrom(*this->blob_top_, false, true);
+    filler.Fill(this->blob_top_vec_[0]);
+    caffe_copy(this->blob_top_->count(), this->blob_top_->cpu_data(),
+        this->blob_top_->mutable_cpu_diff());
+    const vector<bool> propagate_down(1, true);
+    gemm_layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    Blob<Dtype> gemm_bottom_diff;
+    gemm_bottom_diff.CopyFrom(*this->blob_bottom_, true, true);
+    // the tiled layer with the same weights and output gradient
+    convolution_param->set_cpu_algorithm(
+        ConvolutionParameter_CPUAlgorithm_TILED);
+    ConvolutionLayer<Dtype> tiled_layer(layer_param);
+    tiled_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int j = 0; j < 2; ++j) {
+      tiled_layer.blobs()[j]->CopyFrom(*gemm_layer.blobs()[j]);
+    }
+    Blob<Dtype> top_diff;
+    top_diff.CopyFrom(*this->blob_top_, true, true);
+    tiled_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int j = 0; j < this->blob_top_->count(); ++j) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[j], gemm_top.cpu_data()[j],
+          1e-4);
+    }
+    caffe_copy(top_diff.count(), top_diff.cpu_diff(),
+        this->blob_top_->mutable_cpu_diff());
+    tiled_layer.Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    for (int j = 0; j < this->blob_bottom_->count(); ++j) {
+      EXPECT_NEAR(this->blob_bottom_->cpu_diff()[j],
+          gemm_bottom_diff.cpu_diff()[j], 1e-4);
+    }
+    for (int j = 0; j < 2; ++j) {
+      const Blob<Dtype>& gemm_diff = *gemm_layer.blobs()[j];
+      const Blob<Dtype>& tiled_diff = *tiled_layer.blobs()[j];
+      for (int k = 0; k < gemm_diff.count(); ++k) {
+        EXPECT_NEAR(tiled_diff.cpu_diff()[k], gemm_diff.cpu_diff()[k],
+            1e-3 * std::max(Dtype(1), std::fabs(gemm_diff.cpu_diff()[k])));
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestNHWCConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[1] = 4;
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  // the bottom in the NHWC layout
+  const Blob<Dtype>& bottom = *this->blob_bottom_;
+  Blob<Dtype> nhwc_bottom(bottom.num(), bottom.height(), bottom.width(),
+      bottom.channels());
+  for (int n = 0; n < bottom.num(); ++n) {
+    for (int c = 0; c < bottom.channels(); ++c) {
+      for (int h = 0; h < bottom.height(); ++h) {
+        for (int w = 0; w < bottom.width(); ++w) {
+          nhwc_bottom.mutable_cpu_data()[nhwc_bottom.offset(n, h, w, c)] =
+              bottom.data_at(n, c, h, w);
+        }
+      }
+    }
+  }
+  const vector<Blob<Dtype>*> nhwc_bottom_vec(1, &nhwc_bottom);
+  // kernel size, stride, pad, group and cpu_threads; the last one is 1x1
+  const int configs[][5] = {{3, 2, 1, 2, 1}, {3, 1, 1, 1, 2}, {1, 1, 0, 4, 1}};
+  for (int i = 0; i < 3; ++i) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(configs[i][0]);
+    convolution_param->add_stride(configs[i][1]);
+    convolution_param->add_pad(configs[i][2]);
+    convolution_param->set_group(configs[i][3]);
+    convolution_param->set_cpu_threads(configs[i][4]);
+    convolution_param->set_num_output(8);
+    convolution_param->set_input_layout(NHWC);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(nhwc_bottom_vec, this->blob_top_vec_);
+    layer.Forward(nhwc_bottom_vec, this->blob_top_vec_);
+    // Check against reference convolution of the NCHW bottom.
+    caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    ASSERT_TRUE(this->blob_top_->shape() == this->ref_blob_top_->shape());
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int j = 0; j < this->blob_top_->count(); ++j) {
+      EXPECT_NEAR(top_data[j], ref_top_data[j], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -811,6 +1130,25 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestGradientGroupTiled) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_cpu_algorithm(
+      ConvolutionParameter_CPUAlgorithm_TILED);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -1,4 +1,5 @@
 #ifdef USE_OPENCV
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -11,6 +12,7 @@
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -67,6 +69,36 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     db->Close();
   }
 
+  // Fill the DB with records as written by the driving data tools: keys are
+  // zero-padded frame numbers and the labels are 14 float_data values. The
+  // 45 byte images leave the labels of a cached record unaligned.
+  void FillFrames(const int num, DataParameter_DB backend) {
+    backend_ = backend;
+    LOG(INFO) << "Using temporary dataset " << *filename_;
+    scoped_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(*filename_, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < num; ++i) {
+      Datum datum;
+      datum.set_label(i);
+      datum.set_channels(3);
+      datum.set_height(3);
+      datum.set_width(5);
+      std::string* data = datum.mutable_data();
+      for (int j = 0; j < 45; ++j) {
+        data->push_back(static_cast<uint8_t>(i * 3 + j));
+      }
+      for (int k = 0; k < 14; ++k) {
+        datum.add_float_data(i * 100 + k);
+      }
+      string out;
+      CHECK(datum.SerializeToString(&out));
+      txn->Put(format_int(i, 8), out);
+    }
+    txn->Commit();
+    db->Close();
+  }
+
   void TestRead() {
     const Dtype scale = 3;
     LayerParameter param;
@@ -362,6 +394,111 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // The dataset cache must return the same records as the database.
+  void TestReadCached() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(4);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+
+    Caffe::set_random_seed(seed_);
+    vector<vector<Dtype> > data_sequence;
+    vector<vector<Dtype> > label_sequence;
+    {
+      DataLayer<Dtype> layer1(param);
+      layer1.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 10; ++iter) {
+        layer1.Forward(blob_bottom_vec_, blob_top_vec_);
+        data_sequence.push_back(vector<Dtype>(blob_top_data_->cpu_data(),
+            blob_top_data_->cpu_data() + blob_top_data_->count()));
+        label_sequence.push_back(vector<Dtype>(blob_top_label_->cpu_data(),
+            blob_top_label_->cpu_data() + blob_top_label_->count()));
+      }
+    }  // destroy 1st data layer and unlock the db
+
+    // Reseed so that the cached layer visits the same records, the records
+    // seen more than once come from the cache.
+    data_param->set_cache_size_mb(1);
+    Caffe::set_random_seed(seed_);
+    DataLayer<Dtype> layer2(param);
+    layer2.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(blob_top_label_->count(), 4 * 14);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer2.Forward(blob_bottom_vec_, blob_top_vec_);
+      ASSERT_EQ(blob_top_data_->count(),
+                static_cast<int>(data_sequence[iter].size()));
+      for (int i = 0; i < blob_top_data_->count(); ++i) {
+        EXPECT_EQ(data_sequence[iter][i], blob_top_data_->cpu_data()[i])
+            << "debug: iter " << iter << " i " << i;
+      }
+      for (int i = 0; i < blob_top_label_->count(); ++i) {
+        EXPECT_EQ(label_sequence[iter][i], blob_top_label_->cpu_data()[i])
+            << "debug: iter " << iter << " i " << i;
+      }
+    }
+  }
+
+  // Reads the records in order as windows of 3 frames, 2 keys apart.
+  void TestReadWindow(DataParameter_FrameStacking stacking,
+                      uint32_t cache_size_mb) {
+    const int frames = 3;
+    const int frame_stride = 2;
+    const int batch_size = 4;
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(batch_size);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle(false);
+    data_param->set_frames(frames);
+    data_param->set_frame_stride(frame_stride);
+    data_param->set_frame_stacking(stacking);
+    data_param->set_cache_size_mb(cache_size_mb);
+
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    vector<int> shape;
+    shape.push_back(batch_size);
+    if (stacking == DataParameter_FrameStacking_TIME) {
+      shape.push_back(frames);
+      shape.push_back(3);
+    } else {
+      shape.push_back(frames * 3);
+    }
+    shape.push_back(3);
+    shape.push_back(5);
+    EXPECT_EQ(shape, blob_top_data_->shape());
+    EXPECT_EQ(batch_size, blob_top_label_->num());
+    EXPECT_EQ(14, blob_top_label_->width());
+
+    // 5 batches of 4 samples wrap around the 10 records twice.
+    for (int iter = 0; iter < 5; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      EXPECT_EQ(shape, blob_top_data_->shape());
+      for (int i = 0; i < batch_size; ++i) {
+        const int key = (iter * batch_size + i) % 10;
+        for (int f = 0; f < frames; ++f) {
+          // At the start of the database the first record is repeated.
+          const int frame_key = std::max(0,
+              key - (frames - 1 - f) * frame_stride);
+          for (int j = 0; j < 45; ++j) {
+            EXPECT_EQ(frame_key * 3 + j,
+                blob_top_data_->cpu_data()[(i * frames + f) * 45 + j])
+                << "debug: iter " << iter << " i " << i << " f " << f;
+          }
+        }
+        // The labels are the ones of the last frame.
+        for (int k = 0; k < 14; ++k) {
+          EXPECT_EQ(key * 100 + k, blob_top_label_->cpu_data()[i * 14 + k])
+              << "debug: iter " << iter << " i " << i << " k " << k;
+        }
+      }
+    }
+  }
+
   virtual ~DataLayerTest() { delete blob_top_data_; delete blob_top_label_; }
 
   DataParameter_DB backend_;
@@ -418,6 +555,26 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLevelDB) {
   this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
   this->TestReadCrop(TEST);
 }
+
+TYPED_TEST(DataLayerTest, TestReadCachedLevelDB) {
+  this->FillFrames(10, DataParameter_DB_LEVELDB);
+  this->TestReadCached();
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowChannelLevelDB) {
+  this->FillFrames(10, DataParameter_DB_LEVELDB);
+  this->TestReadWindow(DataParameter_FrameStacking_CHANNEL, 0);
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowTimeLevelDB) {
+  this->FillFrames(10, DataParameter_DB_LEVELDB);
+  this->TestReadWindow(DataParameter_FrameStacking_TIME, 0);
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowCachedLevelDB) {
+  this->FillFrames(10, DataParameter_DB_LEVELDB);
+  this->TestReadWindow(DataParameter_FrameStacking_CHANNEL, 1);
+}
 #endif  // USE_LEVELDB
 
 #ifdef USE_LMDB
@@ -464,6 +621,26 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLMDB) {
   this->TestReadCrop(TEST);
 }
 
+TYPED_TEST(DataLayerTest, TestReadCachedLMDB) {
+  this->FillFrames(10, DataParameter_DB_LMDB);
+  this->TestReadCached();
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowChannelLMDB) {
+  this->FillFrames(10, DataParameter_DB_LMDB);
+  this->TestReadWindow(DataParameter_FrameStacking_CHANNEL, 0);
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowTimeLMDB) {
+  this->FillFrames(10, DataParameter_DB_LMDB);
+  this->TestReadWindow(DataParameter_FrameStacking_TIME, 0);
+}
+
+TYPED_TEST(DataLayerTest, TestReadWindowCachedLMDB) {
+  this->FillFrames(10, DataParameter_DB_LMDB);
+  this->TestReadWindow(DataParameter_FrameStacking_CHANNEL, 1);
+}
+
 #endif  // USE_LMDB
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -340,5 +340,48 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestEmptyLabelTransform) {
+  TransformationParameter transform_param;
+  const int label_dim = 3;
+
+  Datum datum;
+  for (int j = 0; j < label_dim; ++j) {
+    datum.add_float_data(j - 1.5);
+  }
+  TypeParam labels[label_dim];
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.TransformLabel(datum, label_dim, labels);
+  for (int j = 0; j < label_dim; ++j) {
+    EXPECT_EQ(labels[j], j - 1.5);
+  }
+}
+
+TYPED_TEST(DataTransformTest, TestLabelTransform) {
+  TransformationParameter transform_param;
+  const int label_dim = 3;
+
+  LabelTransformParameter* label_transform =
+      transform_param.add_label_transform();
+  label_transform->set_scale(0.5);
+  label_transform->set_shift(1);
+  label_transform = transform_param.add_label_transform();
+  label_transform->set_scale(2);
+  label_transform->set_min(0);
+  label_transform = transform_param.add_label_transform();
+  label_transform->set_shift(-1);
+  label_transform->set_max(0.25);
+
+  Datum datum;
+  datum.add_float_data(3);
+  datum.add_float_data(-1);
+  datum.add_float_data(2);
+  TypeParam labels[label_dim];
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.TransformLabel(datum, label_dim, labels);
+  EXPECT_EQ(labels[0], 2.5);
+  EXPECT_EQ(labels[1], 0);
+  EXPECT_EQ(labels[2], 0.25);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
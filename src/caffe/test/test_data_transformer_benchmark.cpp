@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Compares the vectorized uint8 path of DataTransformer with the generic
+// per-pixel loop for the shape of a DeepDriving frame (mean file, scale, no
+// crop or mirror) and logs the time of both.
+template <typename Dtype>
+class DataTransformBenchmarkTest : public ::testing::Test {
+ protected:
+  DataTransformBenchmarkTest()
+      : channels_(3), height_(210), width_(280), num_iter_(50) {}
+
+  virtual void SetUp() {
+    const int size = channels_ * height_ * width_;
+    datum_.set_channels(channels_);
+    datum_.set_height(height_);
+    datum_.set_width(width_);
+    std::string* data = datum_.mutable_data();
+    BlobProto blob_mean;
+    blob_mean.set_num(1);
+    blob_mean.set_channels(channels_);
+    blob_mean.set_height(height_);
+    blob_mean.set_width(width_);
+    for (int j = 0; j < size; ++j) {
+      data->push_back(static_cast<uint8_t>((j * 7) % 256));
+      blob_mean.add_data((j % 255) * 0.5);
+    }
+    MakeTempFilename(&mean_file_);
+    WriteProtoToBinaryFile(blob_mean, mean_file_);
+    mean_.FromProto(blob_mean);
+  }
+
+  // The generic loop of DataTransformer::Transform without crop and mirror.
+  void ReferenceTransform(const Dtype scale, Dtype* transformed_data) {
+    const std::string& data = datum_.data();
+    const Dtype* mean = mean_.cpu_data();
+    for (int c = 0; c < channels_; ++c) {
+      for (int h = 0; h < height_; ++h) {
+        for (int w = 0; w < width_; ++w) {
+          const int index = (c * height_ + h) * width_ + w;
+          const Dtype datum_element =
+              static_cast<Dtype>(static_cast<uint8_t>(data[index]));
+          transformed_data[index] = (datum_element - mean[index]) * scale;
+        }
+      }
+    }
+  }
+
+  const int channels_;
+  const int height_;
+  const int width_;
+  const int num_iter_;
+  Datum datum_;
+  string mean_file_;
+  Blob<Dtype> mean_;
+};
+
+TYPED_TEST_CASE(DataTransformBenchmarkTest, TestDtypes);
+
+TYPED_TEST(DataTransformBenchmarkTest, TestUint8MeanFile) {
+  const TypeParam scale = 0.25;
+  TransformationParameter transform_param;
+  transform_param.set_mean_file(this->mean_file_);
+  transform_param.set_scale(scale);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+
+  Blob<TypeParam> blob(1, this->channels_, this->height_, this->width_);
+  Blob<TypeParam> reference(1, this->channels_, this->height_, this->width_);
+
+  CPUTimer timer;
+  timer.Start();
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    this->ReferenceTransform(scale, reference.mutable_cpu_data());
+  }
+  const float reference_time = timer.MicroSeconds() / this->num_iter_;
+  timer.Start();
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    transformer.Transform(this->datum_, &blob);
+  }
+  const float transform_time = timer.MicroSeconds() / this->num_iter_;
+  LOG(INFO) << "Generic loop: " << reference_time << " us, vectorized: "
+            << transform_time << " us per frame.";
+
+  for (int j = 0; j < blob.count(); ++j) {
+    EXPECT_EQ(blob.cpu_data()[j], reference.cpu_data()[j]);
+  }
+}
+
+TYPED_TEST(DataTransformBenchmarkTest, TestUint8NoMean) {
+  const TypeParam scale = 0.5;
+  TransformationParameter transform_param;
+  transform_param.set_scale(scale);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+
+  Blob<TypeParam> blob(1, this->channels_, this->height_, this->width_);
+  transformer.Transform(this->datum_, &blob);
+  const std::string& data = this->datum_.data();
+  for (int j = 0; j < blob.count(); ++j) {
+    EXPECT_EQ(blob.cpu_data()[j],
+        static_cast<TypeParam>(static_cast<uint8_t>(data[j])) * scale);
+  }
+}
+
+}  // namespace caffe
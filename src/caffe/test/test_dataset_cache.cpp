@@ -0,0 +1,168 @@
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/dataset_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+class DatasetCacheTest : public ::testing::Test {
+ protected:
+  DatasetCacheTest()
+      : channels_(3), height_(4), width_(5), label_dim_(2),
+        // one set of 4 slots
+        size_(4 * (64 + 64)) {}
+
+  virtual void SetUp() {
+    MakeTempDir(&source_);
+  }
+
+  void FillDatum(int key, Datum* datum) {
+    datum->set_channels(channels_);
+    datum->set_height(height_);
+    datum->set_width(width_);
+    datum->set_label(key);
+    std::string* data = datum->mutable_data();
+    data->clear();
+    for (int i = 0; i < channels_ * height_ * width_; ++i) {
+      data->push_back(static_cast<uint8_t>(key + i));
+    }
+    datum->clear_float_data();
+    for (int i = 0; i < label_dim_; ++i) {
+      datum->add_float_data(key * 0.5 + i);
+    }
+  }
+
+  void CheckDatum(int key, const Datum& datum) {
+    Datum expected;
+    FillDatum(key, &expected);
+    EXPECT_EQ(datum.channels(), channels_);
+    EXPECT_EQ(datum.height(), height_);
+    EXPECT_EQ(datum.width(), width_);
+    EXPECT_EQ(datum.label(), key);
+    EXPECT_EQ(datum.data(), expected.data());
+    ASSERT_EQ(datum.float_data_size(), label_dim_);
+    for (int i = 0; i < label_dim_; ++i) {
+      EXPECT_EQ(datum.float_data(i), expected.float_data(i));
+    }
+  }
+
+  const int channels_;
+  const int height_;
+  const int width_;
+  const int label_dim_;
+  const size_t size_;
+  string source_;
+};
+
+TEST_F(DatasetCacheTest, TestPutGet) {
+  Datum datum;
+  FillDatum(0, &datum);
+  DatasetCache cache(source_, size_, datum, label_dim_);
+  EXPECT_TRUE(cache.created());
+  EXPECT_EQ(cache.capacity(), 4);
+
+  Datum cached;
+  EXPECT_FALSE(cache.Get(7, &cached));
+  FillDatum(7, &datum);
+  cache.Put(7, datum);
+  EXPECT_TRUE(cache.Get(7, &cached));
+  CheckDatum(7, cached);
+  EXPECT_FALSE(cache.Get(8, &cached));
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST_F(DatasetCacheTest, TestShared) {
+  Datum datum;
+  FillDatum(0, &datum);
+  DatasetCache cache(source_, size_, datum, label_dim_);
+  cache.Put(0, datum);
+  {
+    DatasetCache other(source_, size_, datum, label_dim_);
+    EXPECT_FALSE(other.created());
+    Datum cached;
+    EXPECT_TRUE(other.Get(0, &cached));
+    CheckDatum(0, cached);
+    FillDatum(1, &datum);
+    other.Put(1, datum);
+  }
+  Datum cached;
+  EXPECT_TRUE(cache.Get(1, &cached));
+  CheckDatum(1, cached);
+}
+
+TEST_F(DatasetCacheTest, TestEvictLeastRecentlyUsed) {
+  Datum datum;
+  FillDatum(0, &datum);
+  DatasetCache cache(source_, size_, datum, label_dim_);
+  for (int key = 0; key < 4; ++key) {
+    FillDatum(key, &datum);
+    cache.Put(key, datum);
+  }
+  // key 1 is the least recently used one now
+  Datum cached;
+  EXPECT_TRUE(cache.Get(0, &cached));
+  FillDatum(4, &datum);
+  cache.Put(4, datum);
+  EXPECT_FALSE(cache.Get(1, &cached));
+  for (int key = 0; key < 5; ++key) {
+    if (key != 1) {
+      EXPECT_TRUE(cache.Get(key, &cached));
+      CheckDatum(key, cached);
+    }
+  }
+}
+
+TEST_F(DatasetCacheTest, TestReplaceChangedSource) {
+  Datum datum;
+  FillDatum(0, &datum);
+  DatasetCache cache(source_, size_, datum, label_dim_);
+  cache.Put(0, datum);
+  // rebuild the database
+  std::ofstream table((source_ + "/000001.ldb").c_str());
+  table << "records";
+  table.close();
+  DatasetCache other(source_, size_, datum, label_dim_);
+  EXPECT_TRUE(other.created());
+  Datum cached;
+  EXPECT_FALSE(other.Get(0, &cached));
+  // the first cache keeps its records
+  EXPECT_TRUE(cache.Get(0, &cached));
+  CheckDatum(0, cached);
+}
+
+TEST_F(DatasetCacheTest, TestReplaceLeftOver) {
+  Datum datum;
+  FillDatum(0, &datum);
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // exit without destroying the cache, like a crashed process
+    DatasetCache* cache = new DatasetCache(source_, size_, datum, label_dim_);
+    cache->Put(0, datum);
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  DatasetCache cache(source_, size_, datum, label_dim_);
+  EXPECT_TRUE(cache.created());
+  Datum cached;
+  EXPECT_FALSE(cache.Get(0, &cached));
+}
+
+}  // namespace caffe
@@ -0,0 +1,110 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DatumViewTest : public ::testing::Test {
+ protected:
+  DatumViewTest() {
+    datum_.set_channels(3);
+    datum_.set_height(4);
+    datum_.set_width(5);
+    datum_.set_label(-2);
+    for (int i = 0; i < 3 * 4 * 5; ++i) {
+      datum_.mutable_data()->push_back(static_cast<char>(i * 7));
+    }
+    for (int i = 0; i < 14; ++i) {
+      datum_.add_float_data(i * 0.5 - 3);
+    }
+    CHECK(datum_.SerializeToString(&buffer_));
+  }
+
+  Datum datum_;
+  string buffer_;
+};
+
+TEST_F(DatumViewTest, TestParse) {
+  DatumView view;
+  ASSERT_TRUE(view.Parse(buffer_.data(), buffer_.size()));
+  EXPECT_EQ(view.channels(), 3);
+  EXPECT_EQ(view.height(), 4);
+  EXPECT_EQ(view.width(), 5);
+  EXPECT_EQ(view.label(), -2);
+  EXPECT_FALSE(view.encoded());
+  // the image is not copied
+  EXPECT_GE(reinterpret_cast<const char*>(view.data()), buffer_.data());
+  EXPECT_LE(reinterpret_cast<const char*>(view.data()) + view.data_size(),
+            buffer_.data() + buffer_.size());
+  EXPECT_EQ(string(reinterpret_cast<const char*>(view.data()),
+                   view.data_size()), datum_.data());
+  ASSERT_EQ(view.float_data_size(), 14);
+  for (int i = 0; i < 14; ++i) {
+    EXPECT_EQ(view.float_data(i), datum_.float_data(i));
+  }
+
+  Datum datum;
+  view.ToDatum(&datum);
+  EXPECT_EQ(datum.SerializeAsString(), buffer_);
+}
+
+TEST_F(DatumViewTest, TestParsePackedFloatData) {
+  // channels = 1, float_data = [1, -2] in packed encoding
+  const char packed[] = {
+    0x08, 0x01,
+    0x32, 0x08, 0x00, 0x00, '\x80', 0x3f, 0x00, 0x00, 0x00, '\xc0'
+  };
+  DatumView view;
+  ASSERT_TRUE(view.Parse(packed, sizeof(packed)));
+  EXPECT_EQ(view.channels(), 1);
+  EXPECT_EQ(view.data_size(), 0);
+  ASSERT_EQ(view.float_data_size(), 2);
+  EXPECT_EQ(view.float_data(0), 1);
+  EXPECT_EQ(view.float_data(1), -2);
+}
+
+TEST_F(DatumViewTest, TestParseTruncated) {
+  DatumView view;
+  EXPECT_FALSE(view.Parse(buffer_.data(), buffer_.size() - 1));
+  EXPECT_FALSE(view.Parse(buffer_.data(), 20));
+}
+
+TEST_F(DatumViewTest, TestTransform) {
+  TransformationParameter transform_param;
+  transform_param.set_scale(0.5);
+  for (int i = 0; i < 14; ++i) {
+    LabelTransformParameter* label = transform_param.add_label_transform();
+    label->set_scale(2);
+    label->set_shift(i);
+  }
+  DataTransformer<float> transformer(transform_param, TEST);
+  DatumView view;
+  ASSERT_TRUE(view.Parse(buffer_.data(), buffer_.size()));
+  EXPECT_EQ(transformer.InferBlobShape(view),
+            transformer.InferBlobShape(datum_));
+
+  Blob<float> expected(1, 3, 4, 5);
+  Blob<float> transformed(1, 3, 4, 5);
+  transformer.Transform(datum_, &expected);
+  transformer.Transform(view, &transformed);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(transformed.cpu_data()[i], expected.cpu_data()[i]);
+  }
+
+  vector<float> expected_labels(14);
+  vector<float> labels(14);
+  transformer.TransformLabel(datum_, 14, &expected_labels[0]);
+  transformer.TransformLabel(view, 14, &labels[0]);
+  EXPECT_EQ(labels, expected_labels);
+}
+
+}  // namespace caffe
@@ -0,0 +1,147 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/fuse_layers.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FuseLayersTest : public ::testing::Test {
+ protected:
+  FuseLayersTest() {
+    Caffe::set_mode(Caffe::CPU);
+    Caffe::set_random_seed(1701);
+  }
+
+  void InitNetParameter() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 9 dim: 9 } } } "
+        "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { num_output: 6 kernel_size: 3 bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'bn' type: 'BatchNorm' bottom: 'conv' top: 'conv' } "
+        "layer { name: 'scale' type: 'Scale' bottom: 'conv' top: 'conv' "
+        "  scale_param { bias_term: true } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv' top: 'conv' "
+        "  relu_param { negative_slope: 0.1 } } "
+        "layer { name: 'pool' type: 'Pooling' bottom: 'conv' top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 3 stride: 2 } } "
+        "layer { name: 'norm' type: 'LRN' bottom: 'pool' top: 'norm' "
+        "  lrn_param { local_size: 3 alpha: 0.5 beta: 0.75 k: 2 } } "
+        "layer { name: 'fc' type: 'InnerProduct' bottom: 'norm' top: 'fc' "
+        "  inner_product_param { num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu2' type: 'ReLU' bottom: 'fc' top: 'fc' } ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+
+  // Runs the net with non-trivial BatchNorm and Scale blobs, stores its
+  // weights and returns its output.
+  void ForwardTrained(vector<float>* output) {
+    Net<float> net(param_);
+    if (net.has_layer("bn")) {
+      FillerParameter filler_param;
+      filler_param.set_min(0.5);
+      filler_param.set_max(2);
+      UniformFiller<float> filler(filler_param);
+      const vector<shared_ptr<Blob<float> > >& bn_blobs =
+          net.layer_by_name("bn")->blobs();
+      filler.Fill(bn_blobs[0].get());
+      filler.Fill(bn_blobs[1].get());
+      bn_blobs[2]->mutable_cpu_data()[0] = 2;
+      const vector<shared_ptr<Blob<float> > >& scale_blobs =
+          net.layer_by_name("scale")->blobs();
+      filler.Fill(scale_blobs[0].get());
+      filler.Fill(scale_blobs[1].get());
+    }
+    Forward(&net, output);
+    net.ToProto(&weights_);
+  }
+
+  void Forward(Net<float>* net, vector<float>* output) {
+    FillerParameter filler_param;
+    GaussianFiller<float> filler(filler_param);
+    Caffe::set_random_seed(1702);
+    filler.Fill(net->input_blobs()[0]);
+    net->Forward();
+    const Blob<float>* top = net->blob_by_name("fc").get();
+    output->assign(top->cpu_data(), top->cpu_data() + top->count());
+  }
+
+  NetParameter param_;
+  NetParameter weights_;
+};
+
+TEST_F(FuseLayersTest, TestFuse) {
+  InitNetParameter();
+  vector<float> expected;
+  ForwardTrained(&expected);
+  NetParameter param_fused;
+  FuseLayers(param_, weights_, &param_fused);
+  ASSERT_EQ(4, param_fused.layer_size());
+  const LayerParameter& conv = param_fused.layer(1);
+  EXPECT_EQ("conv", conv.top(0));
+  EXPECT_EQ(2, conv.blobs_size());
+  EXPECT_TRUE(conv.convolution_param().bias_term());
+  EXPECT_FLOAT_EQ(0.1, conv.relu_param().negative_slope());
+  const LayerParameter& pool = param_fused.layer(2);
+  EXPECT_EQ("norm", pool.top(0));
+  EXPECT_EQ(3, pool.lrn_param().local_size());
+  const LayerParameter& fc = param_fused.layer(3);
+  EXPECT_EQ("fc", fc.top(0));
+  EXPECT_TRUE(fc.has_relu_param());
+
+  Net<float> net(param_fused);
+  vector<float> output;
+  Forward(&net, &output);
+  ASSERT_EQ(expected.size(), output.size());
+  for (int i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(expected[i], output[i], 1e-4);
+  }
+}
+
+TEST_F(FuseLayersTest, TestSharedOutputNotFused) {
+  // the output of the convolution is also read by the inner product
+  const string proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 9 dim: 9 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 6 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'relu' } "
+      "layer { name: 'fc' type: 'InnerProduct' bottom: 'conv' top: 'fc' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } } } ";
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  vector<float> expected;
+  ForwardTrained(&expected);
+  NetParameter param_fused;
+  FuseLayers(param_, weights_, &param_fused);
+  ASSERT_EQ(4, param_fused.layer_size());
+  EXPECT_EQ("relu", param_fused.layer(2).name());
+  EXPECT_FALSE(param_fused.layer(1).has_relu_param());
+
+  Net<float> net(param_fused);
+  vector<float> output;
+  Forward(&net, &output);
+  ASSERT_EQ(expected.size(), output.size());
+  for (int i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(expected[i], output[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    SetHostAllocator("malloc");
+  }
+};
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  const char* types[] = {"malloc", "pool", "pool_hugepages"};
+  const size_t sizes[] = {1, 100, 1000, 3 << 20};
+  for (int i = 0; i < 3; ++i) {
+    SetHostAllocator(types[i]);
+    HostAllocator* allocator = GetHostAllocator();
+    EXPECT_EQ(std::string(types[i]), allocator->type());
+    for (int j = 0; j < 4; ++j) {
+      char* ptr = static_cast<char*>(allocator->Allocate(sizes[j]));
+      ASSERT_TRUE(ptr);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0);
+      // the whole memory must be writable
+      ptr[0] = 1;
+      ptr[sizes[j] - 1] = 1;
+      allocator->Free(ptr, sizes[j]);
+    }
+  }
+}
+
+TEST_F(HostAllocatorTest, TestPoolReuse) {
+  SetHostAllocator("pool");
+  HostAllocator* allocator = GetHostAllocator();
+  allocator->Trim();
+  void* ptr = allocator->Allocate(1000);
+  allocator->Free(ptr, 1000);
+  const HostAllocatorStats before = allocator->stats();
+  EXPECT_GT(before.bytes_cached, 0);
+  // 1000 and 1010 bytes are in the same size class
+  void* reused = allocator->Allocate(1010);
+  EXPECT_EQ(ptr, reused);
+  const HostAllocatorStats after = allocator->stats();
+  EXPECT_EQ(before.pool_hits + 1, after.pool_hits);
+  EXPECT_EQ(before.system_allocations, after.system_allocations);
+  allocator->Free(reused, 1010);
+  allocator->Trim();
+  EXPECT_EQ(allocator->stats().bytes_cached, 0);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemoryAllocator) {
+  SetHostAllocator("pool");
+  HostAllocator* pool = GetHostAllocator();
+  const size_t in_use = pool->stats().bytes_in_use;
+  SyncedMemory* mem = new SyncedMemory(1000);
+  EXPECT_TRUE(mem->mutable_cpu_data());
+  EXPECT_GT(pool->stats().bytes_in_use, in_use);
+  // the memory is freed by the allocator that allocated it
+  SetHostAllocator("malloc");
+  delete mem;
+  EXPECT_EQ(pool->stats().bytes_in_use, in_use);
+}
+
+}  // namespace caffe
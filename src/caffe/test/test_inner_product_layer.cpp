@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -239,6 +240,81 @@ TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  const int threads = Caffe::cpu_threads();
+  const int grain_size = Caffe::parallel_grain_size();
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  // the last panel of 16 outputs is partial
+  inner_product_param->set_num_output(37);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_weight_filler()->set_std(0.1);
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  FillerParameter filler_param;
+  filler_param.set_min(-1);
+  filler_param.set_max(1);
+  UniformFiller<Dtype> filler(filler_param);
+  // batches of 1 to 4 rows, of several blocks of rows and too large ones,
+  // which use the GEMM
+  const int batch_sizes[] = {1, 3, 5, 8, 9};
+  for (int b = 0; b < 5; ++b) {
+    Blob<Dtype> bottom(batch_sizes[b], 3, 5, 7);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    for (int config = 0; config < 12; ++config) {
+      inner_product_param->set_transpose(config & 1);
+      inner_product_param->set_bias_term(config & 2);
+      layer_param.clear_relu_param();
+      if (config >= 4) {
+        layer_param.mutable_relu_param()->set_negative_slope(
+            config >= 8 ? 0.1 : 0);
+      }
+      // the same products on 1 and 3 threads
+      Caffe::set_cpu_threads(config % 3 ? 1 : 3);
+      Caffe::set_parallel_grain_size(1);
+      inner_product_param->set_pack_weights(false);
+      InnerProductLayer<Dtype> layer(layer_param);
+      Blob<Dtype> top;
+      vector<Blob<Dtype>*> top_vec(1, &top);
+      layer.SetUp(bottom_vec, top_vec);
+      layer.Forward(bottom_vec, top_vec);
+      inner_product_param->set_pack_weights(true);
+      InnerProductLayer<Dtype> packed_layer(layer_param);
+      Blob<Dtype> packed_top;
+      vector<Blob<Dtype>*> packed_top_vec(1, &packed_top);
+      packed_layer.SetUp(bottom_vec, packed_top_vec);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        packed_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+      }
+      // the weights are packed again after they changed
+      for (int pass = 0; pass < 2; ++pass) {
+        if (pass > 0) {
+          caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+                     layer.blobs()[0]->mutable_cpu_data());
+          packed_layer.blobs()[0]->CopyFrom(*layer.blobs()[0]);
+          layer.Forward(bottom_vec, top_vec);
+        }
+        packed_layer.Forward(bottom_vec, packed_top_vec);
+        ASSERT_EQ(top.count(), packed_top.count());
+        for (int i = 0; i < top.count(); ++i) {
+          EXPECT_NEAR(top.cpu_data()[i], packed_top.cpu_data()[i],
+                      (pass + 1) * 1e-5)
+              << "batch size " << batch_sizes[b] << " config " << config
+              << " pass " << pass;
+        }
+      }
+    }
+  }
+  Caffe::set_cpu_threads(threads);
+  Caffe::set_parallel_grain_size(grain_size);
+}
+
 TYPED_TEST(InnerProductLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_);
@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/layer_cost.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class LayerCostTest : public ::testing::Test {
+ protected:
+  LayerCostTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 6, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~LayerCostTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(LayerCostTest, TestDtypes);
+
+TYPED_TEST(LayerCostTest, TestConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  ConvolutionLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // 2 x 4 x 4 x 3 outputs, each a dot product of length 3 x 3 x 3
+  const LayerCost cost = EstimateLayerCost(&layer, this->blob_bottom_vec_,
+                                           this->blob_top_vec_);
+  EXPECT_EQ(cost.forward_flops, 2 * 96 * 27 + 96);
+  EXPECT_EQ(cost.backward_flops, 2 * cost.forward_flops);
+  EXPECT_EQ(cost.forward_bytes,
+            (180 + 96 + 4 * 27 + 4) * sizeof(TypeParam));
+}
+
+TYPED_TEST(LayerCostTest, TestInnerProduct) {
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_bias_term(false);
+  InnerProductLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const LayerCost cost = EstimateLayerCost(&layer, this->blob_bottom_vec_,
+                                           this->blob_top_vec_);
+  EXPECT_EQ(cost.forward_flops, 2 * 2 * 10 * 90);
+  EXPECT_EQ(cost.backward_flops, 2 * cost.forward_flops);
+}
+
+TYPED_TEST(LayerCostTest, TestOtherLayers) {
+  LayerParameter layer_param;
+  ReLULayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const LayerCost cost = EstimateLayerCost(&layer, this->blob_bottom_vec_,
+                                           this->blob_top_vec_);
+  EXPECT_EQ(cost.forward_flops, 0);
+  EXPECT_EQ(cost.forward_bytes, 2 * 180 * sizeof(TypeParam));
+}
+
+}  // namespace caffe
@@ -72,7 +72,7 @@ void LRNLayerTest<TypeParam>::ReferenceLRNForward(
             int c_start = c - (size - 1) / 2;
             int c_end = min(c_start + size, blob_bottom.channels());
             c_start = max(c_start, 0);
-            Dtype scale = 1.;
+            Dtype scale = lrn_param.k();
             for (int i = c_start; i < c_end; ++i) {
               Dtype value = blob_bottom.data_at(n, i, h, w);
               scale += value * value * alpha / size;
@@ -201,6 +201,42 @@ TYPED_TEST(LRNLayerTest, TestGradientAcrossChannelsLargeRegion) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(LRNLayerTest, TestForwardAcrossChannelsBeta) {
+  typedef typename TypeParam::Dtype Dtype;
+  // more pixels than a tile of the CPU kernel
+  this->blob_bottom_->Reshape(2, 7, 20, 17);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const float betas[] = {0.5, 0.75, 1., 0.6};
+  for (int i = 0; i < 4; ++i) {
+    LayerParameter layer_param;
+    layer_param.mutable_lrn_param()->set_beta(betas[i]);
+    layer_param.mutable_lrn_param()->set_k(2.);
+    LRNLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> top_reference;
+    this->ReferenceLRNForward(*(this->blob_bottom_), layer_param,
+        &top_reference);
+    for (int j = 0; j < this->blob_bottom_->count(); ++j) {
+      EXPECT_NEAR(this->blob_top_->cpu_data()[j],
+          top_reference.cpu_data()[j], this->epsilon_);
+    }
+  }
+}
+
+TYPED_TEST(LRNLayerTest, TestGradientAcrossChannelsBeta) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_lrn_param()->set_beta(0.6);
+  layer_param.mutable_lrn_param()->set_k(2.);
+  LRNLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 TYPED_TEST(LRNLayerTest, TestSetupWithinChannel) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -2446,6 +2446,485 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestOptimizeMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'OptimizeMemoryNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 12 dim: 12 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'pool1' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv1' "
+      "  top: 'pool1' "
+      "  pooling_param { "
+      "    pool: MAX "
+      "    kernel_size: 2 "
+      "    stride: 2 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'pool1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'flatten' "
+      "  type: 'Flatten' "
+      "  bottom: 'conv2' "
+      "  top: 'flatten' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'flatten' "
+      "  top: 'ip1' "
+      "  inner_product_param { "
+      "    num_output: 6 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'ip1' "
+      "  top: 'ip2' "
+      "  inner_product_param { "
+      "    num_output: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'ip1' "
+      "  bottom: 'ip2' "
+      "  top: 'concat' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TEST);
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> net(param);
+  param.set_optimize_memory(true);
+  Net<Dtype> optimized_net(param);
+  optimized_net.ShareTrainedLayersWith(&net);
+  // conv1 is not used any more when conv2 is computed
+  EXPECT_NE(net.blob_by_name("conv1")->data(),
+            net.blob_by_name("conv2")->data());
+  EXPECT_EQ(optimized_net.blob_by_name("conv1")->data(),
+            optimized_net.blob_by_name("conv2")->data());
+  // the input and the output keep their own memory
+  EXPECT_NE(optimized_net.blob_by_name("data")->data(),
+            optimized_net.blob_by_name("conv1")->data());
+  EXPECT_NE(optimized_net.blob_by_name("concat")->data(),
+            optimized_net.blob_by_name("ip1")->data());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int num = 2; num <= 4; num += 2) {
+    net.input_blobs()[0]->Reshape(num, 3, 12, 12);
+    net.Reshape();
+    optimized_net.input_blobs()[0]->Reshape(num, 3, 12, 12);
+    optimized_net.Reshape();
+    filler.Fill(net.input_blobs()[0]);
+    optimized_net.input_blobs()[0]->CopyFrom(*net.input_blobs()[0]);
+    net.Forward();
+    optimized_net.Forward();
+    const Blob<Dtype>* output = net.output_blobs()[0];
+    const Blob<Dtype>* optimized_output = optimized_net.output_blobs()[0];
+    ASSERT_EQ(output->shape(), optimized_output->shape());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_EQ(output->cpu_data()[i], optimized_output->cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareWorkspace) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'ShareWorkspaceNetwork' "
+      "force_backward: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 12 dim: 12 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    stride: 2 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'deconv' "
+      "  type: 'Deconvolution' "
+      "  bottom: 'conv2' "
+      "  top: 'deconv' "
+      "  share_workspace: false "
+      "  convolution_param { "
+      "    num_output: 2 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> shared_net(param);
+  param.set_share_workspace(false);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(&shared_net);
+  EXPECT_FALSE(net.workspace());
+  // the columns of conv1 are 27 x 100 and those of conv2 36 x 16; the
+  // deconvolution keeps its own buffer
+  ASSERT_TRUE(shared_net.workspace());
+  EXPECT_EQ(2700 * sizeof(Dtype), shared_net.workspace()->size());
+  EXPECT_EQ((2700 + 576) * sizeof(Dtype), shared_net.workspace()->reserved());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.input_blobs()[0]);
+  shared_net.input_blobs()[0]->CopyFrom(*net.input_blobs()[0]);
+  const Blob<Dtype>* output = net.output_blobs()[0];
+  const Blob<Dtype>* shared_output = shared_net.output_blobs()[0];
+  net.Forward();
+  shared_net.Forward();
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(output->cpu_data()[i], shared_output->cpu_data()[i]);
+  }
+  filler.Fill(net.output_blobs()[0]);
+  caffe_copy(output->count(), output->cpu_data(),
+      net.output_blobs()[0]->mutable_cpu_diff());
+  caffe_copy(output->count(), output->cpu_data(),
+      shared_net.output_blobs()[0]->mutable_cpu_diff());
+  net.Backward();
+  shared_net.Backward();
+  const Blob<Dtype>* input = net.input_blobs()[0];
+  const Blob<Dtype>* shared_input = shared_net.input_blobs()[0];
+  for (int i = 0; i < input->count(); ++i) {
+    EXPECT_EQ(input->cpu_diff()[i], shared_input->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestShareWorkspaceCPUAlgorithm) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  const string& proto =
+      "name: 'ShareWorkspaceNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 12 dim: 12 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  const int threads = Caffe::cpu_threads();
+  Caffe::set_cpu_threads(1);
+  // The columns are 27 x 100, while the Winograd workspace holds 16 matrices
+  // of the 25 tiles of the 3 inputs and 4 outputs.
+  ConvolutionParameter* conv_param =
+      param.mutable_layer(1)->mutable_convolution_param();
+  conv_param->set_cpu_algorithm(ConvolutionParameter_CPUAlgorithm_GEMM);
+  Net<Dtype> gemm_net(param);
+  ASSERT_TRUE(gemm_net.workspace());
+  EXPECT_EQ(2700 * sizeof(Dtype), gemm_net.workspace()->reserved());
+  conv_param->set_cpu_algorithm(ConvolutionParameter_CPUAlgorithm_WINOGRAD);
+  Net<Dtype> winograd_net(param);
+  ASSERT_TRUE(winograd_net.workspace());
+  EXPECT_EQ(2800 * sizeof(Dtype), winograd_net.workspace()->reserved());
+  // AUTOTUNE may select any algorithm
+  conv_param->set_cpu_algorithm(ConvolutionParameter_CPUAlgorithm_AUTOTUNE);
+  Net<Dtype> autotune_net(param);
+  ASSERT_TRUE(autotune_net.workspace());
+  EXPECT_EQ(2800 * sizeof(Dtype), autotune_net.workspace()->reserved());
+  winograd_net.Forward();
+  EXPECT_EQ(2800 * sizeof(Dtype), winograd_net.workspace()->size());
+  Caffe::set_cpu_threads(threads);
+}
+
+TYPED_TEST(NetTest, TestNHWCInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'NHWCNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'data' "
+      "  top: 'pool' "
+      "  pooling_param { "
+      "    pool: MAX "
+      "    kernel_size: 2 "
+      "    stride: 2 "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> net(param);
+  // the same net with an N x H x W x C input, once with a Pooling layer
+  // reading it and once with the Convolution only
+  NetParameter nhwc_param(param);
+  InputParameter* input_param =
+      nhwc_param.mutable_layer(0)->mutable_input_param();
+  input_param->set_layout(NHWC);
+  input_param->mutable_shape(0)->set_dim(1, 6);
+  input_param->mutable_shape(0)->set_dim(3, 3);
+  Net<Dtype> reordered_net(nhwc_param);
+  nhwc_param.mutable_layer()->RemoveLast();
+  Net<Dtype> nhwc_net(nhwc_param);
+  reordered_net.ShareTrainedLayersWith(&net);
+  nhwc_net.ShareTrainedLayersWith(&net);
+  // a Reorder layer converts the input for the Pooling layer (and a Split
+  // layer), the CPU Convolution reads it directly
+  ASSERT_EQ(5, reordered_net.layers().size());
+  EXPECT_EQ("data_nchw", reordered_net.layer_names()[1]);
+  EXPECT_EQ(string("Reorder"), reordered_net.layers()[1]->type());
+  const bool cpu = Caffe::mode() == Caffe::CPU;
+  EXPECT_EQ(cpu ? 2 : 3, nhwc_net.layers().size());
+  EXPECT_EQ(cpu ? NHWC : NCHW, nhwc_net.layers().back()->layer_param()
+      .convolution_param().input_layout());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* input = net.input_blobs()[0];
+  filler.Fill(input);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 6; ++h) {
+        for (int w = 0; w < 6; ++w) {
+          const Dtype value = input->data_at(n, c, h, w);
+          Blob<Dtype>* nhwc_input = reordered_net.input_blobs()[0];
+          nhwc_input->mutable_cpu_data()[nhwc_input->offset(n, h, w, c)] =
+              value;
+          nhwc_input = nhwc_net.input_blobs()[0];
+          nhwc_input->mutable_cpu_data()[nhwc_input->offset(n, h, w, c)] =
+              value;
+        }
+      }
+    }
+  }
+  net.Forward();
+  reordered_net.Forward();
+  nhwc_net.Forward();
+  const char* outputs[] = {"conv", "pool"};
+  for (int i = 0; i < 2; ++i) {
+    const Blob<Dtype>& output = *net.blob_by_name(outputs[i]);
+    const Blob<Dtype>& reordered_output =
+        *reordered_net.blob_by_name(outputs[i]);
+    ASSERT_TRUE(output.shape() == reordered_output.shape());
+    for (int j = 0; j < output.count(); ++j) {
+      EXPECT_NEAR(output.cpu_data()[j], reordered_output.cpu_data()[j],
+          1e-5);
+    }
+  }
+  const Blob<Dtype>& output = *net.blob_by_name("conv");
+  const Blob<Dtype>& nhwc_output = *nhwc_net.blob_by_name("conv");
+  ASSERT_TRUE(output.shape() == nhwc_output.shape());
+  for (int j = 0; j < output.count(); ++j) {
+    EXPECT_NEAR(output.cpu_data()[j], nhwc_output.cpu_data()[j], 1e-5);
+  }
+}
+
+TYPED_TEST(NetTest, TestNHWCInputInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'NHWCNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { "
+      "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'data' "
+      "  power_param { "
+      "    scale: 2 "
+      "    shift: 1 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "      std: 0.1 "
+      "    } "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Caffe::set_random_seed(this->seed_);
+  Net<Dtype> net(param);
+  NetParameter nhwc_param(param);
+  InputParameter* input_param =
+      nhwc_param.mutable_layer(0)->mutable_input_param();
+  input_param->set_layout(NHWC);
+  input_param->mutable_shape(0)->set_dim(1, 6);
+  input_param->mutable_shape(0)->set_dim(3, 3);
+  Net<Dtype> nhwc_net(nhwc_param);
+  nhwc_net.ShareTrainedLayersWith(&net);
+  // the in-place layer reads and writes the reordered input, which the
+  // Convolution reads after it
+  ASSERT_EQ(4, nhwc_net.layers().size());
+  EXPECT_EQ(string("Reorder"), nhwc_net.layers()[1]->type());
+  EXPECT_EQ("data_nchw", nhwc_net.layer_by_name("scale")->layer_param()
+      .top(0));
+  EXPECT_EQ("data_nchw", nhwc_net.layer_by_name("conv")->layer_param()
+      .bottom(0));
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* input = net.input_blobs()[0];
+  filler.Fill(input);
+  Blob<Dtype>* nhwc_input = nhwc_net.input_blobs()[0];
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 6; ++h) {
+        for (int w = 0; w < 6; ++w) {
+          nhwc_input->mutable_cpu_data()[nhwc_input->offset(n, h, w, c)] =
+              input->data_at(n, c, h, w);
+        }
+      }
+    }
+  }
+  net.Forward();
+  nhwc_net.Forward();
+  const Blob<Dtype>& output = *net.blob_by_name("conv");
+  const Blob<Dtype>& nhwc_output = *nhwc_net.blob_by_name("conv");
+  ASSERT_TRUE(output.shape() == nhwc_output.shape());
+  for (int j = 0; j < output.count(); ++j) {
+    EXPECT_NEAR(output.cpu_data()[j], nhwc_output.cpu_data()[j], 1e-5);
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -0,0 +1,126 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/philox.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class PhiloxTest : public ::testing::Test {
+ protected:
+  PhiloxTest()
+      : threads_(Caffe::cpu_threads()),
+        grain_size_(Caffe::parallel_grain_size()) {}
+
+  virtual ~PhiloxTest() {
+    Caffe::set_cpu_threads(threads_);
+    Caffe::set_parallel_grain_size(grain_size_);
+  }
+
+  const int threads_;
+  const int grain_size_;
+};
+
+TEST_F(PhiloxTest, TestKnownAnswers) {
+  // the philox4x32-10 vectors of the Random123 known answer tests
+  const uint32_t counters[3][4] = {
+    {0, 0, 0, 0},
+    {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+    {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+  const uint32_t keys[3][2] = {
+    {0, 0}, {0xffffffff, 0xffffffff}, {0xa4093822, 0x299f31d0}};
+  const uint32_t blocks[3][4] = {
+    {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+    {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+    {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+  for (int i = 0; i < 3; ++i) {
+    uint32_t block[4];
+    Philox::Block(counters[i], keys[i], block);
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(blocks[i][j], block[j]) << i << " " << j;
+    }
+  }
+}
+
+TEST_F(PhiloxTest, TestGenerate) {
+  const uint64_t key = 0x0123456789abcdefULL;
+  const uint64_t position = (1ULL << 34) + 3;
+  vector<uint32_t> values(1000);
+  Philox::Generate(key, position, values.size(), &values[0]);
+  // the value at position i is the word i % 4 of the block of counter i / 4
+  const uint32_t key_words[2] = {0x89abcdef, 0x01234567};
+  for (int i = 0; i < values.size(); ++i) {
+    const uint64_t p = position + i;
+    const uint32_t counter[4] = {static_cast<uint32_t>(p >> 2),
+                                 static_cast<uint32_t>(p >> 34), 0, 0};
+    uint32_t block[4];
+    Philox::Block(counter, key_words, block);
+    EXPECT_EQ(block[p & 3], values[i]) << i;
+  }
+  // sub-ranges and the sequential generator give the same values
+  for (int offset = 0; offset < 200; offset += 37) {
+    vector<uint32_t> range(300);
+    Philox::Generate(key, position + offset, range.size(), &range[0]);
+    Philox philox(key, position + offset);
+    for (int i = 0; i < range.size(); ++i) {
+      EXPECT_EQ(values[offset + i], range[i]);
+      EXPECT_EQ(values[offset + i], philox());
+    }
+    EXPECT_EQ(position + offset + range.size(), philox.position());
+  }
+}
+
+TEST_F(PhiloxTest, TestBernoulli) {
+  const int n = 100003;
+  const double p = 0.3;
+  vector<unsigned int> serial(n);
+  Caffe::set_cpu_threads(1);
+  philox_bernoulli(n, p, 1701, 42, &serial[0]);
+  int ones = 0;
+  for (int i = 0; i < n; ++i) {
+    EXPECT_TRUE(serial[i] == 0 || serial[i] == 1);
+    ones += serial[i];
+  }
+  EXPECT_NEAR(p, static_cast<double>(ones) / n, 0.01);
+  // the same masks with 3 threads
+  vector<unsigned int> parallel(n);
+  Caffe::set_cpu_threads(3);
+  Caffe::set_parallel_grain_size(1000);
+  philox_bernoulli(n, p, 1701, 42, &parallel[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(serial[i], parallel[i]) << i;
+  }
+  // p = 0 and p = 1
+  philox_bernoulli(n, 0, 1701, 42, &parallel[0]);
+  philox_bernoulli(n, 1, 1701, 42, &serial[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(0, parallel[i]);
+    EXPECT_EQ(1, serial[i]);
+  }
+}
+
+TEST_F(PhiloxTest, TestUniform) {
+  const int n = 100003;
+  vector<float> serial(n);
+  Caffe::set_cpu_threads(1);
+  philox_uniform<float>(n, -2, 3, 7, 5, &serial[0]);
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    EXPECT_GE(serial[i], -2);
+    EXPECT_LE(serial[i], 3);
+    sum += serial[i];
+  }
+  EXPECT_NEAR(0.5, sum / n, 0.02);
+  vector<float> parallel(n);
+  Caffe::set_cpu_threads(3);
+  Caffe::set_parallel_grain_size(1000);
+  philox_uniform<float>(n, -2, 3, 7, 5, &parallel[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(serial[i], parallel[i]) << i;
+  }
+}
+
+}  // namespace caffe
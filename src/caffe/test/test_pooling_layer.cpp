@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -609,6 +611,82 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // max pooling without mask and average pooling, with the specialized and
+  // the general kernels and strides, in 3 threads
+  const int kernels[] = {3, 2, 3, 3, 4};
+  const int strides[] = {2, 2, 1, 2, 3};
+  const int pads[] = {0, 0, 1, 1, 2};
+  this->blob_bottom_->Reshape(2, 5, 13, 11);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const Blob<Dtype>& bottom = *this->blob_bottom_;
+  for (int method = 0; method < 2; ++method) {
+    for (int i = 0; i < 5; ++i) {
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      pooling_param->set_kernel_size(kernels[i]);
+      pooling_param->set_stride(strides[i]);
+      pooling_param->set_pad(pads[i]);
+      pooling_param->set_pool(method == 0 ? PoolingParameter_PoolMethod_MAX
+                              : PoolingParameter_PoolMethod_AVE);
+      pooling_param->set_store_mask(false);
+      pooling_param->set_cpu_threads(3);
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const Blob<Dtype>& top = *this->blob_top_;
+      for (int n = 0; n < top.num(); ++n) {
+        for (int c = 0; c < top.channels(); ++c) {
+          for (int ph = 0; ph < top.height(); ++ph) {
+            for (int pw = 0; pw < top.width(); ++pw) {
+              const int hstart = ph * strides[i] - pads[i];
+              const int wstart = pw * strides[i] - pads[i];
+              const int hend = std::min(hstart + kernels[i],
+                                        bottom.height() + pads[i]);
+              const int wend = std::min(wstart + kernels[i],
+                                        bottom.width() + pads[i]);
+              Dtype expected = method == 0 ? Dtype(-FLT_MAX) : Dtype(0);
+              for (int h = std::max(hstart, 0);
+                   h < std::min(hend, bottom.height()); ++h) {
+                for (int w = std::max(wstart, 0);
+                     w < std::min(wend, bottom.width()); ++w) {
+                  const Dtype value = bottom.data_at(n, c, h, w);
+                  expected = method == 0 ? std::max(expected, value)
+                      : expected + value;
+                }
+              }
+              if (method == 1) {
+                expected /= (hend - hstart) * (wend - wstart);
+              }
+              EXPECT_NEAR(expected, top.data_at(n, c, ph, pw), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Max pooling stores the mask by default also in the TEST phase, e.g. for
+// deploy nets with force_backward.
+TYPED_TEST(PoolingLayerTest, TestGradientMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  PoolingLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-4, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -0,0 +1,298 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class QuantizeTest : public ::testing::Test {};
+
+TEST_F(QuantizeTest, TestHalfConversion) {
+  const float exact[] = {0.f, 1.f, -2.5f, 65504.f, 0.099975586f,
+                         std::pow(2.f, -14.f), std::pow(2.f, -24.f)};
+  for (int i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i) {
+    EXPECT_EQ(exact[i], caffe_half_to_float(caffe_float_to_half(exact[i])));
+  }
+  EXPECT_EQ(0x3C00, caffe_float_to_half(1.f));
+  EXPECT_EQ(0xC000, caffe_float_to_half(-2.f));
+  // ties round to even
+  EXPECT_EQ(0x3C00, caffe_float_to_half(1.f + std::pow(2.f, -11.f)));
+  EXPECT_EQ(0x3C02, caffe_float_to_half(1.f + 3 * std::pow(2.f, -11.f)));
+  EXPECT_EQ(0x7C00, caffe_float_to_half(70000.f));
+  EXPECT_EQ(0xFC00, caffe_float_to_half(-std::numeric_limits<float>::max()));
+  EXPECT_EQ(0, caffe_float_to_half(1e-9f));
+  EXPECT_TRUE(std::isnan(caffe_half_to_float(caffe_float_to_half(
+      std::numeric_limits<float>::quiet_NaN()))));
+  for (float value = -1000; value < 1000; value += 0.37f) {
+    EXPECT_NEAR(value, caffe_half_to_float(caffe_float_to_half(value)),
+                std::fabs(value) / 2048);
+  }
+}
+
+TEST_F(QuantizeTest, TestGemmS8) {
+  const int M = 3;
+  const int N = 7;
+  const int K = 33;
+  vector<int8_t> A(M * K);
+  vector<int8_t> B(N * K);
+  for (int i = 0; i < A.size(); ++i) {
+    A[i] = static_cast<int8_t>(i * 37 % 255 - 127);
+  }
+  for (int i = 0; i < B.size(); ++i) {
+    B[i] = static_cast<int8_t>(i * 91 % 255 - 127);
+  }
+  vector<int32_t> C(M * N);
+  caffe_cpu_gemm_s8(M, N, K, A.data(), B.data(), C.data());
+  for (int m = 0; m < M; ++m) {
+    for (int n = 0; n < N; ++n) {
+      int32_t expected = 0;
+      for (int k = 0; k < K; ++k) {
+        expected += A[m * K + k] * B[n * K + k];
+      }
+      EXPECT_EQ(expected, C[m * N + n]);
+    }
+  }
+}
+
+template <typename Dtype>
+class QuantizedMatrixTest : public ::testing::Test {
+ protected:
+  QuantizedMatrixTest() : M_(5), N_(6), K_(40) {}
+
+  // Compares Multiply with the float product for all layouts.
+  void TestMultiply(QuantizationParameter::Precision precision,
+      Dtype tolerance) {
+    Blob<Dtype> weights(N_, K_, 1, 1);
+    Blob<Dtype> input(M_, K_, 1, 1);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&weights);
+    filler.Fill(&input);
+    vector<Dtype> expected(M_ * N_);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, Dtype(1),
+        input.cpu_data(), weights.cpu_data(), Dtype(0), expected.data());
+    vector<Dtype> weights_transposed(N_ * K_);
+    vector<Dtype> input_transposed(M_ * K_);
+    for (int k = 0; k < K_; ++k) {
+      for (int n = 0; n < N_; ++n) {
+        weights_transposed[k * N_ + n] = weights.cpu_data()[n * K_ + k];
+      }
+      for (int m = 0; m < M_; ++m) {
+        input_transposed[k * M_ + m] = input.cpu_data()[m * K_ + k];
+      }
+    }
+
+    QuantizationParameter param;
+    param.set_precision(precision);
+    for (int transposed = 0; transposed < 2; ++transposed) {
+      QuantizedMatrix<Dtype> matrix;
+      EXPECT_FALSE(matrix.initialized());
+      matrix.Quantize(param, N_, K_, transposed ? weights_transposed.data()
+                      : weights.cpu_data(), transposed);
+      EXPECT_TRUE(matrix.initialized());
+      vector<Dtype> output(M_ * N_);
+      matrix.Multiply(M_, transposed ? input_transposed.data()
+                      : input.cpu_data(), transposed, output.data(),
+                      transposed);
+      for (int m = 0; m < M_; ++m) {
+        for (int n = 0; n < N_; ++n) {
+          EXPECT_NEAR(expected[m * N_ + n],
+                      output[transposed ? n * M_ + m : m * N_ + n], tolerance);
+        }
+      }
+    }
+  }
+
+  const int M_;
+  const int N_;
+  const int K_;
+};
+
+TYPED_TEST_CASE(QuantizedMatrixTest, TestDtypes);
+
+TYPED_TEST(QuantizedMatrixTest, TestMultiplyInt8) {
+  // sums of 40 products of standard normal values
+  this->TestMultiply(QuantizationParameter_Precision_INT8, 0.5);
+}
+
+TYPED_TEST(QuantizedMatrixTest, TestMultiplyFP16) {
+  this->TestMultiply(QuantizationParameter_Precision_FP16, 0.02);
+}
+
+TYPED_TEST(QuantizedMatrixTest, TestBlobProto) {
+  typedef TypeParam Dtype;
+  Blob<float> blob(4, 3, 2, 5);
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(&blob);
+  for (int i = 0; i < 2; ++i) {
+    const QuantizationParameter::Precision precision = i == 0
+        ? QuantizationParameter_Precision_FP16
+        : QuantizationParameter_Precision_INT8;
+    BlobProto proto;
+    blob.ToProto(&proto);
+    QuantizeBlobProto(precision, &proto);
+    EXPECT_EQ(0, proto.data_size());
+    Blob<Dtype> restored;
+    restored.FromProto(proto);
+    EXPECT_EQ(blob.shape(), restored.shape());
+    // 8 bit values in steps of max|x| / 127 of each of the 4 rows
+    const Dtype tolerance = i == 0 ? 0.005 : 0.03;
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_NEAR(blob.cpu_data()[j], restored.cpu_data()[j], tolerance);
+    }
+  }
+}
+
+TEST_F(QuantizeTest, TestCopyQuantizationParams) {
+  NetParameter weights;
+  weights.add_layer()->set_name("conv1");
+  LayerParameter* fc6 = weights.add_layer();
+  fc6->set_name("fc6");
+  fc6->mutable_quantization_param()->set_precision(
+      QuantizationParameter_Precision_INT8);
+  fc6->mutable_quantization_param()->set_input_max(4);
+  NetParameter param;
+  param.add_layer()->set_name("conv1");
+  param.add_layer()->set_name("fc6");
+  CopyQuantizationParams(weights, &param);
+  EXPECT_FALSE(param.layer(0).has_quantization_param());
+  EXPECT_EQ(QuantizationParameter_Precision_INT8,
+            param.layer(1).quantization_param().precision());
+  EXPECT_EQ(4, param.layer(1).quantization_param().input_max());
+}
+
+template <typename TypeParam>
+class QuantizedLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  QuantizedLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 6, 5)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_quantized_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_quantized_vec_.push_back(blob_top_quantized_);
+  }
+  virtual ~QuantizedLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_quantized_;
+  }
+
+  // Runs the layer with float and quantized weights, which share the
+  // parameters, and compares the outputs.
+  template <typename LayerType>
+  void TestQuantizedForward(LayerParameter layer_param,
+      QuantizationParameter::Precision precision, Dtype tolerance) {
+    layer_param.set_phase(TEST);
+    LayerType layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer_param.mutable_quantization_param()->set_precision(precision);
+    LayerType quantized_layer(layer_param);
+    quantized_layer.SetUp(this->blob_bottom_vec_,
+                          this->blob_top_quantized_vec_);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      quantized_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+    }
+    // The weights are quantized again after they changed.
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass > 0) {
+        caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+                   layer.blobs()[0]->mutable_cpu_data());
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      }
+      quantized_layer.Forward(this->blob_bottom_vec_,
+                              this->blob_top_quantized_vec_);
+      ASSERT_EQ(this->blob_top_->shape(),
+                this->blob_top_quantized_->shape());
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+                    this->blob_top_quantized_->cpu_data()[i],
+                    (pass + 1) * tolerance);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_quantized_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> blob_top_quantized_vec_;
+};
+
+TYPED_TEST_CASE(QuantizedLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(QuantizedLayerTest, TestInnerProduct) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_weight_filler()->set_std(0.1);
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    inner_product_param->set_transpose(transpose);
+    this->template TestQuantizedForward<InnerProductLayer<Dtype> >(
+        layer_param, QuantizationParameter_Precision_INT8, 0.2);
+    this->template TestQuantizedForward<InnerProductLayer<Dtype> >(
+        layer_param, QuantizationParameter_Precision_FP16, 0.01);
+  }
+}
+
+TYPED_TEST(QuantizedLayerTest, TestConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_weight_filler()->set_std(0.1);
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->template TestQuantizedForward<ConvolutionLayer<Dtype> >(
+      layer_param, QuantizationParameter_Precision_INT8, 0.1);
+  this->template TestQuantizedForward<ConvolutionLayer<Dtype> >(
+      layer_param, QuantizationParameter_Precision_FP16, 0.01);
+  // with a calibrated input range
+  layer_param.mutable_quantization_param()->set_input_max(
+      caffe_cpu_amax(this->blob_bottom_->count(),
+                     this->blob_bottom_->cpu_data()));
+  this->template TestQuantizedForward<ConvolutionLayer<Dtype> >(
+      layer_param, QuantizationParameter_Precision_INT8, 0.1);
+  // 1x1 convolutions use the input as columns
+  convolution_param->set_kernel_size(0, 1);
+  convolution_param->set_pad(0, 0);
+  this->template TestQuantizedForward<ConvolutionLayer<Dtype> >(
+      layer_param, QuantizationParameter_Precision_INT8, 0.1);
+}
+
+}  // namespace caffe
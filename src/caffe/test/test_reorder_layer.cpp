@@ -0,0 +1,131 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/reorder_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ReorderLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ReorderLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 4, 5)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    FillerParameter filler_param;
+    filler_param.set_mean(0.0);
+    filler_param.set_std(1.0);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+  }
+
+  virtual ~ReorderLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ReorderLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ReorderLayerTest, TestForwardNHWCToNCHW) {
+  typedef typename TypeParam::Dtype Dtype;
+  // the bottom is N x H x W x C
+  LayerParameter layer_param;
+  ReorderLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Blob<Dtype>* bottom = this->blob_bottom_;
+  const Blob<Dtype>* top = this->blob_top_;
+  ASSERT_EQ(top->num_axes(), 4);
+  EXPECT_EQ(top->shape(0), 2);
+  EXPECT_EQ(top->shape(1), 5);
+  EXPECT_EQ(top->shape(2), 3);
+  EXPECT_EQ(top->shape(3), 4);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int n = 0; n < 2; ++n) {
+    for (int h = 0; h < 3; ++h) {
+      for (int w = 0; w < 4; ++w) {
+        for (int c = 0; c < 5; ++c) {
+          EXPECT_EQ(top->data_at(n, c, h, w), bottom->data_at(n, h, w, c));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestForwardNCHWToNHWC) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_reorder_param()->set_bottom_layout(NCHW);
+  layer_param.mutable_reorder_param()->set_top_layout(NHWC);
+  ReorderLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Blob<Dtype>* bottom = this->blob_bottom_;
+  const Blob<Dtype>* top = this->blob_top_;
+  ASSERT_EQ(top->num_axes(), 4);
+  EXPECT_EQ(top->shape(0), 2);
+  EXPECT_EQ(top->shape(1), 4);
+  EXPECT_EQ(top->shape(2), 5);
+  EXPECT_EQ(top->shape(3), 3);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 3; ++c) {
+      for (int h = 0; h < 4; ++h) {
+        for (int w = 0; w < 5; ++w) {
+          EXPECT_EQ(top->data_at(n, h, w, c), bottom->data_at(n, c, h, w));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestForwardSameLayout) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_reorder_param()->set_top_layout(NHWC);
+  ReorderLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_TRUE(this->blob_top_->shape() == this->blob_bottom_->shape());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i],
+        this->blob_bottom_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(ReorderLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ReorderLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ReorderLayerTest, TestGradientNCHWToNHWC) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_reorder_param()->set_bottom_layout(NCHW);
+  layer_param.mutable_reorder_param()->set_top_layout(NHWC);
+  ReorderLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
@@ -50,6 +50,25 @@ TEST_F(SyncedMemoryTest, TestAllocationGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(10));
+  SyncedMemoryVersion version;
+  EXPECT_TRUE(version.Update(mem));
+  EXPECT_FALSE(version.Update(mem));
+  // reading does not change the version, writing does
+  mem->cpu_data();
+  EXPECT_FALSE(version.Update(mem));
+  mem->mutable_cpu_data();
+  EXPECT_TRUE(version.Update(mem));
+  EXPECT_FALSE(version.Update(mem));
+  char data[10];
+  mem->set_cpu_data(data);
+  EXPECT_TRUE(version.Update(mem));
+  // another memory of the same version
+  shared_ptr<SyncedMemory> other(new SyncedMemory(10));
+  EXPECT_TRUE(version.Update(other));
+}
+
 TEST_F(SyncedMemoryTest, TestCPUWrite) {
   SyncedMemory mem(10);
   void* cpu_data = mem.mutable_cpu_data();
@@ -0,0 +1,74 @@
+#include <boost/bind.hpp>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Counts the runs of each task and stores the thread that ran it.
+static void Record(vector<int>* runs, vector<int>* threads, int task,
+    int thread) {
+  (*runs)[task] += 1;
+  (*threads)[task] = thread;
+}
+
+// Stores whether the task ran as a task of a pool.
+static void RecordInTask(vector<int>* in_task, int task, int thread) {
+  (*in_task)[task] = ThreadPool::InTask();
+}
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  vector<int> runs_;
+  vector<int> threads_;
+};
+
+TEST_F(ThreadPoolTest, TestRun) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.threads());
+  // repeated runs reuse the threads
+  for (int tasks = 0; tasks < 40; tasks += 3) {
+    runs_.assign(tasks, 0);
+    threads_.assign(tasks, -1);
+    pool.Run(tasks, boost::bind(Record, &runs_, &threads_, _1, _2));
+    for (int i = 0; i < tasks; ++i) {
+      EXPECT_EQ(1, runs_[i]);
+      EXPECT_GE(threads_[i], 0);
+      EXPECT_LT(threads_[i], pool.threads());
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  runs_.assign(5, 0);
+  threads_.assign(5, -1);
+  pool.Run(5, boost::bind(Record, &runs_, &threads_, _1, _2));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(1, runs_[i]);
+    EXPECT_EQ(0, threads_[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestInTask) {
+  EXPECT_FALSE(ThreadPool::InTask());
+  ThreadPool pool(3);
+  runs_.assign(10, 0);
+  pool.Run(10, boost::bind(RecordInTask, &runs_, _1, _2));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(1, runs_[i]);
+  }
+  EXPECT_FALSE(ThreadPool::InTask());
+}
+
+TEST_F(ThreadPoolTest, TestHardwareThreads) {
+  ThreadPool pool(0);
+  EXPECT_GE(pool.threads(), 1);
+}
+
+}  // namespace caffe
@@ -0,0 +1,186 @@
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class VectorMathTest : public ::testing::Test {
+ protected:
+  VectorMathTest() : isa_(vector_math_isa()) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  virtual ~VectorMathTest() {
+    set_vector_math_isa(isa_);
+  }
+
+  // Fills values with n uniform values in [a, b], n is not a multiple of
+  // the vector sizes to test the tail.
+  void Uniform(int n, float a, float b, vector<float>* values) {
+    values->resize(n);
+    caffe_rng_uniform(n, a, b, &(*values)[0]);
+  }
+
+  // Checks that the relative error of y to expected, computed in double, is
+  // at most bound times FLT_EPSILON.
+  void CheckRelative(float y, double expected, double bound, float x) {
+    EXPECT_NEAR(y, expected, bound * FLT_EPSILON * std::fabs(expected))
+        << vector_math_isa_name(vector_math_isa()) << " x = " << x;
+  }
+
+  const VectorMathISA isa_;
+};
+
+TEST_F(VectorMathTest, TestExp) {
+  vector<float> x;
+  Uniform(1001, -87.f, 88.f, &x);
+  vector<float> y(x.size());
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    caffe_exp<float>(x.size(), &x[0], &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      CheckRelative(y[i], std::exp(static_cast<double>(x[i])), 2, x[i]);
+    }
+  }
+}
+
+TEST_F(VectorMathTest, TestLog) {
+  vector<float> x;
+  Uniform(1001, 0.f, 100.f, &x);
+  // close to 1, where the bound is absolute
+  for (int i = 0; i < 100; ++i) {
+    x[i] = 1.f + (i - 50) * 1e-3f;
+  }
+  x[100] = FLT_MIN;
+  x[101] = FLT_MIN / 64;  // denormal
+  x[102] = FLT_MAX;
+  vector<float> y(x.size());
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    caffe_log<float>(x.size(), &x[0], &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      const double expected = std::log(static_cast<double>(x[i]));
+      if (std::fabs(x[i] - 1.f) < 0.1f) {
+        EXPECT_NEAR(y[i], expected, FLT_EPSILON) << x[i];
+      } else {
+        CheckRelative(y[i], expected, 2, x[i]);
+      }
+    }
+  }
+}
+
+TEST_F(VectorMathTest, TestPowx) {
+  vector<float> x;
+  Uniform(1001, 0.f, 10.f, &x);
+  const float exponents[] = {0.75f, -0.75f, 3.f, -2.f, 0.5f, 1.f, 2.f, -1.f};
+  vector<float> y(x.size());
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    for (int e = 0; e < sizeof(exponents) / sizeof(exponents[0]); ++e) {
+      const float b = exponents[e];
+      caffe_powx<float>(x.size(), &x[0], b, &y[0]);
+      for (int i = 0; i < x.size(); ++i) {
+        const double log_x = std::log(static_cast<double>(x[i]));
+        CheckRelative(y[i], std::exp(b * log_x), 3 + std::fabs(b * log_x),
+            x[i]);
+      }
+    }
+  }
+}
+
+TEST_F(VectorMathTest, TestPowxNegative) {
+  const float x[] = {-2.f, -0.5f, -3.f, -1.f, -7.f};
+  float y[5];
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    caffe_powx<float>(5, x, 3.f, y);
+    for (int i = 0; i < 5; ++i) {
+      CheckRelative(y[i], std::pow(static_cast<double>(x[i]), 3), 4, x[i]);
+    }
+    caffe_powx<float>(5, x, -2.f, y);
+    for (int i = 0; i < 5; ++i) {
+      CheckRelative(y[i], std::pow(static_cast<double>(x[i]), -2), 4, x[i]);
+    }
+    caffe_powx<float>(5, x, 0.75f, y);
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_TRUE(std::isnan(y[i])) << x[i];
+    }
+  }
+}
+
+TEST_F(VectorMathTest, TestTanh) {
+  vector<float> x;
+  Uniform(1001, -12.f, 12.f, &x);
+  for (int i = 0; i < 100; ++i) {
+    x[i] = (i - 50) * 1e-3f;
+  }
+  vector<float> y(x.size());
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    caffe_tanh<float>(x.size(), &x[0], &y[0]);
+    for (int i = 0; i < x.size(); ++i) {
+      CheckRelative(y[i], std::tanh(static_cast<double>(x[i])), 2, x[i]);
+    }
+  }
+}
+
+TEST_F(VectorMathTest, TestSpecialValues) {
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float x[] = {0.f, inf, -inf, nan, -200.f, 200.f};
+  float y[6];
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    caffe_exp<float>(6, x, y);
+    EXPECT_EQ(1.f, y[0]);
+    EXPECT_EQ(inf, y[1]);
+    EXPECT_EQ(0.f, y[2]);
+    EXPECT_TRUE(std::isnan(y[3]));
+    EXPECT_EQ(0.f, y[4]);
+    EXPECT_EQ(inf, y[5]);
+    caffe_log<float>(6, x, y);
+    EXPECT_EQ(-inf, y[0]);
+    EXPECT_EQ(inf, y[1]);
+    EXPECT_TRUE(std::isnan(y[2]));
+    EXPECT_TRUE(std::isnan(y[3]));
+    EXPECT_TRUE(std::isnan(y[4]));
+    caffe_tanh<float>(6, x, y);
+    EXPECT_EQ(0.f, y[0]);
+    EXPECT_EQ(1.f, y[1]);
+    EXPECT_EQ(-1.f, y[2]);
+    EXPECT_TRUE(std::isnan(y[3]));
+    EXPECT_EQ(-1.f, y[4]);
+    EXPECT_EQ(1.f, y[5]);
+  }
+}
+
+}  // namespace caffe
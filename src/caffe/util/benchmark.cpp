@@ -1,5 +1,8 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include "caffe/common.hpp"
 #include "caffe/util/benchmark.hpp"
 
@@ -166,4 +169,20 @@ float CPUTimer::MicroSeconds() {
   return this->elapsed_microseconds_;
 }
 
+TimeStats GetTimeStats(std::vector<double> times) {
+  TimeStats stats = { 0, 0, 0 };
+  if (times.empty()) {
+    return stats;
+  }
+  std::sort(times.begin(), times.end());
+  for (int i = 0; i < times.size(); ++i) {
+    stats.mean += times[i];
+  }
+  const int n = times.size();
+  stats.mean /= n;
+  stats.median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+  stats.p99 = times[std::min(n - 1, (99 * n + 99) / 100 - 1)];
+  return stats;
+}
+
 }  // namespace caffe
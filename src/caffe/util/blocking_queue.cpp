@@ -1,5 +1,6 @@
 #include <boost/thread.hpp>
 #include <string>
+#include <vector>
 
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/parallel.hpp"
@@ -87,5 +88,7 @@ size_t BlockingQueue<T>::size() const {
 
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
+// chunks of raw database records for the multi-threaded dataset tools
+template class BlockingQueue<std::vector<string>*>;
 
 }  // namespace caffe
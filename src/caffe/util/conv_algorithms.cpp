@@ -0,0 +1,457 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/conv_algorithms.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
+
+namespace caffe {
+
+string Conv2DShape::ToString() const {
+  std::ostringstream stream;
+  stream << "c" << channels << "h" << height << "w" << width << "o"
+         << num_output << "g" << group << "k" << kernel_h << "x" << kernel_w
+         << "p" << pad_h << "x" << pad_w << "s" << stride_h << "x" << stride_w
+         << "d" << dilation_h << "x" << dilation_w;
+  return stream.str();
+}
+
+template <typename Dtype>
+void conv_direct_cpu(const Conv2DShape& shape, const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  // The output rows of a block of output channels are accumulated in a
+  // buffer that stays in the L1 cache, each input row is read once per block.
+  const int kBlockSize = 8;
+  const int output_h = shape.output_h();
+  const int output_w = shape.output_w();
+  const int input_size = shape.height * shape.width;
+  const int group_channels = shape.channels / shape.group;
+  const int group_outputs = shape.num_output / shape.group;
+  const int kernel_size = shape.kernel_h * shape.kernel_w;
+  vector<Dtype> rows(kBlockSize * output_w);
+  for (int o = 0, block_size = 0; o < shape.num_output; o += block_size) {
+    // blocks do not cross groups
+    const int group_end = (o / group_outputs + 1) * group_outputs;
+    block_size = std::min(kBlockSize, group_end - o);
+    const int first_channel = o / group_outputs * group_channels;
+    for (int y = 0; y < output_h; ++y) {
+      caffe_set(block_size * output_w, Dtype(0), &rows[0]);
+      for (int c = 0; c < group_channels; ++c) {
+        const Dtype* input_channel = input + (first_channel + c) * input_size;
+        const Dtype* kernel = weights + (o * group_channels + c) * kernel_size;
+        for (int kh = 0; kh < shape.kernel_h; ++kh) {
+          const int input_y = y * shape.stride_h - shape.pad_h +
+              kh * shape.dilation_h;
+          if (input_y < 0 || input_y >= shape.height) {
+            continue;
+          }
+          const Dtype* input_row = input_channel + input_y * shape.width;
+          for (int kw = 0; kw < shape.kernel_w; ++kw) {
+            // the outputs of this weight whose input column is in [0, width)
+            const int x_offset = kw * shape.dilation_w - shape.pad_w;
+            if (x_offset >= shape.width) {
+              continue;
+            }
+            const int x_begin = x_offset >= 0 ? 0
+                : (shape.stride_w - 1 - x_offset) / shape.stride_w;
+            const int x_end = std::min(output_w,
+                (shape.width - 1 - x_offset) / shape.stride_w + 1);
+            for (int b = 0; b < block_size; ++b) {
+              const Dtype weight = kernel[b * group_channels * kernel_size +
+                                          kh * shape.kernel_w + kw];
+              Dtype* row = &rows[b * output_w];
+              if (shape.stride_w == 1) {
+                for (int x = x_begin; x < x_end; ++x) {
+                  row[x] += weight * input_row[x + x_offset];
+                }
+              } else {
+                for (int x = x_begin; x < x_end; ++x) {
+                  row[x] += weight * input_row[x * shape.stride_w + x_offset];
+                }
+              }
+            }
+          }
+        }
+      }
+      for (int b = 0; b < block_size; ++b) {
+        caffe_copy(output_w, &rows[b * output_w],
+            output + ((o + b) * output_h + y) * output_w);
+      }
+    }
+  }
+}
+
+template void conv_direct_cpu<float>(const Conv2DShape& shape,
+    const float* input, const float* weights, float* output);
+template void conv_direct_cpu<double>(const Conv2DShape& shape,
+    const double* input, const double* weights, double* output);
+
+template <typename Dtype>
+bool WinogradConvolution<Dtype>::Supports(const Conv2DShape& shape) {
+  return shape.kernel_h == 3 && shape.kernel_w == 3 && shape.stride_h == 1 &&
+      shape.stride_w == 1 && shape.dilation_h == 1 && shape.dilation_w == 1;
+}
+
+template <typename Dtype>
+void WinogradConvolution<Dtype>::SetWeights(const Conv2DShape& shape,
+    const Dtype* weights) {
+  CHECK(Supports(shape));
+  shape_ = shape;
+  tiles_h_ = (shape.output_h() + 1) / 2;
+  tiles_w_ = (shape.output_w() + 1) / 2;
+  const int group_channels = shape.channels / shape.group;
+  const int group_outputs = shape.num_output / shape.group;
+  // The transformed weights G g G^T of each group are stored as 16
+  // matrices of group_outputs x group_channels.
+  weights_.resize(16 * shape.num_output * group_channels);
+  for (int o = 0; o < shape.num_output; ++o) {
+    const int g = o / group_outputs;
+    for (int c = 0; c < group_channels; ++c) {
+      const Dtype* k = weights + (o * group_channels + c) * 9;
+      Dtype t[4][3];
+      for (int j = 0; j < 3; ++j) {
+        t[0][j] = k[j];
+        t[1][j] = (k[j] + k[3 + j] + k[6 + j]) / 2;
+        t[2][j] = (k[j] - k[3 + j] + k[6 + j]) / 2;
+        t[3][j] = k[6 + j];
+      }
+      for (int i = 0; i < 4; ++i) {
+        const Dtype u[4] = {t[i][0], (t[i][0] + t[i][1] + t[i][2]) / 2,
+                            (t[i][0] - t[i][1] + t[i][2]) / 2, t[i][2]};
+        for (int j = 0; j < 4; ++j) {
+          weights_[((g * 16 + i * 4 + j) * group_outputs + o % group_outputs) *
+                   group_channels + c] = u[j];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+int WinogradConvolution<Dtype>::WorkspaceSize(const Conv2DShape& shape) {
+  const int tiles = ((shape.output_h() + 1) / 2) * ((shape.output_w() + 1) / 2);
+  return 16 * tiles * (shape.channels + shape.num_output / shape.group);
+}
+
+template <typename Dtype>
+int WinogradConvolution<Dtype>::workspace_size() const {
+  return WorkspaceSize(shape_);
+}
+
+template <typename Dtype>
+void WinogradConvolution<Dtype>::Forward(const Dtype* input, Dtype* output,
+    Dtype* workspace) const {
+  const int height = shape_.height;
+  const int width = shape_.width;
+  const int output_h = shape_.output_h();
+  const int output_w = shape_.output_w();
+  const int channels = shape_.channels;
+  const int tiles = tiles_h_ * tiles_w_;
+  const int group_channels = channels / shape_.group;
+  const int group_outputs = shape_.num_output / shape_.group;
+  // 16 matrices of the transformed input tiles (channels x tiles)
+  Dtype* input_tiles = workspace;
+  // 16 matrices of the products of a group (group_outputs x tiles)
+  Dtype* products = workspace + 16 * channels * tiles;
+
+  // transform the input tiles: B^T d B
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* input_channel = input + c * height * width;
+    for (int ty = 0; ty < tiles_h_; ++ty) {
+      const int y0 = 2 * ty - shape_.pad_h;
+      for (int tx = 0; tx < tiles_w_; ++tx) {
+        const int x0 = 2 * tx - shape_.pad_w;
+        Dtype d[4][4];
+        if (y0 >= 0 && y0 + 4 <= height && x0 >= 0 && x0 + 4 <= width) {
+          for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+              d[i][j] = input_channel[(y0 + i) * width + x0 + j];
+            }
+          }
+        } else {
+          for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+              const int y = y0 + i;
+              const int x = x0 + j;
+              d[i][j] = y >= 0 && y < height && x >= 0 && x < width
+                  ? input_channel[y * width + x] : Dtype(0);
+            }
+          }
+        }
+        Dtype b[4][4];
+        for (int j = 0; j < 4; ++j) {
+          b[0][j] = d[0][j] - d[2][j];
+          b[1][j] = d[1][j] + d[2][j];
+          b[2][j] = d[2][j] - d[1][j];
+          b[3][j] = d[1][j] - d[3][j];
+        }
+        Dtype* tile = input_tiles + c * tiles + ty * tiles_w_ + tx;
+        const int stride = channels * tiles;
+        for (int i = 0; i < 4; ++i) {
+          tile[(i * 4 + 0) * stride] = b[i][0] - b[i][2];
+          tile[(i * 4 + 1) * stride] = b[i][1] + b[i][2];
+          tile[(i * 4 + 2) * stride] = b[i][2] - b[i][1];
+          tile[(i * 4 + 3) * stride] = b[i][1] - b[i][3];
+        }
+      }
+    }
+  }
+
+  for (int g = 0; g < shape_.group; ++g) {
+    for (int i = 0; i < 16; ++i) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, group_outputs, tiles,
+          group_channels, (Dtype)1.,
+          &weights_[(g * 16 + i) * group_outputs * group_channels],
+          input_tiles + (i * channels + g * group_channels) * tiles,
+          (Dtype)0., products + i * group_outputs * tiles);
+    }
+    // transform the products to the output tiles: A^T m A
+    for (int o = 0; o < group_outputs; ++o) {
+      Dtype* output_channel = output + (g * group_outputs + o) * output_h *
+          output_w;
+      const Dtype* product = products + o * tiles;
+      const int stride = group_outputs * tiles;
+      for (int ty = 0; ty < tiles_h_; ++ty) {
+        for (int tx = 0; tx < tiles_w_; ++tx) {
+          const int t = ty * tiles_w_ + tx;
+          Dtype s[4][2];
+          for (int i = 0; i < 4; ++i) {
+            const Dtype m0 = product[(i * 4 + 0) * stride + t];
+            const Dtype m1 = product[(i * 4 + 1) * stride + t];
+            const Dtype m2 = product[(i * 4 + 2) * stride + t];
+            const Dtype m3 = product[(i * 4 + 3) * stride + t];
+            s[i][0] = m0 + m1 + m2;
+            s[i][1] = m1 - m2 - m3;
+          }
+          const int y = 2 * ty;
+          const int x = 2 * tx;
+          for (int j = 0; j < 2 && x + j < output_w; ++j) {
+            output_channel[y * output_w + x + j] = s[0][j] + s[1][j] + s[2][j];
+            if (y + 1 < output_h) {
+              output_channel[(y + 1) * output_w + x + j] =
+                  s[1][j] - s[2][j] - s[3][j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolution);
+
+// The size of the column tiles of TiledConvolution, a part of the L2 cache,
+// and their least number of columns, since narrower GEMMs are slower.
+static const int kTileBytes = 256 << 10;
+static const int kMinTileColumns = 64;
+
+template <typename Dtype>
+void TiledConvolution<Dtype>::SetShape(const Conv2DShape& shape) {
+  shape_ = shape;
+  const int output_w = shape.output_w();
+  const int row_bytes = kernel_dim() * output_w * sizeof(Dtype);
+  tile_rows_ = std::max(kTileBytes / row_bytes,
+      (kMinTileColumns + output_w - 1) / output_w);
+  tile_rows_ = std::max(1, std::min(shape.output_h(), tile_rows_));
+}
+
+template <typename Dtype>
+bool TiledConvolution<Dtype>::is_1x1() const {
+  return shape_.kernel_h == 1 && shape_.kernel_w == 1 &&
+      shape_.stride_h == 1 && shape_.stride_w == 1 &&
+      shape_.pad_h == 0 && shape_.pad_w == 0;
+}
+
+template <typename Dtype>
+int TiledConvolution<Dtype>::kernel_dim() const {
+  return shape_.channels / shape_.group * shape_.kernel_h * shape_.kernel_w;
+}
+
+template <typename Dtype>
+int TiledConvolution<Dtype>::workspace_size() const {
+  CHECK_GT(tile_rows_, 0) << "The shape is not set.";
+  return is_1x1() ? 0 : kernel_dim() * tile_rows_ * shape_.output_w();
+}
+
+template <typename Dtype>
+const Dtype* TiledConvolution<Dtype>::tile_columns(const Dtype* input, int g,
+    int begin, int end, Dtype* workspace, int* ld) const {
+  const int group_channels = shape_.channels / shape_.group;
+  const Dtype* group_input =
+      input + g * group_channels * shape_.height * shape_.width;
+  if (is_1x1()) {
+    // the input channels are the rows of the columns
+    *ld = shape_.height * shape_.width;
+    return group_input + begin * shape_.width;
+  }
+  im2col_rows_cpu(group_input, group_channels, shape_.height, shape_.width,
+      shape_.kernel_h, shape_.kernel_w, shape_.pad_h, shape_.pad_w,
+      shape_.stride_h, shape_.stride_w, shape_.dilation_h, shape_.dilation_w,
+      begin, end, workspace);
+  *ld = (end - begin) * shape_.output_w();
+  return workspace;
+}
+
+template <typename Dtype>
+void TiledConvolution<Dtype>::Forward(const Dtype* input,
+    const Dtype* weights, Dtype* output, Dtype* workspace) const {
+  const int output_h = shape_.output_h();
+  const int output_w = shape_.output_w();
+  const int output_size = output_h * output_w;
+  const int group_outputs = shape_.num_output / shape_.group;
+  for (int g = 0; g < shape_.group; ++g) {
+    const Dtype* group_weights = weights + g * group_outputs * kernel_dim();
+    Dtype* group_output = output + g * group_outputs * output_size;
+    for (int begin = 0; begin < output_h; begin += tile_rows_) {
+      const int end = std::min(begin + tile_rows_, output_h);
+      int ld;
+      const Dtype* columns = tile_columns(input, g, begin, end, workspace,
+          &ld);
+      caffe_cpu_gemm_ld<Dtype>(CblasNoTrans, CblasNoTrans, group_outputs,
+          (end - begin) * output_w, kernel_dim(), Dtype(1), group_weights,
+          kernel_dim(), columns, ld, Dtype(0),
+          group_output + begin * output_w, output_size);
+    }
+  }
+}
+
+template <typename Dtype>
+void TiledConvolution<Dtype>::Backward(const Dtype* output_diff,
+    const Dtype* weights, Dtype* input_diff, Dtype* workspace) const {
+  const int output_h = shape_.output_h();
+  const int output_w = shape_.output_w();
+  const int output_size = output_h * output_w;
+  const int input_size = shape_.height * shape_.width;
+  const int group_channels = shape_.channels / shape_.group;
+  const int group_outputs = shape_.num_output / shape_.group;
+  if (!is_1x1()) {
+    caffe_set(shape_.channels * input_size, Dtype(0), input_diff);
+  }
+  for (int g = 0; g < shape_.group; ++g) {
+    const Dtype* group_weights = weights + g * group_outputs * kernel_dim();
+    const Dtype* group_output_diff = output_diff + g * group_outputs *
+        output_size;
+    Dtype* group_input_diff = input_diff + g * group_channels * input_size;
+    for (int begin = 0; begin < output_h; begin += tile_rows_) {
+      const int end = std::min(begin + tile_rows_, output_h);
+      const int tile_size = (end - begin) * output_w;
+      // the columns of 1x1 convolutions are the input gradient
+      Dtype* columns = is_1x1() ? group_input_diff + begin * output_w :
+          workspace;
+      caffe_cpu_gemm_ld<Dtype>(CblasTrans, CblasNoTrans, kernel_dim(),
+          tile_size, group_outputs, Dtype(1), group_weights, kernel_dim(),
+          group_output_diff + begin * output_w, output_size, Dtype(0),
+          columns, is_1x1() ? input_size : tile_size);
+      if (!is_1x1()) {
+        col2im_rows_cpu(columns, group_channels, shape_.height, shape_.width,
+            shape_.kernel_h, shape_.kernel_w, shape_.pad_h, shape_.pad_w,
+            shape_.stride_h, shape_.stride_w, shape_.dilation_h,
+            shape_.dilation_w, begin, end, group_input_diff);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void TiledConvolution<Dtype>::WeightGradient(const Dtype* input,
+    const Dtype* output_diff, Dtype* weight_diff, Dtype* workspace) const {
+  const int output_h = shape_.output_h();
+  const int output_w = shape_.output_w();
+  const int output_size = output_h * output_w;
+  const int group_outputs = shape_.num_output / shape_.group;
+  for (int g = 0; g < shape_.group; ++g) {
+    for (int begin = 0; begin < output_h; begin += tile_rows_) {
+      const int end = std::min(begin + tile_rows_, output_h);
+      int ld;
+      const Dtype* columns = tile_columns(input, g, begin, end, workspace,
+          &ld);
+      caffe_cpu_gemm_ld<Dtype>(CblasNoTrans, CblasTrans, group_outputs,
+          kernel_dim(), (end - begin) * output_w, Dtype(1),
+          output_diff + g * group_outputs * output_size + begin * output_w,
+          output_size, columns, ld, Dtype(1),
+          weight_diff + g * group_outputs * kernel_dim(), kernel_dim());
+    }
+  }
+}
+
+INSTANTIATE_CLASS(TiledConvolution);
+
+namespace {
+
+boost::mutex cache_mutex;
+
+// Returns the cache, which is read from CAFFE_CONV_ALGORITHM_CACHE at the
+// first call.
+std::map<string, ConvolutionParameter::CPUAlgorithm>& Algorithms() {
+  static std::map<string, ConvolutionParameter::CPUAlgorithm>* algorithms =
+      NULL;
+  if (!algorithms) {
+    algorithms = new std::map<string, ConvolutionParameter::CPUAlgorithm>();
+    const char* path = getenv("CAFFE_CONV_ALGORITHM_CACHE");
+    if (path) {
+      std::ifstream file(path);
+      string key;
+      string name;
+      while (file >> key >> name) {
+        ConvolutionParameter::CPUAlgorithm algorithm;
+        if (ConvolutionParameter::CPUAlgorithm_Parse(name, &algorithm)) {
+          (*algorithms)[key] = algorithm;
+        }
+      }
+    }
+  }
+  return *algorithms;
+}
+
+}  // namespace
+
+string ConvAlgorithmCache::Platform() {
+#ifdef USE_MKL
+  string platform = "mkl_";
+#else
+  string platform = "cblas_";
+#endif
+  VectorMathISA isa = VECTOR_MATH_AVX512;
+  while (isa != VECTOR_MATH_SCALAR && !vector_math_supports(isa)) {
+    isa = static_cast<VectorMathISA>(isa - 1);
+  }
+  return platform + vector_math_isa_name(isa);
+}
+
+bool ConvAlgorithmCache::Find(const string& key,
+    ConvolutionParameter::CPUAlgorithm* algorithm) {
+  boost::mutex::scoped_lock lock(cache_mutex);
+  std::map<string, ConvolutionParameter::CPUAlgorithm>::const_iterator it =
+      Algorithms().find(key);
+  if (it == Algorithms().end()) {
+    return false;
+  }
+  *algorithm = it->second;
+  return true;
+}
+
+void ConvAlgorithmCache::Store(const string& key,
+    ConvolutionParameter::CPUAlgorithm algorithm) {
+  boost::mutex::scoped_lock lock(cache_mutex);
+  Algorithms()[key] = algorithm;
+  const char* path = getenv("CAFFE_CONV_ALGORITHM_CACHE");
+  if (path) {
+    std::ofstream file(path, std::ios::app);
+    file << key << " " << ConvolutionParameter::CPUAlgorithm_Name(algorithm)
+         << std::endl;
+    if (!file) {
+      LOG(WARNING) << "Could not write the convolution algorithm cache "
+                   << path;
+    }
+  }
+}
+
+}  // namespace caffe
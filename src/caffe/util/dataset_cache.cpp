@@ -0,0 +1,383 @@
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "caffe/util/dataset_cache.hpp"
+
+namespace caffe {
+
+// Identifies an initialized cache segment of this layout version.
+static const uint32_t kDatasetCacheMagic = 0xCAFFEDC2;
+// Number of slots per set, between which the least recently used is evicted.
+static const int kDatasetCacheWays = 4;
+// Maximal time to wait for another process initializing the segment.
+static const int kDatasetCacheInitTimeoutMs = 10000;
+
+struct DatasetCache::Header {
+  uint32_t magic;
+  volatile int32_t ready;
+  // the number of DatasetCache objects using the segment
+  volatile int32_t users;
+  // the identity of the cached database, see SourceIdentity
+  uint64_t source_hash;
+  uint64_t source_size;
+  int64_t source_mtime;
+  int32_t channels;
+  int32_t height;
+  int32_t width;
+  int32_t label_dim;
+  int32_t num_sets;
+  int32_t ways;
+  uint64_t data_size;
+  uint64_t payload_size;
+};
+
+struct DatasetCache::Set {
+  pthread_mutex_t mutex;
+  uint64_t clock;
+};
+
+struct DatasetCache::Slot {
+  int64_t key;
+  uint64_t last_used;
+  int32_t valid;
+  int32_t label;
+};
+
+// Returns true for the files which hold the records of a LevelDB or LMDB
+// database. The others (e.g. the LOG and MANIFEST of LevelDB) change
+// whenever the database is opened.
+static bool IsTableFile(const string& name) {
+  const string extensions[] = { ".ldb", ".sst" };
+  for (int i = 0; i < 2; ++i) {
+    if (name.size() > extensions[i].size() && name.compare(
+        name.size() - extensions[i].size(), string::npos, extensions[i]) == 0) {
+      return true;
+    }
+  }
+  return name == "data.mdb";
+}
+
+// Identifies the contents of the database at source by the total size and
+// the latest modification time of its table files (or of source itself if
+// it is a file), so that a cache of a rebuilt database is not reused.
+static void SourceIdentity(const string& source, uint64_t* size,
+    int64_t* mtime) {
+  *size = 0;
+  *mtime = 0;
+  struct stat info;
+  CHECK_EQ(stat(source.c_str(), &info), 0) << "Could not stat " << source
+                                           << ": " << strerror(errno);
+  if (!S_ISDIR(info.st_mode)) {
+    *size = info.st_size;
+    *mtime = info.st_mtime;
+    return;
+  }
+  DIR* dir = opendir(source.c_str());
+  CHECK(dir != NULL) << "Could not open " << source << ": "
+                     << strerror(errno);
+  for (struct dirent* entry = readdir(dir); entry != NULL;
+       entry = readdir(dir)) {
+    const string path = source + "/" + entry->d_name;
+    if (IsTableFile(entry->d_name) && stat(path.c_str(), &info) == 0) {
+      *size += info.st_size;
+      *mtime = std::max<int64_t>(*mtime, info.st_mtime);
+    }
+  }
+  closedir(dir);
+}
+
+// FNV-1a hash of the source path, which tells apart databases whose paths
+// give the same ftok key.
+static uint64_t HashSource(const string& source) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < source.size(); ++i) {
+    hash = (hash ^ static_cast<uint8_t>(source[i])) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static size_t Align(size_t size) {
+  return (size + 63) & ~static_cast<size_t>(63);
+}
+
+size_t DatasetCache::PayloadOffset(int num_sets, int ways) {
+  return Align(sizeof(Header)) + Align(num_sets * sizeof(Set)) +
+      Align(num_sets * ways * sizeof(Slot));
+}
+
+void DatasetCache::Map() {
+  sets_ = reinterpret_cast<Set*>(memory_ + Align(sizeof(Header)));
+  slots_ = reinterpret_cast<Slot*>(reinterpret_cast<char*>(sets_) +
+      Align(header_->num_sets * sizeof(Set)));
+  payloads_ = reinterpret_cast<uint8_t*>(memory_) +
+      PayloadOffset(header_->num_sets, header_->ways);
+}
+
+DatasetCache::DatasetCache(const string& source, size_t size,
+    const Datum& example, int label_dim)
+    : shm_id_(-1), memory_(NULL), header_(NULL), sets_(NULL), slots_(NULL),
+      payloads_(NULL), created_(false), hits_(0), misses_(0) {
+  CHECK(!example.encoded()) << "DatasetCache only caches decoded records.";
+  const key_t shm_key = ftok(source.c_str(), 'c');
+  CHECK_NE(shm_key, -1) << "Could not get a shared memory key for "
+                        << source << ": " << strerror(errno);
+
+  uint64_t source_size;
+  int64_t source_mtime;
+  SourceIdentity(source, &source_size, &source_mtime);
+  const uint64_t source_hash = HashSource(source);
+
+  const size_t data_size = example.data().size();
+  CHECK_GT(data_size, 0) << "DatasetCache only caches uint8 records.";
+  const size_t payload_size = Align(data_size + label_dim * sizeof(float));
+  const size_t set_size = kDatasetCacheWays * payload_size;
+  if (size < set_size) {
+    LOG(WARNING) << "The dataset cache size of " << size << " bytes is "
+                 << "rounded up to one set of " << set_size << " bytes.";
+  }
+  const int num_sets = std::max<size_t>(1, size / set_size);
+  const size_t segment_size = PayloadOffset(num_sets, kDatasetCacheWays) +
+      num_sets * kDatasetCacheWays * payload_size;
+
+  while (memory_ == NULL) {
+    // Attach to an existing cache or create a new one. If another process
+    // creates it in between, attach to this one.
+    while (shm_id_ < 0) {
+      shm_id_ = shmget(shm_key, 0, 0666);
+      if (shm_id_ < 0) {
+        CHECK_EQ(errno, ENOENT) << "Could not get the dataset cache: "
+                                << strerror(errno);
+        shm_id_ = shmget(shm_key, segment_size, IPC_CREAT | IPC_EXCL | 0666);
+        if (shm_id_ >= 0) {
+          created_ = true;
+        } else {
+          CHECK_EQ(errno, EEXIST) << "Could not create a dataset cache of "
+              << (segment_size >> 20) << " MB: " << strerror(errno);
+        }
+      }
+    }
+    void* memory = shmat(shm_id_, NULL, 0);
+    CHECK(memory != reinterpret_cast<void*>(-1))
+        << "Could not attach the dataset cache: " << strerror(errno);
+    memory_ = static_cast<char*>(memory);
+    header_ = reinterpret_cast<Header*>(memory_);
+    if (created_) {
+      break;
+    }
+    // An initialized segment which no other process is attached to was left
+    // behind by a process which did not detach (e.g. it crashed), and a
+    // segment of another database (or of an older version of this one) has
+    // to be replaced as well. The processes still attached to it keep using
+    // it. (A segment which is not initialized yet may not be attached by its
+    // creator yet.)
+    struct shmid_ds info;
+    CHECK_EQ(shmctl(shm_id_, IPC_STAT, &info), 0)
+        << "Could not get the state of the dataset cache: " << strerror(errno);
+    const char* stale = NULL;
+    if (header_->ready && info.shm_nattch <= 1) {
+      stale = "was left behind by another process";
+    } else {
+      WaitForInitialization();
+      if (header_->source_hash != source_hash ||
+          header_->source_size != source_size ||
+          header_->source_mtime != source_mtime) {
+        stale = "caches another version of the database";
+      }
+    }
+    if (stale != NULL) {
+      LOG(WARNING) << "Replacing the dataset cache for " << source
+                   << ", which " << stale << ".";
+      shmdt(memory_);
+      shmctl(shm_id_, IPC_RMID, NULL);
+      shm_id_ = -1;
+      memory_ = NULL;
+      header_ = NULL;
+    }
+  }
+
+  if (created_) {
+    Initialize(example, label_dim, num_sets, source_hash, source_size,
+               source_mtime);
+    LOG(INFO) << "Created dataset cache for " << source << " with "
+              << capacity() << " records (" << (segment_size >> 20) << " MB).";
+  } else {
+    CHECK(header_->channels == example.channels() &&
+          header_->height == example.height() &&
+          header_->width == example.width() &&
+          header_->data_size == data_size &&
+          header_->label_dim == label_dim)
+        << "The existing dataset cache for " << source
+        << " was created for records of a different shape.";
+    LOG(INFO) << "Attached to dataset cache for " << source << " with "
+              << capacity() << " records.";
+  }
+  __sync_fetch_and_add(&header_->users, 1);
+}
+
+DatasetCache::~DatasetCache() {
+  if (memory_ == NULL) {
+    return;
+  }
+  // The last user removes the segment. Linux keeps it until all processes
+  // detached, also the ones which are just attaching to it.
+  if (__sync_sub_and_fetch(&header_->users, 1) == 0) {
+    shmctl(shm_id_, IPC_RMID, NULL);
+  }
+  shmdt(memory_);
+}
+
+void DatasetCache::Initialize(const Datum& example, int label_dim,
+    int num_sets, uint64_t source_hash, uint64_t source_size,
+    int64_t source_mtime) {
+  header_->magic = kDatasetCacheMagic;
+  header_->users = 0;
+  header_->source_hash = source_hash;
+  header_->source_size = source_size;
+  header_->source_mtime = source_mtime;
+  header_->channels = example.channels();
+  header_->height = example.height();
+  header_->width = example.width();
+  header_->label_dim = label_dim;
+  header_->num_sets = num_sets;
+  header_->ways = kDatasetCacheWays;
+  header_->data_size = example.data().size();
+  header_->payload_size = Align(header_->data_size +
+      label_dim * sizeof(float));
+  Map();
+
+  pthread_mutexattr_t attr;
+  CHECK_EQ(pthread_mutexattr_init(&attr), 0);
+  CHECK_EQ(pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED), 0);
+  // A process, which dies while holding a lock, must not block the others.
+  CHECK_EQ(pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST), 0);
+  for (int i = 0; i < num_sets; ++i) {
+    CHECK_EQ(pthread_mutex_init(&sets_[i].mutex, &attr), 0);
+    sets_[i].clock = 0;
+    for (int way = 0; way < kDatasetCacheWays; ++way) {
+      GetSlot(&sets_[i], way)->valid = 0;
+    }
+  }
+  pthread_mutexattr_destroy(&attr);
+
+  __sync_synchronize();
+  header_->ready = 1;
+}
+
+void DatasetCache::WaitForInitialization() {
+  for (int waited = 0; !header_->ready; ++waited) {
+    CHECK_LT(waited, kDatasetCacheInitTimeoutMs)
+        << "Timeout while waiting for the dataset cache to be initialized.";
+    usleep(1000);
+  }
+  __sync_synchronize();
+  CHECK_EQ(header_->magic, kDatasetCacheMagic)
+      << "The shared memory segment is not a dataset cache.";
+  Map();
+}
+
+int DatasetCache::capacity() const {
+  return header_->num_sets * header_->ways;
+}
+
+void DatasetCache::Lock(Set* set) {
+  const int status = pthread_mutex_lock(&set->mutex);
+  if (status == EOWNERDEAD) {
+    // The owner died while writing to this set, thus drop all its records.
+    LOG(WARNING) << "Recovering dataset cache set from a dead process.";
+    for (int way = 0; way < header_->ways; ++way) {
+      GetSlot(set, way)->valid = 0;
+    }
+    CHECK_EQ(pthread_mutex_consistent(&set->mutex), 0);
+  } else {
+    CHECK_EQ(status, 0) << "Could not lock the dataset cache.";
+  }
+}
+
+DatasetCache::Set* DatasetCache::GetSet(int64_t key) {
+  const int64_t num_sets = header_->num_sets;
+  return sets_ + ((key % num_sets) + num_sets) % num_sets;
+}
+
+DatasetCache::Slot* DatasetCache::GetSlot(Set* set, int way) {
+  return slots_ + (set - sets_) * header_->ways + way;
+}
+
+uint8_t* DatasetCache::GetPayload(Slot* slot) {
+  return payloads_ + (slot - slots_) * header_->payload_size;
+}
+
+bool DatasetCache::Get(int64_t key, Datum* datum) {
+  Set* set = GetSet(key);
+  Lock(set);
+  for (int way = 0; way < header_->ways; ++way) {
+    Slot* slot = GetSlot(set, way);
+    if (slot->valid && slot->key == key) {
+      slot->last_used = ++set->clock;
+      const uint8_t* payload = GetPayload(slot);
+      datum->set_channels(header_->channels);
+      datum->set_height(header_->height);
+      datum->set_width(header_->width);
+      datum->set_label(slot->label);
+      datum->set_encoded(false);
+      datum->set_data(payload, header_->data_size);
+      // the labels follow the data, which may leave them unaligned
+      datum->mutable_float_data()->Resize(header_->label_dim, 0);
+      float* labels = datum->mutable_float_data()->mutable_data();
+      memcpy(labels, payload + header_->data_size,  // NOLINT(caffe/alt_fn)
+          header_->label_dim * sizeof(float));
+      pthread_mutex_unlock(&set->mutex);
+      ++hits_;
+      return true;
+    }
+  }
+  pthread_mutex_unlock(&set->mutex);
+  ++misses_;
+  return false;
+}
+
+void DatasetCache::Put(int64_t key, const Datum& datum) {
+  if (datum.encoded() || datum.data().size() != header_->data_size ||
+      datum.float_data_size() < header_->label_dim) {
+    DLOG(WARNING) << "Record " << key << " does not fit into the cache.";
+    return;
+  }
+  Set* set = GetSet(key);
+  Lock(set);
+  // Prefer an empty slot, otherwise evict the least recently used one.
+  Slot* victim = NULL;
+  for (int way = 0; way < header_->ways; ++way) {
+    Slot* slot = GetSlot(set, way);
+    if (slot->valid && slot->key == key) {
+      // another reader cached it in the meantime
+      slot->last_used = ++set->clock;
+      pthread_mutex_unlock(&set->mutex);
+      return;
+    }
+    if (victim == NULL || (victim->valid &&
+        (!slot->valid || slot->last_used < victim->last_used))) {
+      victim = slot;
+    }
+  }
+  uint8_t* payload = GetPayload(victim);
+  victim->valid = 0;
+  memcpy(payload, datum.data().data(),  // NOLINT(caffe/alt_fn)
+      header_->data_size);
+  memcpy(payload + header_->data_size,  // NOLINT(caffe/alt_fn)
+      datum.float_data().data(), header_->label_dim * sizeof(float));
+  victim->key = key;
+  victim->label = datum.label();
+  victim->last_used = ++set->clock;
+  victim->valid = 1;
+  pthread_mutex_unlock(&set->mutex);
+}
+
+}  // namespace caffe
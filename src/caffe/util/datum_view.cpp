@@ -0,0 +1,125 @@
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <limits>
+
+#include "caffe/util/datum_view.hpp"
+
+namespace caffe {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+void DatumView::Clear() {
+  channels_ = 0;
+  height_ = 0;
+  width_ = 0;
+  label_ = 0;
+  encoded_ = false;
+  data_ = NULL;
+  data_size_ = 0;
+  float_data_.clear();
+}
+
+// Reads a float, the wire format stores it as little endian fixed32.
+static bool ReadFloat(CodedInputStream* input, float* value) {
+  uint32_t bits;
+  if (!input->ReadLittleEndian32(&bits)) {
+    return false;
+  }
+  *value = WireFormatLite::DecodeFloat(bits);
+  return true;
+}
+
+bool DatumView::Parse(const void* buffer, size_t size) {
+  Clear();
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    return false;
+  }
+  CodedInputStream input(static_cast<const uint8_t*>(buffer), size);
+  // Datum fields, see caffe.proto
+  enum { kChannels = 1, kHeight = 2, kWidth = 3, kData = 4, kLabel = 5,
+         kFloatData = 6, kEncoded = 7 };
+  uint64_t varint;
+  uint32_t length;
+  for (uint32_t tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    const WireFormatLite::WireType type = WireFormatLite::GetTagWireType(tag);
+    if (type == WireFormatLite::WIRETYPE_VARINT &&
+        (field == kChannels || field == kHeight || field == kWidth ||
+         field == kLabel || field == kEncoded)) {
+      if (!input.ReadVarint64(&varint)) {
+        return false;
+      }
+      const int32_t value = static_cast<int32_t>(varint);
+      switch (field) {
+        case kChannels: channels_ = value; break;
+        case kHeight: height_ = value; break;
+        case kWidth: width_ = value; break;
+        case kLabel: label_ = value; break;
+        default: encoded_ = varint != 0; break;
+      }
+    } else if (field == kData &&
+               type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      // The bytes stay in the buffer.
+      if (!input.ReadVarint32(&length)) {
+        return false;
+      }
+      data_ = NULL;
+      data_size_ = length;
+      if (length > 0) {
+        const void* data;
+        int available;
+        if (!input.GetDirectBufferPointer(&data, &available) ||
+            static_cast<uint32_t>(available) < length) {
+          return false;
+        }
+        data_ = static_cast<const uint8_t*>(data);
+        input.Skip(length);
+      }
+    } else if (field == kFloatData &&
+               type == WireFormatLite::WIRETYPE_FIXED32) {
+      float value;
+      if (!ReadFloat(&input, &value)) {
+        return false;
+      }
+      float_data_.push_back(value);
+    } else if (field == kFloatData &&
+               type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      // packed encoding
+      if (!input.ReadVarint32(&length) || length % sizeof(float) != 0) {
+        return false;
+      }
+      float_data_.reserve(float_data_.size() + length / sizeof(float));
+      for (uint32_t i = 0; i < length; i += sizeof(float)) {
+        float value;
+        if (!ReadFloat(&input, &value)) {
+          return false;
+        }
+        float_data_.push_back(value);
+      }
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+  return input.ConsumedEntireMessage();
+}
+
+void DatumView::ToDatum(Datum* datum) const {
+  datum->Clear();
+  datum->set_channels(channels_);
+  datum->set_height(height_);
+  datum->set_width(width_);
+  datum->set_label(label_);
+  if (encoded_) {
+    datum->set_encoded(true);
+  }
+  if (data_size_ > 0) {
+    datum->set_data(data_, data_size_);
+  }
+  for (int i = 0; i < float_data_.size(); ++i) {
+    datum->add_float_data(float_data_[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,247 @@
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/fuse_layers.hpp"
+
+namespace caffe {
+
+static int BlobCount(const BlobProto& blob) {
+  if (blob.has_num() || blob.has_channels() || blob.has_height() ||
+      blob.has_width()) {
+    return blob.num() * blob.channels() * blob.height() * blob.width();
+  }
+  int count = 1;
+  for (int i = 0; i < blob.shape().dim_size(); ++i) {
+    count *= blob.shape().dim(i);
+  }
+  return count;
+}
+
+// Returns the number of outputs of a Convolution or InnerProduct layer whose
+// weights can be changed, or else 0.
+static int FoldableOutputs(const LayerParameter& layer) {
+  if (layer.has_relu_param() || layer.has_quantization_param() ||
+      layer.blobs_size() == 0) {
+    return 0;
+  }
+  for (int i = 0; i < layer.blobs_size(); ++i) {
+    if (layer.blobs(i).data_size() != BlobCount(layer.blobs(i))) {
+      return 0;
+    }
+  }
+  if (layer.type() == "Convolution") {
+    return layer.convolution_param().num_output();
+  }
+  if (layer.type() == "InnerProduct" &&
+      layer.inner_product_param().axis() == 1) {
+    return layer.inner_product_param().num_output();
+  }
+  return 0;
+}
+
+// Multiplies the weights of each output with its scale, and sets its bias to
+// bias * scale + shift.
+static void ScaleOutputs(const vector<float>& scale, const vector<float>& shift,
+    LayerParameter* layer) {
+  const int outputs = scale.size();
+  const bool is_convolution = layer->type() == "Convolution";
+  // transposed weights are inputs x outputs
+  const bool transposed = !is_convolution &&
+      layer->inner_product_param().transpose();
+  BlobProto* weights = layer->mutable_blobs(0);
+  const int inputs = weights->data_size() / outputs;
+  for (int i = 0; i < weights->data_size(); ++i) {
+    const int output = transposed ? i % outputs : i / inputs;
+    weights->set_data(i, weights->data(i) * scale[output]);
+  }
+  if (layer->blobs_size() == 1) {
+    if (is_convolution) {
+      layer->mutable_convolution_param()->set_bias_term(true);
+    } else {
+      layer->mutable_inner_product_param()->set_bias_term(true);
+    }
+    BlobProto* bias = layer->add_blobs();
+    bias->mutable_shape()->add_dim(outputs);
+    for (int i = 0; i < outputs; ++i) {
+      bias->add_data(0);
+    }
+  }
+  BlobProto* bias = layer->mutable_blobs(1);
+  CHECK_EQ(bias->data_size(), outputs);
+  for (int i = 0; i < outputs; ++i) {
+    bias->set_data(i, bias->data(i) * scale[i] + shift[i]);
+  }
+}
+
+static bool FoldBatchNorm(const LayerParameter& batch_norm,
+    LayerParameter* layer) {
+  const int outputs = FoldableOutputs(*layer);
+  const BatchNormParameter& param = batch_norm.batch_norm_param();
+  if (outputs == 0 || batch_norm.blobs_size() != 3 ||
+      (param.has_use_global_stats() && !param.use_global_stats()) ||
+      batch_norm.blobs(0).data_size() != outputs ||
+      batch_norm.blobs(1).data_size() != outputs ||
+      batch_norm.blobs(2).data_size() != 1) {
+    return false;
+  }
+  // the statistics are stored multiplied by a scale factor
+  const float factor = batch_norm.blobs(2).data(0) == 0 ? 0
+      : 1 / batch_norm.blobs(2).data(0);
+  vector<float> scale(outputs);
+  vector<float> shift(outputs);
+  for (int i = 0; i < outputs; ++i) {
+    const float mean = batch_norm.blobs(0).data(i) * factor;
+    const float variance = batch_norm.blobs(1).data(i) * factor;
+    scale[i] = 1 / std::sqrt(variance + param.eps());
+    shift[i] = -mean * scale[i];
+  }
+  ScaleOutputs(scale, shift, layer);
+  return true;
+}
+
+static bool FoldScale(const LayerParameter& scale_layer,
+    LayerParameter* layer) {
+  const int outputs = FoldableOutputs(*layer);
+  const ScaleParameter& param = scale_layer.scale_param();
+  const int blobs = param.bias_term() ? 2 : 1;
+  if (outputs == 0 || param.axis() != 1 || param.num_axes() != 1 ||
+      scale_layer.blobs_size() != blobs) {
+    return false;
+  }
+  for (int i = 0; i < blobs; ++i) {
+    if (scale_layer.blobs(i).data_size() != outputs) {
+      return false;
+    }
+  }
+  vector<float> scale(outputs);
+  vector<float> shift(outputs, 0);
+  for (int i = 0; i < outputs; ++i) {
+    scale[i] = scale_layer.blobs(0).data(i);
+    if (param.bias_term()) {
+      shift[i] = scale_layer.blobs(1).data(i);
+    }
+  }
+  ScaleOutputs(scale, shift, layer);
+  return true;
+}
+
+// Fuses next into layer if possible.
+static bool Fuse(const LayerParameter& next, LayerParameter* layer) {
+  if (layer->type() == "Convolution" || layer->type() == "InnerProduct") {
+    if (next.type() == "BatchNorm") {
+      return FoldBatchNorm(next, layer);
+    }
+    if (next.type() == "Scale") {
+      return FoldScale(next, layer);
+    }
+    if (next.type() == "ReLU" && !layer->has_relu_param()) {
+      layer->mutable_relu_param()->CopyFrom(next.relu_param());
+      if (layer->type() == "Convolution") {
+        layer->mutable_convolution_param()->set_engine(
+            ConvolutionParameter_Engine_CAFFE);
+      }
+      return true;
+    }
+  } else if (layer->type() == "Pooling") {
+    if (next.type() == "LRN" && !layer->has_lrn_param() &&
+        next.lrn_param().norm_region() ==
+        LRNParameter_NormRegion_ACROSS_CHANNELS) {
+      layer->mutable_lrn_param()->CopyFrom(next.lrn_param());
+      layer->mutable_pooling_param()->set_engine(
+          PoolingParameter_Engine_CAFFE);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the layer after i that is the only one to read the output of i,
+// or -1.
+static int OnlyConsumer(const vector<LayerParameter>& layers,
+    const vector<bool>& fused, int i) {
+  if (layers[i].top_size() != 1) {
+    return -1;
+  }
+  const string& blob_name = layers[i].top(0);
+  int consumer = -1;
+  for (int k = i + 1; k < layers.size(); ++k) {
+    if (fused[k]) {
+      continue;
+    }
+    bool reads = false;
+    bool writes = false;
+    for (int j = 0; j < layers[k].bottom_size(); ++j) {
+      reads |= layers[k].bottom(j) == blob_name;
+    }
+    for (int j = 0; j < layers[k].top_size(); ++j) {
+      writes |= layers[k].top(j) == blob_name;
+    }
+    if (reads) {
+      if (consumer >= 0) {
+        return -1;
+      }
+      consumer = k;
+    }
+    // later layers read the new blob of this name
+    if (writes) {
+      break;
+    }
+  }
+  if (consumer < 0 || layers[consumer].bottom_size() != 1 ||
+      layers[consumer].top_size() != 1) {
+    return -1;
+  }
+  return consumer;
+}
+
+void FuseLayers(const NetParameter& param, const NetParameter& weights,
+    NetParameter* param_fused) {
+  NetParameter filtered_param;
+  Net<float>::FilterNet(param, &filtered_param);
+  CHECK_EQ(filtered_param.state().phase(), TEST)
+      << "Only inference nets can be fused.";
+  std::map<string, const LayerParameter*> trained_layers;
+  for (int i = 0; i < weights.layer_size(); ++i) {
+    if (weights.layer(i).blobs_size() > 0) {
+      trained_layers[weights.layer(i).name()] = &weights.layer(i);
+    }
+  }
+  vector<LayerParameter> layers(filtered_param.layer().begin(),
+                                filtered_param.layer().end());
+  for (int i = 0; i < layers.size(); ++i) {
+    std::map<string, const LayerParameter*>::const_iterator it =
+        trained_layers.find(layers[i].name());
+    if (it != trained_layers.end()) {
+      layers[i].mutable_blobs()->CopyFrom(it->second->blobs());
+    }
+  }
+
+  vector<bool> fused(layers.size(), false);
+  for (int i = 0; i < layers.size(); ++i) {
+    if (fused[i]) {
+      continue;
+    }
+    for (int j = OnlyConsumer(layers, fused, i);
+         j >= 0 && Fuse(layers[j], &layers[i]);
+         j = OnlyConsumer(layers, fused, i)) {
+      layers[i].set_top(0, layers[j].top(0));
+      fused[j] = true;
+      LOG(INFO) << "Fused layer " << layers[j].name() << " into "
+                << layers[i].name();
+    }
+  }
+
+  param_fused->CopyFrom(filtered_param);
+  param_fused->clear_layer();
+  for (int i = 0; i < layers.size(); ++i) {
+    if (!fused[i]) {
+      param_fused->add_layer()->CopyFrom(layers[i]);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,257 @@
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef USE_MKL
+  #include "mkl.h"
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+static const size_t kAlignment = 64;
+static const size_t kHugePageSize = 2 << 20;
+
+static void* AlignedMalloc(size_t size) {
+#ifdef USE_MKL
+  return mkl_malloc(size ? size : 1, kAlignment);
+#else
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, kAlignment, size ? size : 1) != 0) {
+    return NULL;
+  }
+  return ptr;
+#endif
+}
+
+static void AlignedFree(void* ptr) {
+#ifdef USE_MKL
+  mkl_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+// Counts the allocations; the caller holds the lock.
+static void CountAllocation(size_t size, bool pool_hit,
+    HostAllocatorStats* stats) {
+  ++stats->allocations;
+  if (pool_hit) {
+    ++stats->pool_hits;
+  } else {
+    ++stats->system_allocations;
+  }
+  stats->bytes_in_use += size;
+  stats->peak_bytes_in_use =
+      std::max(stats->peak_bytes_in_use, stats->bytes_in_use);
+}
+
+class MallocHostAllocator : public HostAllocator {
+ public:
+  virtual void* Allocate(size_t size) {
+    void* ptr = AlignedMalloc(size);
+    boost::mutex::scoped_lock lock(mutex_);
+    CountAllocation(size, false, &stats_);
+    return ptr;
+  }
+
+  virtual void Free(void* ptr, size_t size) {
+    AlignedFree(ptr);
+    boost::mutex::scoped_lock lock(mutex_);
+    stats_.bytes_in_use -= size;
+  }
+
+  virtual HostAllocatorStats stats() const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return stats_;
+  }
+
+  virtual const char* type() const { return "malloc"; }
+
+ private:
+  mutable boost::mutex mutex_;
+  HostAllocatorStats stats_;
+};
+
+class PoolHostAllocator : public HostAllocator {
+ public:
+  explicit PoolHostAllocator(bool huge_pages)
+      : huge_pages_(huge_pages), max_cached_bytes_(size_t(1024) << 20) {
+    const char* max_mb = getenv("CAFFE_HOST_POOL_MAX_MB");
+    if (max_mb) {
+      max_cached_bytes_ = static_cast<size_t>(atol(max_mb)) << 20;
+    }
+  }
+
+  virtual void* Allocate(size_t size) {
+    const size_t class_size = SizeClass(size);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      vector<void*>& pool = pools_[class_size];
+      if (!pool.empty()) {
+        void* ptr = pool.back();
+        pool.pop_back();
+        stats_.bytes_cached -= class_size;
+        CountAllocation(class_size, true, &stats_);
+        return ptr;
+      }
+    }
+    void* ptr = SystemAllocate(class_size);
+    if (ptr) {
+      boost::mutex::scoped_lock lock(mutex_);
+      CountAllocation(class_size, false, &stats_);
+    }
+    return ptr;
+  }
+
+  virtual void Free(void* ptr, size_t size) {
+    const size_t class_size = SizeClass(size);
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stats_.bytes_in_use -= class_size;
+      if (stats_.bytes_cached + class_size <= max_cached_bytes_) {
+        pools_[class_size].push_back(ptr);
+        stats_.bytes_cached += class_size;
+        return;
+      }
+    }
+    SystemFree(ptr, class_size);
+  }
+
+  virtual void Trim() {
+    map<size_t, vector<void*> > pools;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      pools.swap(pools_);
+      stats_.bytes_cached = 0;
+    }
+    for (map<size_t, vector<void*> >::iterator it = pools.begin();
+         it != pools.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        SystemFree(it->second[i], it->first);
+      }
+    }
+  }
+
+  virtual HostAllocatorStats stats() const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return stats_;
+  }
+
+  virtual const char* type() const {
+    return huge_pages_ ? "pool_hugepages" : "pool";
+  }
+
+ private:
+  // Rounds the size up to the next of four size classes per power of two,
+  // and to whole huge pages if they are used.
+  size_t SizeClass(size_t size) const {
+    if (size <= kAlignment) {
+      return kAlignment;
+    }
+    int bits = 0;
+    while ((size - 1) >> bits) {
+      ++bits;
+    }
+    // size is in (2^(bits - 1), 2^bits]
+    const size_t step = std::max<size_t>(kAlignment, size_t(1) << (bits - 3));
+    size = (size + step - 1) / step * step;
+    if (UseHugePages(size)) {
+      size = (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    }
+    return size;
+  }
+
+  bool UseHugePages(size_t size) const {
+#ifdef __linux__
+    return huge_pages_ && size >= kHugePageSize;
+#else
+    return false;
+#endif
+  }
+
+  void* SystemAllocate(size_t size) {
+#ifdef __linux__
+    if (UseHugePages(size)) {
+      void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ptr == MAP_FAILED) {
+        return NULL;
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+      return ptr;
+    }
+#endif
+    return AlignedMalloc(size);
+  }
+
+  void SystemFree(void* ptr, size_t size) {
+#ifdef __linux__
+    if (UseHugePages(size)) {
+      munmap(ptr, size);
+      return;
+    }
+#endif
+    AlignedFree(ptr);
+  }
+
+  const bool huge_pages_;
+  size_t max_cached_bytes_;
+  mutable boost::mutex mutex_;
+  // the freed memory of each size class
+  map<size_t, vector<void*> > pools_;
+  HostAllocatorStats stats_;
+};
+
+// The allocators are never deleted, since memory may still be freed while
+// static objects are destroyed.
+static HostAllocator* FindHostAllocator(const string& type) {
+  static HostAllocator* malloc_allocator = new MallocHostAllocator();
+  static HostAllocator* pool_allocator = new PoolHostAllocator(false);
+  static HostAllocator* hugepage_allocator = new PoolHostAllocator(true);
+  if (type == "malloc") {
+    return malloc_allocator;
+  } else if (type == "pool") {
+    return pool_allocator;
+  } else if (type == "pool_hugepages") {
+    return hugepage_allocator;
+  }
+  LOG(FATAL) << "Unknown host allocator: " << type
+             << " (known: malloc, pool, pool_hugepages)";
+  return NULL;
+}
+
+static HostAllocator* host_allocator_ = NULL;
+static boost::once_flag host_allocator_once_ = BOOST_ONCE_INIT;
+
+static void InitHostAllocator() {
+  const char* type = getenv("CAFFE_HOST_ALLOCATOR");
+  host_allocator_ = FindHostAllocator(type ? type : "malloc");
+}
+
+HostAllocator* GetHostAllocator() {
+  // The first blobs may be allocated by several threads at once.
+  boost::call_once(host_allocator_once_, &InitHostAllocator);
+  return host_allocator_;
+}
+
+void SetHostAllocator(const string& type) {
+  boost::call_once(host_allocator_once_, &InitHostAllocator);
+  host_allocator_ = FindHostAllocator(type);
+}
+
+}  // namespace caffe
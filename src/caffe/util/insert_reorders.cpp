@@ -0,0 +1,106 @@
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/insert_reorders.hpp"
+
+namespace caffe {
+
+// Returns the layers after i reading the blob blob_name written by i, also
+// through in-place layers, up to the next other layer writing a blob of this
+// name.
+static vector<int> Readers(const vector<LayerParameter>& layers, int i,
+    const string& blob_name) {
+  vector<int> readers;
+  for (int k = i + 1; k < layers.size(); ++k) {
+    const LayerParameter& layer = layers[k];
+    bool reads = false;
+    bool writes = false;
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      reads |= layer.bottom(j) == blob_name;
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      writes |= layer.top(j) == blob_name;
+    }
+    if (reads) {
+      readers.push_back(k);
+    } else if (writes) {
+      // later layers read the new blob of this name
+      break;
+    }
+  }
+  return readers;
+}
+
+// Whether layer can read an NHWC input blob_name of num_axes axes.
+static bool ReadsNHWC(const LayerParameter& layer, const string& blob_name,
+    int num_axes) {
+  if (layer.type() != "Convolution" || layer.bottom_size() != 1 ||
+      layer.top_size() != 1 || layer.top(0) == blob_name || num_axes != 4) {
+    return false;
+  }
+  const ConvolutionParameter& param = layer.convolution_param();
+  return param.input_layout() == NCHW && param.axis() == 1 &&
+      !param.force_nd_im2col() &&
+      param.engine() != ConvolutionParameter_Engine_CUDNN &&
+      (param.cpu_algorithm() == ConvolutionParameter_CPUAlgorithm_GEMM ||
+       param.cpu_algorithm() == ConvolutionParameter_CPUAlgorithm_AUTOTUNE);
+}
+
+void InsertReorders(const NetParameter& param, bool nhwc_convolutions,
+    NetParameter* param_reordered) {
+  // the readers of a top are changed before they are copied
+  vector<LayerParameter> layers(param.layer().begin(), param.layer().end());
+  param_reordered->CopyFrom(param);
+  param_reordered->clear_layer();
+  for (int i = 0; i < layers.size(); ++i) {
+    param_reordered->add_layer()->CopyFrom(layers[i]);
+    const LayerParameter& input = layers[i];
+    if (input.type() != "Input" || input.input_param().layout() != NHWC) {
+      continue;
+    }
+    for (int t = 0; t < input.top_size(); ++t) {
+      const string& blob_name = input.top(t);
+      const InputParameter& input_param = input.input_param();
+      const int num_axes = input_param.shape_size() == 0 ? 0 :
+          input_param.shape(input_param.shape_size() == 1 ? 0 : t).dim_size();
+      const vector<int> readers = Readers(layers, i, blob_name);
+      bool convolutions = nhwc_convolutions && !readers.empty();
+      for (int r = 0; r < readers.size(); ++r) {
+        convolutions &= ReadsNHWC(layers[readers[r]], blob_name,
+            num_axes);
+      }
+      if (convolutions) {
+        for (int r = 0; r < readers.size(); ++r) {
+          layers[readers[r]].mutable_convolution_param()->set_input_layout(
+              NHWC);
+        }
+        continue;
+      }
+      const string reordered_name = blob_name + "_nchw";
+      LayerParameter* reorder = param_reordered->add_layer();
+      reorder->set_name(reordered_name);
+      reorder->set_type("Reorder");
+      reorder->add_bottom(blob_name);
+      reorder->add_top(reordered_name);
+      reorder->mutable_reorder_param()->set_bottom_layout(NHWC);
+      reorder->mutable_reorder_param()->set_top_layout(NCHW);
+      // in-place readers (e.g. a Scale) write the reordered blob
+      for (int r = 0; r < readers.size(); ++r) {
+        LayerParameter* reader = &layers[readers[r]];
+        for (int j = 0; j < reader->bottom_size(); ++j) {
+          if (reader->bottom(j) == blob_name) {
+            reader->set_bottom(j, reordered_name);
+          }
+        }
+        for (int j = 0; j < reader->top_size(); ++j) {
+          if (reader->top(j) == blob_name) {
+            reader->set_top(j, reordered_name);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,79 @@
+#include <string>
+#include <vector>
+
+#include "caffe/util/layer_cost.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+static double TotalCount(const vector<Blob<Dtype>*>& blobs) {
+  double count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    count += blobs[i]->count();
+  }
+  return count;
+}
+
+template <typename Dtype>
+LayerCost EstimateLayerCost(Layer<Dtype>* layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LayerCost cost;
+  const string type = layer->type();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = layer->blobs();
+  double param_count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    param_count += blobs[i]->count();
+  }
+  const double bottom_count = TotalCount(bottom);
+  const double top_count = TotalCount(top);
+
+  if ((type == "Convolution" || type == "InnerProduct" ||
+       type == "Deconvolution") && blobs.size() > 0) {
+    // Every output (input for deconvolution) element is the dot product
+    // with a slice of the weights of size count(1).
+    const double outputs = type == "Deconvolution" ?
+        bottom[0]->count() : top[0]->count();
+    cost.forward_flops = 2 * outputs * blobs[0]->count(1);
+    if (blobs.size() > 1) {
+      // bias
+      cost.forward_flops += top[0]->count();
+    }
+    // gradients with respect to the input and to the weights
+    cost.backward_flops = 2 * cost.forward_flops;
+  } else if (type == "Pooling") {
+    const PoolingParameter& param = layer->layer_param().pooling_param();
+    double window;
+    if (param.global_pooling()) {
+      window = bottom[0]->count(2);
+    } else if (param.has_kernel_h()) {
+      window = param.kernel_h() * param.kernel_w();
+    } else {
+      window = param.kernel_size() * param.kernel_size();
+    }
+    cost.forward_flops = top[0]->count() * window;
+    cost.backward_flops = cost.forward_flops;
+  } else if (type == "LRN") {
+    const LRNParameter& param = layer->layer_param().lrn_param();
+    const double window =
+        param.norm_region() == LRNParameter_NormRegion_WITHIN_CHANNEL ?
+        param.local_size() * param.local_size() : param.local_size();
+    // square and sum over the window, then scale, power and multiply
+    cost.forward_flops = bottom[0]->count() * (2 * window + 3);
+    cost.backward_flops = 2 * cost.forward_flops;
+  }
+
+  // Forward reads bottom and parameters and writes top, Backward reads top
+  // diff, bottom data and parameters and writes bottom and parameter diffs.
+  const double size = sizeof(Dtype);
+  cost.forward_bytes = (bottom_count + top_count + param_count) * size;
+  cost.backward_bytes = (2 * bottom_count + top_count + 2 * param_count) *
+      size;
+  return cost;
+}
+
+template LayerCost EstimateLayerCost<float>(Layer<float>* layer,
+    const vector<Blob<float>*>& bottom, const vector<Blob<float>*>& top);
+template LayerCost EstimateLayerCost<double>(Layer<double>* layer,
+    const vector<Blob<double>*>& bottom, const vector<Blob<double>*>& top);
+
+}  // namespace caffe
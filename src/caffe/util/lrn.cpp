@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/lrn.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The number of pixels of a tile, the buffers of a tile take
+// (local_size + 2) * kTileSize values.
+const int kTileSize = 256;
+
+// Computes power = scale^-beta.
+template <typename Dtype>
+void lrn_power(int n, Dtype beta, const Dtype* scale, Dtype* power) {
+  if (beta == Dtype(0.75)) {
+    for (int i = 0; i < n; ++i) {
+      power[i] = 1 / std::sqrt(scale[i] * std::sqrt(scale[i]));
+    }
+  } else if (beta == Dtype(0.5)) {
+    for (int i = 0; i < n; ++i) {
+      power[i] = 1 / std::sqrt(scale[i]);
+    }
+  } else if (beta == Dtype(1)) {
+    for (int i = 0; i < n; ++i) {
+      power[i] = 1 / scale[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      power[i] = std::pow(scale[i], -beta);
+    }
+  }
+}
+
+// Moves the window of a channel sum by one channel: the values of the channel
+// leaving the window are in slot, which is replaced by the values of the
+// channel entering it, or by zeros if values is NULL.
+template <typename Dtype>
+void lrn_slide(int n, const Dtype* values, Dtype* slot, Dtype* sum) {
+  if (values) {
+    for (int i = 0; i < n; ++i) {
+      sum[i] += values[i] - slot[i];
+      slot[i] = values[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      sum[i] -= slot[i];
+      slot[i] = 0;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void lrn_across_channels_cpu(int channels, int spatial_dim, int size,
+    Dtype alpha, Dtype beta, Dtype k, const Dtype* input, Dtype* output,
+    Dtype* scale) {
+  const int pre_pad = (size - 1) / 2;
+  const Dtype alpha_over_size = alpha / size;
+  // The squares of the channels in the window are kept in a ring of size
+  // slots, the square of channel c in slot c % size.
+  vector<Dtype> buffer((size + 2) * kTileSize);
+  Dtype* sum = &buffer[0];
+  Dtype* power = sum + kTileSize;
+  Dtype* squares = power + kTileSize;
+  for (int begin = 0; begin < spatial_dim; begin += kTileSize) {
+    const int tile = std::min(kTileSize, spatial_dim - begin);
+    caffe_set(tile, Dtype(0), sum);
+    caffe_set(size * kTileSize, Dtype(0), squares);
+    for (int c = -pre_pad; c < channels; ++c) {
+      const int head = c + pre_pad;
+      // the window of channel c is [c - pre_pad, head], the channel
+      // c - pre_pad - 1 leaving it has the slot of head
+      Dtype* slot = squares + (head % size) * kTileSize;
+      if (head < channels) {
+        const Dtype* head_input = input + head * spatial_dim + begin;
+        for (int i = 0; i < tile; ++i) {
+          power[i] = head_input[i] * head_input[i];
+        }
+        lrn_slide(tile, power, slot, sum);
+      } else {
+        lrn_slide<Dtype>(tile, NULL, slot, sum);
+      }
+      if (c < 0) {
+        continue;
+      }
+      const int offset = c * spatial_dim + begin;
+      for (int i = 0; i < tile; ++i) {
+        power[i] = k + alpha_over_size * sum[i];
+      }
+      if (scale) {
+        caffe_copy(tile, power, scale + offset);
+      }
+      lrn_power(tile, beta, power, power);
+      for (int i = 0; i < tile; ++i) {
+        output[offset + i] = input[offset + i] * power[i];
+      }
+    }
+  }
+}
+
+template void lrn_across_channels_cpu<float>(int channels, int spatial_dim,
+    int size, float alpha, float beta, float k, const float* input,
+    float* output, float* scale);
+template void lrn_across_channels_cpu<double>(int channels, int spatial_dim,
+    int size, double alpha, double beta, double k, const double* input,
+    double* output, double* scale);
+
+template <typename Dtype>
+void lrn_across_channels_backward_cpu(int channels, int spatial_dim, int size,
+    Dtype alpha, Dtype beta, const Dtype* input, const Dtype* output,
+    const Dtype* scale, const Dtype* output_diff, Dtype* input_diff) {
+  // input_diff = output_diff * scale^-beta - 2 * alpha * beta / size * input
+  // * the sum of output_diff * output / scale over the window of the channel
+  const int pre_pad = (size - 1) / 2;
+  const Dtype cache_ratio_value = 2. * alpha * beta / size;
+  vector<Dtype> buffer((size + 2) * kTileSize);
+  Dtype* sum = &buffer[0];
+  Dtype* power = sum + kTileSize;
+  Dtype* ratios = power + kTileSize;
+  for (int begin = 0; begin < spatial_dim; begin += kTileSize) {
+    const int tile = std::min(kTileSize, spatial_dim - begin);
+    caffe_set(tile, Dtype(0), sum);
+    caffe_set(size * kTileSize, Dtype(0), ratios);
+    for (int c = -pre_pad; c < channels; ++c) {
+      const int head = c + pre_pad;
+      Dtype* slot = ratios + (head % size) * kTileSize;
+      if (head < channels) {
+        const int head_offset = head * spatial_dim + begin;
+        for (int i = 0; i < tile; ++i) {
+          power[i] = output_diff[head_offset + i] * output[head_offset + i] /
+              scale[head_offset + i];
+        }
+        lrn_slide(tile, power, slot, sum);
+      } else {
+        lrn_slide<Dtype>(tile, NULL, slot, sum);
+      }
+      if (c < 0) {
+        continue;
+      }
+      const int offset = c * spatial_dim + begin;
+      lrn_power(tile, beta, scale + offset, power);
+      for (int i = 0; i < tile; ++i) {
+        input_diff[offset + i] = output_diff[offset + i] * power[i] -
+            cache_ratio_value * input[offset + i] * sum[i];
+      }
+    }
+  }
+}
+
+template void lrn_across_channels_backward_cpu<float>(int channels,
+    int spatial_dim, int size, float alpha, float beta, const float* input,
+    const float* output, const float* scale, const float* output_diff,
+    float* input_diff);
+template void lrn_across_channels_backward_cpu<double>(int channels,
+    int spatial_dim, int size, double alpha, double beta,
+    const double* input, const double* output, const double* scale,
+    const double* output_diff, double* input_diff);
+
+}  // namespace caffe
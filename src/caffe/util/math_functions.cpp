@@ -1,3 +1,4 @@
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
@@ -6,9 +7,56 @@
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/vector_math.hpp"
 
 namespace caffe {
 
+namespace {
+
+// The element-wise functions are split into ranges by parallel_for, these
+// call them on the range [begin, end) of their arrays.
+template <typename Dtype>
+void unary_range(void (*func)(const int, const Dtype*, Dtype*),
+    const Dtype* a, Dtype* y, int begin, int end) {
+  func(end - begin, a + begin, y + begin);
+}
+
+template <typename Dtype>
+void binary_range(
+    void (*func)(const int, const Dtype*, const Dtype*, Dtype*),
+    const Dtype* a, const Dtype* b, Dtype* y, int begin, int end) {
+  func(end - begin, a + begin, b + begin, y + begin);
+}
+
+// The b of vdPowx without MKL is a float, so the type of func is a parameter.
+template <typename Func, typename Dtype>
+void powx_range(Func func, const Dtype* a, Dtype b, Dtype* y, int begin,
+    int end) {
+  func(end - begin, a + begin, b, y + begin);
+}
+
+template <typename Dtype>
+void parallel_unary(void (*func)(const int, const Dtype*, Dtype*),
+    const int n, const Dtype* a, Dtype* y) {
+  parallel_for(n, boost::bind(&unary_range<Dtype>, func, a, y, _1, _2));
+}
+
+template <typename Dtype>
+void parallel_binary(
+    void (*func)(const int, const Dtype*, const Dtype*, Dtype*),
+    const int n, const Dtype* a, const Dtype* b, Dtype* y) {
+  parallel_for(n, boost::bind(&binary_range<Dtype>, func, a, b, y, _1, _2));
+}
+
+template <typename Func, typename Dtype>
+void parallel_powx(Func func, const int n, const Dtype* a, const Dtype b,
+    Dtype* y) {
+  parallel_for(n, boost::bind(&powx_range<Func, Dtype>, func, a, b, y, _1,
+      _2));
+}
+
+}  // namespace
+
 template<>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -31,6 +79,24 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       ldb, beta, C, N);
 }
 
+template<>
+void caffe_cpu_gemm_ld<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc) {
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
+template<>
+void caffe_cpu_gemm_ld<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
 template <>
 void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
@@ -45,41 +111,77 @@ void caffe_cpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
   cblas_dgemv(CblasRowMajor, TransA, M, N, alpha, A, N, x, 1, beta, y, 1);
 }
 
+namespace {
+
+void saxpy_range(float alpha, const float* X, float* Y, int begin, int end) {
+  cblas_saxpy(end - begin, alpha, X + begin, 1, Y + begin, 1);
+}
+
+void daxpy_range(double alpha, const double* X, double* Y, int begin,
+    int end) {
+  cblas_daxpy(end - begin, alpha, X + begin, 1, Y + begin, 1);
+}
+
+}  // namespace
+
 template <>
 void caffe_axpy<float>(const int N, const float alpha, const float* X,
-    float* Y) { cblas_saxpy(N, alpha, X, 1, Y, 1); }
+    float* Y) {
+  parallel_for(N, boost::bind(&saxpy_range, alpha, X, Y, _1, _2));
+}
 
 template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
-    double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
+    double* Y) {
+  parallel_for(N, boost::bind(&daxpy_range, alpha, X, Y, _1, _2));
+}
+
+namespace {
 
 template <typename Dtype>
-void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
+void set_range(Dtype alpha, Dtype* Y, int begin, int end) {
   if (alpha == 0) {
-    memset(Y, 0, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
+    // NOLINT_NEXT_LINE(caffe/alt_fn)
+    memset(Y + begin, 0, sizeof(Dtype) * (end - begin));
     return;
   }
-  for (int i = 0; i < N; ++i) {
+  for (int i = begin; i < end; ++i) {
     Y[i] = alpha;
   }
 }
 
+template <typename Dtype>
+void add_scalar_range(Dtype alpha, Dtype* Y, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    Y[i] += alpha;
+  }
+}
+
+template <typename Dtype>
+void copy_range(const Dtype* X, Dtype* Y, int begin, int end) {
+  // NOLINT_NEXT_LINE(caffe/alt_fn)
+  memcpy(Y + begin, X + begin, sizeof(Dtype) * (end - begin));
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
+  parallel_for(N, boost::bind(&set_range<Dtype>, alpha, Y, _1, _2));
+}
+
 template void caffe_set<int>(const int N, const int alpha, int* Y);
 template void caffe_set<float>(const int N, const float alpha, float* Y);
 template void caffe_set<double>(const int N, const double alpha, double* Y);
 
 template <>
 void caffe_add_scalar(const int N, const float alpha, float* Y) {
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  parallel_for(N, boost::bind(&add_scalar_range<float>, alpha, Y, _1, _2));
 }
 
 template <>
 void caffe_add_scalar(const int N, const double alpha, double* Y) {
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  parallel_for(N, boost::bind(&add_scalar_range<double>, alpha, Y, _1, _2));
 }
 
 template <typename Dtype>
@@ -93,7 +195,7 @@ void caffe_copy(const int N, const Dtype* X, Dtype* Y) {
       NO_GPU;
 #endif
     } else {
-      memcpy(Y, X, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
+      parallel_for(N, boost::bind(&copy_range<Dtype>, X, Y, _1, _2));
     }
   }
 }
@@ -104,126 +206,174 @@ template void caffe_copy<unsigned int>(const int N, const unsigned int* X,
 template void caffe_copy<float>(const int N, const float* X, float* Y);
 template void caffe_copy<double>(const int N, const double* X, double* Y);
 
+namespace {
+
+void sscal_range(float alpha, float* X, int begin, int end) {
+  cblas_sscal(end - begin, alpha, X + begin, 1);
+}
+
+void dscal_range(double alpha, double* X, int begin, int end) {
+  cblas_dscal(end - begin, alpha, X + begin, 1);
+}
+
+void saxpby_range(float alpha, const float* X, float beta, float* Y,
+    int begin, int end) {
+  cblas_saxpby(end - begin, alpha, X + begin, 1, beta, Y + begin, 1);
+}
+
+void daxpby_range(double alpha, const double* X, double beta, double* Y,
+    int begin, int end) {
+  cblas_daxpby(end - begin, alpha, X + begin, 1, beta, Y + begin, 1);
+}
+
+}  // namespace
+
 template <>
 void caffe_scal<float>(const int N, const float alpha, float *X) {
-  cblas_sscal(N, alpha, X, 1);
+  parallel_for(N, boost::bind(&sscal_range, alpha, X, _1, _2));
 }
 
 template <>
 void caffe_scal<double>(const int N, const double alpha, double *X) {
-  cblas_dscal(N, alpha, X, 1);
+  parallel_for(N, boost::bind(&dscal_range, alpha, X, _1, _2));
 }
 
 template <>
 void caffe_cpu_axpby<float>(const int N, const float alpha, const float* X,
                             const float beta, float* Y) {
-  cblas_saxpby(N, alpha, X, 1, beta, Y, 1);
+  parallel_for(N, boost::bind(&saxpby_range, alpha, X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_cpu_axpby<double>(const int N, const double alpha, const double* X,
                              const double beta, double* Y) {
-  cblas_daxpby(N, alpha, X, 1, beta, Y, 1);
+  parallel_for(N, boost::bind(&daxpby_range, alpha, X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsAdd(n, a, b, y);
+  parallel_binary<float>(&vsAdd, n, a, b, y);
 }
 
 template <>
 void caffe_add<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdAdd(n, a, b, y);
+  parallel_binary<double>(&vdAdd, n, a, b, y);
 }
 
 template <>
 void caffe_sub<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsSub(n, a, b, y);
+  parallel_binary<float>(&vsSub, n, a, b, y);
 }
 
 template <>
 void caffe_sub<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdSub(n, a, b, y);
+  parallel_binary<double>(&vdSub, n, a, b, y);
 }
 
 template <>
 void caffe_mul<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsMul(n, a, b, y);
+  parallel_binary<float>(&vsMul, n, a, b, y);
 }
 
 template <>
 void caffe_mul<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdMul(n, a, b, y);
+  parallel_binary<double>(&vdMul, n, a, b, y);
 }
 
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsDiv(n, a, b, y);
+  parallel_binary<float>(&vsDiv, n, a, b, y);
 }
 
 template <>
 void caffe_div<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdDiv(n, a, b, y);
+  parallel_binary<double>(&vdDiv, n, a, b, y);
 }
 
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
-  vsPowx(n, a, b, y);
+#ifdef USE_MKL
+  parallel_powx(&vsPowx, n, a, b, y);
+#else
+  parallel_powx(&vector_powx, n, a, b, y);
+#endif
 }
 
 template <>
 void caffe_powx<double>(const int n, const double* a, const double b,
     double* y) {
-  vdPowx(n, a, b, y);
+  parallel_powx(&vdPowx, n, a, b, y);
 }
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
-  vsSqr(n, a, y);
+  parallel_unary<float>(&vsSqr, n, a, y);
 }
 
 template <>
 void caffe_sqr<double>(const int n, const double* a, double* y) {
-  vdSqr(n, a, y);
+  parallel_unary<double>(&vdSqr, n, a, y);
 }
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
-  vsExp(n, a, y);
+#ifdef USE_MKL
+  parallel_unary<float>(&vsExp, n, a, y);
+#else
+  parallel_unary<float>(&vector_exp, n, a, y);
+#endif
 }
 
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
-  vdExp(n, a, y);
+  parallel_unary<double>(&vdExp, n, a, y);
 }
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
-  vsLn(n, a, y);
+#ifdef USE_MKL
+  parallel_unary<float>(&vsLn, n, a, y);
+#else
+  parallel_unary<float>(&vector_log, n, a, y);
+#endif
 }
 
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
-  vdLn(n, a, y);
+  parallel_unary<double>(&vdLn, n, a, y);
+}
+
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  parallel_unary<float>(&vsTanh, n, a, y);
+#else
+  parallel_unary<float>(&vector_tanh, n, a, y);
+#endif
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  parallel_unary<double>(&vdTanh, n, a, y);
 }
 
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
-    vsAbs(n, a, y);
+    parallel_unary<float>(&vsAbs, n, a, y);
 }
 
 template <>
 void caffe_abs<double>(const int n, const double* a, double* y) {
-    vdAbs(n, a, y);
+    parallel_unary<double>(&vdAbs, n, a, y);
 }
 
 unsigned int caffe_rng_rand() {
@@ -358,18 +508,27 @@ double caffe_cpu_asum<double>(const int n, const double* x) {
   return cblas_dasum(n, x, 1);
 }
 
+namespace {
+
+template <typename Dtype>
+void scale_range(Dtype alpha, const Dtype* x, Dtype* y, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    y[i] = alpha * x[i];
+  }
+}
+
+}  // namespace
+
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
-  cblas_scopy(n, x, 1, y, 1);
-  cblas_sscal(n, alpha, y, 1);
+  parallel_for(n, boost::bind(&scale_range<float>, alpha, x, y, _1, _2));
 }
 
 template <>
 void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
                              double* y) {
-  cblas_dcopy(n, x, 1, y, 1);
-  cblas_dscal(n, alpha, y, 1);
+  parallel_for(n, boost::bind(&scale_range<double>, alpha, x, y, _1, _2));
 }
 
 }  // namespace caffe
@@ -0,0 +1,263 @@
+#include <string.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/packed_matrix.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_PACKED_MATRIX_X86
+#define PACKED_INLINE inline __attribute__((always_inline))
+#else
+#define PACKED_INLINE inline
+#endif
+
+namespace caffe {
+
+namespace {
+
+const int kPanel = PackedMatrix<float>::kPanelSize;
+// The input rows multiplied together with a panel; their sums stay in the
+// vector registers.
+const int kBlockRows = 4;
+
+template <typename Dtype>
+struct PackedProduct {
+  int M;
+  int N;
+  int K;
+  const Dtype* panels;
+  const Dtype* input;
+  const Dtype* bias;
+  bool relu;
+  Dtype negative_slope;
+  Dtype* output;
+};
+
+#ifdef CAFFE_PACKED_MATRIX_X86
+// The sums of a panel are vectors of the extensions of GCC, which are
+// compiled to the registers of each instruction set (e.g. one AVX-512 or two
+// AVX2 registers of floats). The ABI warnings of the wider vectors do not
+// apply, since the functions using them are inlined.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+template <typename Dtype> struct PanelVector;
+template <> struct PanelVector<float> {
+  typedef float Type __attribute__((vector_size(kPanel * sizeof(float))));
+};
+template <> struct PanelVector<double> {
+  typedef double Type __attribute__((vector_size(kPanel * sizeof(double))));
+};
+
+// Stores the products of the rows [0, R) of the input (of stride K) with the
+// panel in sums. With one or two rows, the even and odd inputs are summed
+// separately, which halves the latency of the dependent additions.
+template <typename Dtype, int R>
+PACKED_INLINE void multiply_panel_sums(int K, const Dtype* panel,
+    const Dtype* input, Dtype sums[R][kPanel]) {
+  typedef typename PanelVector<Dtype>::Type Vector;
+  const int kParts = R <= 2 ? 2 : 1;
+  Vector vector_sums[kParts][R];
+  for (int part = 0; part < kParts; ++part) {
+    for (int r = 0; r < R; ++r) {
+      vector_sums[part][r] = Vector();
+    }
+  }
+  int k = 0;
+  for (; k + kParts <= K; k += kParts) {
+    for (int part = 0; part < kParts; ++part) {
+      Vector weights;
+      memcpy(&weights, panel + (k + part) * kPanel,  // NOLINT(caffe/alt_fn)
+             sizeof(weights));
+      for (int r = 0; r < R; ++r) {
+        vector_sums[part][r] += input[r * K + k + part] * weights;
+      }
+    }
+  }
+  for (; k < K; ++k) {
+    Vector weights;
+    memcpy(&weights, panel + k * kPanel,  // NOLINT(caffe/alt_fn)
+           sizeof(weights));
+    for (int r = 0; r < R; ++r) {
+      vector_sums[0][r] += input[r * K + k] * weights;
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    for (int part = 1; part < kParts; ++part) {
+      vector_sums[0][r] += vector_sums[part][r];
+    }
+    memcpy(sums[r], &vector_sums[0][r],  // NOLINT(caffe/alt_fn)
+           sizeof(vector_sums[0][r]));
+  }
+}
+#else
+template <typename Dtype, int R>
+PACKED_INLINE void multiply_panel_sums(int K, const Dtype* panel,
+    const Dtype* input, Dtype sums[R][kPanel]) {
+  for (int r = 0; r < R; ++r) {
+    for (int j = 0; j < kPanel; ++j) {
+      sums[r][j] = 0;
+    }
+  }
+  for (int k = 0; k < K; ++k) {
+    const Dtype* weights = panel + k * kPanel;
+    for (int r = 0; r < R; ++r) {
+      const Dtype x = input[r * K + k];
+      for (int j = 0; j < kPanel; ++j) {
+        sums[r][j] += x * weights[j];
+      }
+    }
+  }
+}
+#endif
+
+// Multiplies the rows [row, row + R) of the input with the panel p.
+template <typename Dtype, int R>
+PACKED_INLINE void multiply_panel(const PackedProduct<Dtype>& product, int p,
+    int row) {
+  const int K = product.K;
+  Dtype sums[R][kPanel];
+  multiply_panel_sums<Dtype, R>(K,
+      product.panels + static_cast<size_t>(p) * K * kPanel,
+      product.input + static_cast<size_t>(row) * K, sums);
+  // the bias and the ReLU of the outputs of the panel
+  const int begin = p * kPanel;
+  const int count = std::min(kPanel, product.N - begin);
+  for (int r = 0; r < R; ++r) {
+    Dtype* output = product.output + static_cast<size_t>(row + r) * product.N
+        + begin;
+    for (int j = 0; j < count; ++j) {
+      Dtype value = sums[r][j];
+      if (product.bias) {
+        value += product.bias[begin + j];
+      }
+      if (product.relu && value <= 0) {
+        value *= product.negative_slope;
+      }
+      output[j] = value;
+    }
+  }
+}
+
+template <typename Dtype>
+PACKED_INLINE void multiply_panels(const PackedProduct<Dtype>& product,
+    int begin, int end) {
+  for (int p = begin; p < end; ++p) {
+    for (int row = 0; row < product.M; row += kBlockRows) {
+      switch (std::min(kBlockRows, product.M - row)) {
+      case 1:
+        multiply_panel<Dtype, 1>(product, p, row);
+        break;
+      case 2:
+        multiply_panel<Dtype, 2>(product, p, row);
+        break;
+      case 3:
+        multiply_panel<Dtype, 3>(product, p, row);
+        break;
+      default:
+        multiply_panel<Dtype, kBlockRows>(product, p, row);
+      }
+    }
+  }
+}
+
+// The products are compiled for the vector instruction sets of vector_math
+// and selected by the CPU.
+template <typename Dtype>
+void multiply_panels_default(const PackedProduct<Dtype>& product, int begin,
+    int end) {
+  multiply_panels(product, begin, end);
+}
+
+#ifdef CAFFE_PACKED_MATRIX_X86
+template <typename Dtype>
+__attribute__((target("avx2,fma"))) void multiply_panels_avx2(
+    const PackedProduct<Dtype>& product, int begin, int end) {
+  multiply_panels(product, begin, end);
+}
+
+template <typename Dtype>
+__attribute__((target("avx512f"))) void multiply_panels_avx512(
+    const PackedProduct<Dtype>& product, int begin, int end) {
+  multiply_panels(product, begin, end);
+}
+#endif
+
+template <typename Dtype>
+struct PackedProductFunction {
+  typedef void (*Type)(const PackedProduct<Dtype>& product, int begin,
+      int end);
+};
+
+template <typename Dtype>
+typename PackedProductFunction<Dtype>::Type best_multiply_panels() {
+#ifdef CAFFE_PACKED_MATRIX_X86
+  if (vector_math_supports(VECTOR_MATH_AVX512)) {
+    return &multiply_panels_avx512<Dtype>;
+  }
+  if (vector_math_supports(VECTOR_MATH_AVX2)) {
+    return &multiply_panels_avx2<Dtype>;
+  }
+#endif
+  return &multiply_panels_default<Dtype>;
+}
+
+}  // namespace
+
+template <typename Dtype>
+const int PackedMatrix<Dtype>::kPanelSize;
+template <typename Dtype>
+const int PackedMatrix<Dtype>::kMaxRows;
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::Pack(int N, int K, const Dtype* weights,
+    bool transposed) {
+  CHECK_GT(N, 0);
+  CHECK_GT(K, 0);
+  N_ = N;
+  K_ = K;
+  const int num_panels = (N + kPanel - 1) / kPanel;
+  // the outputs past N of the last panel have zero weights
+  panels_.assign(static_cast<size_t>(num_panels) * K * kPanel, Dtype(0));
+  for (int n = 0; n < N; ++n) {
+    Dtype* panel = &panels_[static_cast<size_t>(n / kPanel) * K * kPanel];
+    for (int k = 0; k < K; ++k) {
+      panel[k * kPanel + n % kPanel] = transposed ?
+          weights[static_cast<size_t>(k) * N + n] :
+          weights[static_cast<size_t>(n) * K + k];
+    }
+  }
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::Multiply(int M, const Dtype* input,
+    const Dtype* bias, bool relu, Dtype negative_slope, Dtype* output) const {
+  CHECK(initialized()) << "The weights are not packed.";
+  CHECK_GE(M, 0);
+  if (M == 0) {
+    return;
+  }
+  PackedProduct<Dtype> product;
+  product.M = M;
+  product.N = N_;
+  product.K = K_;
+  product.panels = &panels_[0];
+  product.input = input;
+  product.bias = bias;
+  product.relu = relu;
+  product.negative_slope = negative_slope;
+  product.output = output;
+  static const typename PackedProductFunction<Dtype>::Type multiply =
+      best_multiply_panels<Dtype>();
+  const int num_panels = (N_ + kPanel - 1) / kPanel;
+  parallel_for(num_panels, boost::bind(multiply, boost::cref(product), _1,
+      _2), M * K_ * kPanel);
+}
+
+INSTANTIATE_CLASS(PackedMatrix);
+
+}  // namespace caffe
@@ -0,0 +1,224 @@
+#include <boost/bind.hpp>
+
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/philox.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_PHILOX_X86
+#define PHILOX_INLINE inline __attribute__((always_inline))
+#else
+#define PHILOX_INLINE inline
+#endif
+
+namespace caffe {
+
+namespace {
+
+const uint32_t kPhiloxM0 = 0xD2511F53;
+const uint32_t kPhiloxM1 = 0xCD9E8D57;
+const uint32_t kPhiloxW0 = 0x9E3779B9;
+const uint32_t kPhiloxW1 = 0xBB67AE85;
+const int kPhiloxRounds = 10;
+
+// The number of blocks computed together: the blocks of a batch are
+// independent, the compiler vectorizes the loop over them.
+const int kBatchBlocks = 16;
+
+PHILOX_INLINE void philox_round(uint32_t* c0, uint32_t* c1, uint32_t* c2,
+    uint32_t* c3, uint32_t k0, uint32_t k1) {
+  const uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * *c0;
+  const uint64_t p1 = static_cast<uint64_t>(kPhiloxM1) * *c2;
+  const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ *c1 ^ k0;
+  const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ *c3 ^ k1;
+  *c1 = static_cast<uint32_t>(p1);
+  *c3 = static_cast<uint32_t>(p0);
+  *c0 = n0;
+  *c2 = n2;
+}
+
+// Stores the kBatchBlocks blocks of the counters [block, block +
+// kBatchBlocks) in r.
+PHILOX_INLINE void philox_batch(uint64_t key, uint64_t block, uint32_t* r) {
+  uint32_t c0[kBatchBlocks];
+  uint32_t c1[kBatchBlocks];
+  uint32_t c2[kBatchBlocks];
+  uint32_t c3[kBatchBlocks];
+  for (int j = 0; j < kBatchBlocks; ++j) {
+    uint32_t x0 = static_cast<uint32_t>(block + j);
+    uint32_t x1 = static_cast<uint32_t>((block + j) >> 32);
+    uint32_t x2 = 0;
+    uint32_t x3 = 0;
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int round = 0; round < kPhiloxRounds; ++round) {
+      philox_round(&x0, &x1, &x2, &x3, k0, k1);
+      k0 += kPhiloxW0;
+      k1 += kPhiloxW1;
+    }
+    c0[j] = x0;
+    c1[j] = x1;
+    c2[j] = x2;
+    c3[j] = x3;
+  }
+  for (int j = 0; j < kBatchBlocks; ++j) {
+    r[4 * j] = c0[j];
+    r[4 * j + 1] = c1[j];
+    r[4 * j + 2] = c2[j];
+    r[4 * j + 3] = c3[j];
+  }
+}
+
+// The batches are compiled for the vector instruction sets of vector_math
+// and selected by the CPU.
+void philox_batch_default(uint64_t key, uint64_t block, uint32_t* r) {
+  philox_batch(key, block, r);
+}
+
+#ifdef CAFFE_PHILOX_X86
+__attribute__((target("avx2"))) void philox_batch_avx2(uint64_t key,
+    uint64_t block, uint32_t* r) {
+  philox_batch(key, block, r);
+}
+
+__attribute__((target("avx512f"))) void philox_batch_avx512(uint64_t key,
+    uint64_t block, uint32_t* r) {
+  philox_batch(key, block, r);
+}
+#endif
+
+typedef void (*PhiloxBatchFunction)(uint64_t key, uint64_t block,
+    uint32_t* r);
+
+PhiloxBatchFunction best_philox_batch() {
+#ifdef CAFFE_PHILOX_X86
+  if (vector_math_supports(VECTOR_MATH_AVX512)) {
+    return &philox_batch_avx512;
+  }
+  if (vector_math_supports(VECTOR_MATH_AVX2)) {
+    return &philox_batch_avx2;
+  }
+#endif
+  return &philox_batch_default;
+}
+
+void bernoulli_range(uint64_t threshold, uint64_t key, uint64_t position,
+    unsigned int* r, int begin, int end) {
+  Philox::Generate(key, position + begin, end - begin, r + begin);
+  for (int i = begin; i < end; ++i) {
+    r[i] = r[i] < threshold;
+  }
+}
+
+template <typename Dtype>
+void uniform_range(Dtype a, Dtype b, uint64_t key, uint64_t position,
+    Dtype* r, int begin, int end) {
+  // the values are generated in batches on the stack, r may be float
+  const int kChunk = 4 * kBatchBlocks;
+  uint32_t values[kChunk];
+  const Dtype scale = (b - a) / 16777216;
+  for (int i = begin; i < end; i += kChunk) {
+    const int chunk = std::min(kChunk, end - i);
+    Philox::Generate(key, position + i, chunk, values);
+    for (int j = 0; j < chunk; ++j) {
+      // the 24 high bits are uniform in [0, 2^24), exact in float
+      r[i + j] = a + scale * static_cast<Dtype>(values[j] >> 8);
+    }
+  }
+}
+
+}  // namespace
+
+Philox::Philox(uint64_t key, uint64_t position)
+    : key_(key), position_(0) {
+  Seek(position);
+}
+
+void Philox::Seek(uint64_t position) {
+  position_ = position;
+  if (position_ & 3) {
+    Generate(key_, position_ & ~static_cast<uint64_t>(3), 4, block_);
+  }
+}
+
+void Philox::Block(const uint32_t counter[4], const uint32_t key[2],
+    uint32_t block[4]) {
+  uint32_t c0 = counter[0];
+  uint32_t c1 = counter[1];
+  uint32_t c2 = counter[2];
+  uint32_t c3 = counter[3];
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+  for (int round = 0; round < kPhiloxRounds; ++round) {
+    philox_round(&c0, &c1, &c2, &c3, k0, k1);
+    k0 += kPhiloxW0;
+    k1 += kPhiloxW1;
+  }
+  block[0] = c0;
+  block[1] = c1;
+  block[2] = c2;
+  block[3] = c3;
+}
+
+void Philox::Generate(uint64_t key, uint64_t position, int n, uint32_t* r) {
+  const uint32_t key_words[2] = {static_cast<uint32_t>(key),
+                                 static_cast<uint32_t>(key >> 32)};
+  static const PhiloxBatchFunction batch = best_philox_batch();
+  uint64_t block = position >> 2;
+  // the values before the first whole block and after the last one are
+  // copied from single blocks
+  int skip = position & 3;
+  while (n > 0) {
+    if (skip == 0 && n >= 4 * kBatchBlocks) {
+      batch(key, block, r);
+      block += kBatchBlocks;
+      r += 4 * kBatchBlocks;
+      n -= 4 * kBatchBlocks;
+      continue;
+    }
+    const uint32_t counter[4] = {static_cast<uint32_t>(block),
+                                 static_cast<uint32_t>(block >> 32), 0, 0};
+    uint32_t values[4];
+    Block(counter, key_words, values);
+    const int count = std::min(4 - skip, n);
+    for (int i = 0; i < count; ++i) {
+      r[i] = values[skip + i];
+    }
+    ++block;
+    r += count;
+    n -= count;
+    skip = 0;
+  }
+}
+
+void philox_bernoulli(int n, double p, uint64_t key, uint64_t position,
+    unsigned int* r) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 1);
+  // r[i] = value < p * 2^32
+  const uint64_t threshold = static_cast<uint64_t>(p * 4294967296.);
+  parallel_for(n, boost::bind(&bernoulli_range, threshold, key, position, r,
+      _1, _2));
+}
+
+template <typename Dtype>
+void philox_uniform(int n, Dtype a, Dtype b, uint64_t key, uint64_t position,
+    Dtype* r) {
+  CHECK_GE(n, 0);
+  CHECK(r);
+  CHECK_LE(a, b);
+  parallel_for(n, boost::bind(&uniform_range<Dtype>, a, b, key, position, r,
+      _1, _2));
+}
+
+template void philox_uniform<float>(int n, float a, float b, uint64_t key,
+    uint64_t position, float* r);
+template void philox_uniform<double>(int n, double a, double b, uint64_t key,
+    uint64_t position, double* r);
+
+}  // namespace caffe
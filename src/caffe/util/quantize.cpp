@@ -0,0 +1,326 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantize.hpp"
+
+namespace caffe {
+
+uint16_t caffe_float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));  // NOLINT(caffe/alt_fn)
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t magnitude = bits & 0x7FFFFFFF;
+  if (magnitude >= 0x7F800000) {
+    // infinity or NaN
+    return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+  }
+  if (magnitude >= 0x477FF000) {
+    // rounds to 65536 or more
+    return sign | 0x7C00;
+  }
+  if (magnitude < 0x38800000) {
+    // below 2^-14, a subnormal half of 2^-24 units
+    if (magnitude < 0x33000000) {
+      return sign;
+    }
+    const int shift = 126 - static_cast<int>(magnitude >> 23);
+    const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+      ++half;
+    }
+    return sign | half;
+  }
+  // rebias the exponent, a carry of the rounding increments the exponent
+  uint32_t half = (magnitude - 0x38000000) >> 13;
+  const uint32_t remainder = magnitude & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    ++half;
+  }
+  return sign | half;
+}
+
+float caffe_half_to_float(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1F;
+  uint32_t mantissa = value & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // normalize the subnormal value
+      exponent = 113;
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));  // NOLINT(caffe/alt_fn)
+  return result;
+}
+
+// A conversion the compiler vectorizes: the exponent is rebiased by a
+// multiplication, which also normalizes subnormal values.
+static inline float HalfToFloatFast(uint16_t value) {
+  uint32_t bits = static_cast<uint32_t>(value & 0x7FFF) << 13;
+  float magnitude;
+  memcpy(&magnitude, &bits, sizeof(bits));  // NOLINT(caffe/alt_fn)
+  magnitude *= 5.192296858534828e33f;  // 2^112
+  memcpy(&bits, &magnitude, sizeof(bits));  // NOLINT(caffe/alt_fn)
+  if (magnitude >= 65536.f) {
+    // infinity or NaN
+    bits |= 0x7F800000;
+  }
+  bits |= static_cast<uint32_t>(value & 0x8000) << 16;
+  float result;
+  memcpy(&result, &bits, sizeof(result));  // NOLINT(caffe/alt_fn)
+  return result;
+}
+
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x) {
+  Dtype result = 0;
+  for (int i = 0; i < n; ++i) {
+    result = std::max(result, std::fabs(x[i]));
+  }
+  return result;
+}
+
+template float caffe_cpu_amax<float>(const int n, const float* x);
+template double caffe_cpu_amax<double>(const int n, const double* x);
+
+template <typename Dtype>
+static inline int8_t QuantizeValue(Dtype value, Dtype inverse_scale) {
+  value = std::min(Dtype(127), std::max(Dtype(-127), value * inverse_scale));
+  return static_cast<int8_t>(value >= 0 ? value + Dtype(0.5)
+                                        : value - Dtype(0.5));
+}
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype* x, const Dtype scale,
+    int8_t* y) {
+  const Dtype inverse_scale = scale > 0 ? 1 / scale : 0;
+  for (int i = 0; i < n; ++i) {
+    y[i] = QuantizeValue(x[i], inverse_scale);
+  }
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float* x,
+    const float scale, int8_t* y);
+template void caffe_cpu_quantize<double>(const int n, const double* x,
+    const double scale, int8_t* y);
+
+void caffe_cpu_gemm_s8(const int M, const int N, const int K,
+    const int8_t* A, const int8_t* B, int32_t* C) {
+  // Four rows of B are used at once, so each row of A is read once for four
+  // outputs. The inner loops are vectorized by the compiler.
+  int n = 0;
+  for (; n + 4 <= N; n += 4) {
+    const int8_t* b0 = B + n * K;
+    const int8_t* b1 = b0 + K;
+    const int8_t* b2 = b1 + K;
+    const int8_t* b3 = b2 + K;
+    for (int m = 0; m < M; ++m) {
+      const int8_t* a = A + m * K;
+      int32_t sum0 = 0;
+      int32_t sum1 = 0;
+      int32_t sum2 = 0;
+      int32_t sum3 = 0;
+      for (int k = 0; k < K; ++k) {
+        const int32_t value = a[k];
+        sum0 += value * b0[k];
+        sum1 += value * b1[k];
+        sum2 += value * b2[k];
+        sum3 += value * b3[k];
+      }
+      int32_t* c = C + m * N + n;
+      c[0] = sum0;
+      c[1] = sum1;
+      c[2] = sum2;
+      c[3] = sum3;
+    }
+  }
+  for (; n < N; ++n) {
+    const int8_t* b = B + n * K;
+    for (int m = 0; m < M; ++m) {
+      const int8_t* a = A + m * K;
+      int32_t sum = 0;
+      for (int k = 0; k < K; ++k) {
+        sum += static_cast<int32_t>(a[k]) * b[k];
+      }
+      C[m * N + n] = sum;
+    }
+  }
+}
+
+template <typename Dtype>
+void QuantizedMatrix<Dtype>::Quantize(const QuantizationParameter& param,
+    int N, int K, const Dtype* weights, bool transposed) {
+  CHECK_NE(param.precision(), QuantizationParameter_Precision_FLOAT);
+  CHECK_GT(N, 0);
+  CHECK_GT(K, 0);
+  param_ = param;
+  N_ = N;
+  K_ = K;
+  // the rows of the outputs
+  vector<Dtype> rows;
+  if (transposed) {
+    rows.resize(N * K);
+    for (int k = 0; k < K; ++k) {
+      for (int n = 0; n < N; ++n) {
+        rows[n * K + k] = weights[k * N + n];
+      }
+    }
+    weights = rows.data();
+  }
+  if (param.precision() == QuantizationParameter_Precision_INT8) {
+    weights_int8_.resize(N * K);
+    weight_scales_.resize(N);
+    for (int n = 0; n < N; ++n) {
+      weight_scales_[n] = caffe_cpu_amax(K, weights + n * K) / 127;
+      caffe_cpu_quantize(K, weights + n * K, weight_scales_[n],
+                         &weights_int8_[n * K]);
+    }
+  } else {
+    weights_half_.resize(N * K);
+    for (int i = 0; i < N * K; ++i) {
+      weights_half_[i] = caffe_float_to_half(weights[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+void QuantizedMatrix<Dtype>::Multiply(int M, const Dtype* input,
+    bool input_transposed, Dtype* output, bool output_transposed) {
+  CHECK(initialized()) << "The weights are not quantized.";
+  const int N = N_;
+  const int K = K_;
+  if (param_.precision() == QuantizationParameter_Precision_INT8) {
+    const Dtype input_max = param_.input_max() > 0 ? param_.input_max()
+        : caffe_cpu_amax(M * K, input);
+    const Dtype input_scale = input_max / 127;
+    const Dtype inverse_scale = input_scale > 0 ? 1 / input_scale : 0;
+    input_int8_.resize(M * K);
+    if (input_transposed) {
+      for (int k = 0; k < K; ++k) {
+        for (int m = 0; m < M; ++m) {
+          input_int8_[m * K + k] = QuantizeValue(input[k * M + m],
+                                                 inverse_scale);
+        }
+      }
+    } else {
+      caffe_cpu_quantize(M * K, input, input_scale, input_int8_.data());
+    }
+    output_int32_.resize(M * N);
+    caffe_cpu_gemm_s8(M, N, K, input_int8_.data(), weights_int8_.data(),
+                      output_int32_.data());
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        const Dtype value = output_int32_[m * N + n] * input_scale
+            * weight_scales_[n];
+        output[output_transposed ? n * M + m : m * N + n] = value;
+      }
+    }
+    return;
+  }
+  // FP16: the rows are converted in blocks of about 256 KB.
+  const int block = std::max(1, (1 << 18) / static_cast<int>(sizeof(Dtype)) /
+                                K);
+  buffer_.resize(std::min(block, N) * K);
+  Dtype* rows_output = output;
+  if (!output_transposed) {
+    output_buffer_.resize(N * M);
+    rows_output = output_buffer_.data();
+  }
+  for (int n = 0; n < N; n += block) {
+    const int rows = std::min(block, N - n);
+    const uint16_t* half_rows = weights_half_.data() + n * K;
+    for (int i = 0; i < rows * K; ++i) {
+      buffer_[i] = HalfToFloatFast(half_rows[i]);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans,
+        input_transposed ? CblasNoTrans : CblasTrans, rows, M, K, Dtype(1),
+        buffer_.data(), input, Dtype(0), rows_output + n * M);
+  }
+  if (!output_transposed) {
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        output[m * N + n] = output_buffer_[n * M + m];
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(QuantizedMatrix);
+
+void QuantizeBlobProto(QuantizationParameter::Precision precision,
+    BlobProto* proto) {
+  if (precision == QuantizationParameter_Precision_FLOAT) {
+    return;
+  }
+  CHECK_GT(proto->data_size(), 0) << "Only float data can be quantized.";
+  const int count = proto->data_size();
+  if (precision == QuantizationParameter_Precision_FP16) {
+    string data(2 * count, 0);
+    for (int i = 0; i < count; ++i) {
+      const uint16_t value = caffe_float_to_half(proto->data(i));
+      data[2 * i] = static_cast<char>(value & 0xFF);
+      data[2 * i + 1] = static_cast<char>(value >> 8);
+    }
+    proto->set_half_data(data);
+  } else {
+    const int rows = proto->shape().dim_size() > 0 ? proto->shape().dim(0)
+        : (proto->has_num() ? proto->num() : 1);
+    CHECK_GT(rows, 0);
+    CHECK_EQ(count % rows, 0);
+    const int cols = count / rows;
+    string data(count, 0);
+    proto->clear_int8_scale();
+    for (int row = 0; row < rows; ++row) {
+      const float* values = proto->data().data() + row * cols;
+      const float scale = caffe_cpu_amax(cols, values) / 127;
+      proto->add_int8_scale(scale);
+      caffe_cpu_quantize(cols, values, scale,
+                         reinterpret_cast<int8_t*>(&data[row * cols]));
+    }
+    proto->set_int8_data(data);
+  }
+  proto->clear_data();
+}
+
+void CopyQuantizationParams(const NetParameter& weights, NetParameter* param) {
+  std::map<string, const QuantizationParameter*> quantization_params;
+  for (int i = 0; i < weights.layer_size(); ++i) {
+    if (weights.layer(i).has_quantization_param()) {
+      quantization_params[weights.layer(i).name()] =
+          &weights.layer(i).quantization_param();
+    }
+  }
+  for (int i = 0; i < param->layer_size(); ++i) {
+    std::map<string, const QuantizationParameter*>::const_iterator it =
+        quantization_params.find(param->layer(i).name());
+    if (it != quantization_params.end()) {
+      param->mutable_layer(i)->mutable_quantization_param()->CopyFrom(
+          *it->second);
+    }
+  }
+}
+
+}  // namespace caffe
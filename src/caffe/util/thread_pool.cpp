@@ -0,0 +1,122 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+void KeepMarker(int* marker) {}
+int task_marker;
+// points to task_marker while the thread runs tasks of a pool
+boost::thread_specific_ptr<int> in_task(&KeepMarker);
+
+}  // namespace
+
+struct ThreadPool::State {
+  State() : work(NULL), tasks(0), next_task(0), finished_tasks(0),
+      generation(0), stop(false) {}
+
+  // Runs the tasks of the current call of Run until none are left.
+  void RunTasks(int thread) {
+    int* outer_marker = in_task.get();
+    in_task.reset(&task_marker);
+    boost::mutex::scoped_lock lock(mutex);
+    while (next_task < tasks) {
+      const int task = next_task++;
+      const boost::function<void(int, int)>* current_work = work;
+      lock.unlock();
+      (*current_work)(task, thread);
+      lock.lock();
+      if (++finished_tasks == tasks) {
+        done.notify_all();
+      }
+    }
+    lock.unlock();
+    in_task.reset(outer_marker);
+  }
+
+  void Work(int thread) {
+    int finished_generation = 0;
+    while (true) {
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        while (!stop && generation == finished_generation) {
+          start.wait(lock);
+        }
+        if (stop) {
+          return;
+        }
+        finished_generation = generation;
+      }
+      RunTasks(thread);
+    }
+  }
+
+  boost::mutex mutex;
+  boost::condition_variable start;
+  boost::condition_variable done;
+  const boost::function<void(int, int)>* work;
+  int tasks;
+  int next_task;
+  int finished_tasks;
+  // incremented by each call of Run
+  int generation;
+  bool stop;
+  vector<shared_ptr<boost::thread> > threads;
+};
+
+ThreadPool::ThreadPool(int threads)
+    : threads_(threads), state_(new State()) {
+  if (threads_ <= 0) {
+    threads_ = std::max(1u, boost::thread::hardware_concurrency());
+  }
+  for (int i = 1; i < threads_; ++i) {
+    state_->threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        &State::Work, state_.get(), i)));
+  }
+}
+
+bool ThreadPool::InTask() {
+  return in_task.get() != NULL;
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(state_->mutex);
+    state_->stop = true;
+  }
+  state_->start.notify_all();
+  for (int i = 0; i < state_->threads.size(); ++i) {
+    state_->threads[i]->join();
+  }
+}
+
+void ThreadPool::Run(int tasks, const boost::function<void(int, int)>& work) {
+  if (threads_ == 1 || tasks <= 1) {
+    for (int i = 0; i < tasks; ++i) {
+      work(i, 0);
+    }
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(state_->mutex);
+    state_->work = &work;
+    state_->tasks = tasks;
+    state_->next_task = 0;
+    state_->finished_tasks = 0;
+    ++state_->generation;
+  }
+  state_->start.notify_all();
+  state_->RunTasks(0);
+  boost::mutex::scoped_lock lock(state_->mutex);
+  while (state_->finished_tasks < state_->tasks) {
+    state_->done.wait(lock);
+  }
+  state_->work = NULL;
+}
+
+}  // namespace caffe
@@ -0,0 +1,376 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "caffe/common.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_VECTOR_MATH_X86
+#endif
+
+namespace caffe {
+
+namespace {
+
+// The scalar functions, the reference of the vectorized ones.
+struct ScalarExp {
+  float operator()(float x) const { return std::exp(x); }
+};
+struct ScalarLog {
+  float operator()(float x) const { return std::log(x); }
+};
+struct ScalarTanh {
+  float operator()(float x) const { return std::tanh(x); }
+};
+struct ScalarPowx {
+  explicit ScalarPowx(float b) : b(b) {}
+  float operator()(float x) const { return std::pow(x, b); }
+  float b;
+};
+
+template <typename Op>
+void scalar_apply(const int n, const float* a, float* y, const Op& op) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = op(a[i]);
+  }
+}
+
+#ifdef CAFFE_VECTOR_MATH_X86
+
+// The functions are written once with the vector extensions of GCC for
+// vectors VF of floats and VI of ints, and compiled for each instruction set
+// by inlining them into the functions with the target attributes below.
+// The ABI warnings of the wider vectors do not apply, since the functions
+// using them are inlined into functions of their instruction set.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#define VECTOR_MATH_INLINE inline __attribute__((always_inline))
+
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef float v8sf __attribute__((vector_size(32)));
+typedef int v8si __attribute__((vector_size(32)));
+typedef float v16sf __attribute__((vector_size(64)));
+typedef int v16si __attribute__((vector_size(64)));
+
+// The constants are splat to vectors explicitly, which lets the compiler
+// keep them in registers or read them from memory operands instead of
+// broadcasting them at each use.
+template <typename VF>
+VECTOR_MATH_INLINE VF splat(float value) {
+  return VF() + value;
+}
+
+// A step of the Horner scheme of a polynomial: p * x + c.
+template <typename VF>
+VECTOR_MATH_INLINE VF horner(const VF& p, const VF& x, float c) {
+  return p * x + splat<VF>(c);
+}
+
+// The float 1.5 * 2^23, whose last bits are the ints in [-2^22, 2^22) added
+// to it, which converts between floats and ints without the conversion
+// instructions of each instruction set.
+const float kMagic = 12582912.f;
+const int kMagicBits = 0x4b400000;
+
+// Returns x rounded to the nearest int, for |x| < 2^22.
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VI round_int(const VF& x) {
+  return reinterpret_cast<VI>(x + splat<VF>(kMagic)) - kMagicBits;
+}
+
+// Returns the float of x, for |x| < 2^22.
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF to_float(const VI& x) {
+  return reinterpret_cast<VF>(x + kMagicBits) - splat<VF>(kMagic);
+}
+
+// Returns 2^n for n in [-126, 127].
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF pow2(const VI& n) {
+  return reinterpret_cast<VF>((n + 127) << 23);
+}
+
+// Cephes expf: exp(x) = 2^n exp(r) with |r| <= ln(2) / 2.
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF exp_v(const VF& x) {
+  const VF lo = splat<VF>(-87.3365447504f);
+  const VF hi = splat<VF>(88.7228391117f);
+  const VF c = x < lo ? lo : (x > hi ? hi : x);
+  const VI n = round_int<VF, VI>(c * splat<VF>(1.44269504088896341f));
+  const VF fn = to_float<VF, VI>(n);
+  const VF r = c - fn * splat<VF>(0.693359375f) +
+      fn * splat<VF>(2.12194440e-4f);
+  VF p = horner(splat<VF>(1.9875691500E-4f), r, 1.3981999507E-3f);
+  p = horner(p, r, 8.3334519073E-3f);
+  p = horner(p, r, 4.1665795894E-2f);
+  p = horner(p, r, 1.6666665459E-1f);
+  p = horner(p, r, 5.0000001201E-1f);
+  p = p * (r * r) + r + splat<VF>(1.f);
+  // 2^n is split in two factors, since n may be 128
+  const VI n1 = n >> 1;
+  VF y = p * pow2<VF, VI>(n1) * pow2<VF, VI>(n - n1);
+  y = x < lo ? splat<VF>(0.f) : y;
+  return x > hi ? splat<VF>(std::numeric_limits<float>::infinity()) : y;
+}
+
+// Cephes logf: log(x) = log(m) + e log(2) with m in [sqrt(1/2), sqrt(2)).
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF log_v(const VF& x) {
+  // denormals are scaled by 2^23
+  const VI denormal = x < splat<VF>(std::numeric_limits<float>::min());
+  const VF scaled = denormal ? x * splat<VF>(8388608.f) : x;
+  const VI bits = reinterpret_cast<VI>(scaled);
+  VI e = ((bits >> 23) & 0xff) - 126 + (denormal & -23);
+  // m in [0.5, 1)
+  VF m = reinterpret_cast<VF>((bits & 0x007fffff) | 0x3f000000);
+  const VI small = m < splat<VF>(0.707106781186547524f);
+  e += small;
+  const VF r = (small ? m + m : m) - splat<VF>(1.f);
+  const VF z = r * r;
+  VF p = horner(splat<VF>(7.0376836292E-2f), r, -1.1514610310E-1f);
+  p = horner(p, r, 1.1676998740E-1f);
+  p = horner(p, r, -1.2420140846E-1f);
+  p = horner(p, r, 1.4249322787E-1f);
+  p = horner(p, r, -1.6668057665E-1f);
+  p = horner(p, r, 2.0000714765E-1f);
+  p = horner(p, r, -2.4999993993E-1f);
+  p = horner(p, r, 3.3333331174E-1f);
+  const VF fe = to_float<VF, VI>(e);
+  VF y = p * r * z - fe * splat<VF>(2.12194440e-4f) - splat<VF>(0.5f) * z;
+  y = r + y + fe * splat<VF>(0.693359375f);
+  const VF infinity = splat<VF>(std::numeric_limits<float>::infinity());
+  y = x == infinity ? x : y;
+  y = x == splat<VF>(0.f) ? -infinity : y;
+  // negative inputs and NaNs
+  return x >= splat<VF>(0.f) ? y
+      : splat<VF>(std::numeric_limits<float>::quiet_NaN());
+}
+
+// Cephes tanhf: an odd polynomial for |x| < 0.625, 1 - 2 / (exp(2x) + 1)
+// otherwise.
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF tanh_v(const VF& x) {
+  const VI sign = reinterpret_cast<VI>(x) & 0x80000000;
+  const VF abs = reinterpret_cast<VF>(reinterpret_cast<VI>(x) ^ sign);
+  const VF z = x * x;
+  VF p = horner(splat<VF>(-5.70498872745E-3f), z, 2.06390887954E-2f);
+  p = horner(p, z, -5.37397155531E-2f);
+  p = horner(p, z, 1.33314422036E-1f);
+  p = horner(p, z, -3.33332819422E-1f);
+  const VF small = p * z * x + x;
+  const VF one = splat<VF>(1.f);
+  const VF large = one - splat<VF>(2.f) / (exp_v<VF, VI>(abs + abs) + one);
+  const VF signed_large = reinterpret_cast<VF>(
+      reinterpret_cast<VI>(large) | sign);
+  return abs < splat<VF>(0.625f) ? small : signed_large;
+}
+
+// a^b = exp(b log|a|), negated for negative a and odd integer b and NaN for
+// negative a and non-integer b.
+template <typename VF, typename VI>
+VECTOR_MATH_INLINE VF powx_v(const VF& x, float b, bool integer, bool odd) {
+  const VI sign = reinterpret_cast<VI>(x) & 0x80000000;
+  const VF abs = reinterpret_cast<VF>(reinterpret_cast<VI>(x) ^ sign);
+  VF y = exp_v<VF, VI>(log_v<VF, VI>(abs) * splat<VF>(b));
+  if (odd) {
+    y = reinterpret_cast<VF>(reinterpret_cast<VI>(y) | sign);
+  } else if (!integer) {
+    y = x < splat<VF>(0.f)
+        ? splat<VF>(std::numeric_limits<float>::quiet_NaN()) : y;
+  }
+  return y;
+}
+
+// Applies op to the n values of a, with a partial vector for the last values.
+template <typename VF, typename Op>
+VECTOR_MATH_INLINE void vector_apply(const int n, const float* a, float* y,
+    const Op& op) {
+  const int kWidth = sizeof(VF) / sizeof(float);
+  int i = 0;
+  for (; i + kWidth <= n; i += kWidth) {
+    VF x;
+    memcpy(&x, a + i, sizeof(VF));  // NOLINT(caffe/alt_fn)
+    x = op(x);
+    memcpy(y + i, &x, sizeof(VF));  // NOLINT(caffe/alt_fn)
+  }
+  if (i < n) {
+    VF x = splat<VF>(1.f);
+    memcpy(&x, a + i, (n - i) * sizeof(float));  // NOLINT(caffe/alt_fn)
+    x = op(x);
+    memcpy(y + i, &x, (n - i) * sizeof(float));  // NOLINT(caffe/alt_fn)
+  }
+}
+
+template <typename VF, typename VI>
+struct VectorExp {
+  VECTOR_MATH_INLINE VF operator()(const VF& x) const {
+    return exp_v<VF, VI>(x);
+  }
+};
+template <typename VF, typename VI>
+struct VectorLog {
+  VECTOR_MATH_INLINE VF operator()(const VF& x) const {
+    return log_v<VF, VI>(x);
+  }
+};
+template <typename VF, typename VI>
+struct VectorTanh {
+  VECTOR_MATH_INLINE VF operator()(const VF& x) const {
+    return tanh_v<VF, VI>(x);
+  }
+};
+template <typename VF, typename VI>
+struct VectorPowx {
+  VectorPowx(float b, bool integer, bool odd)
+      : b(b), integer(integer), odd(odd) {}
+  VECTOR_MATH_INLINE VF operator()(const VF& x) const {
+    return powx_v<VF, VI>(x, b, integer, odd);
+  }
+  float b;
+  bool integer;
+  bool odd;
+};
+
+// Defines the functions of an instruction set.
+#define DEFINE_VECTOR_MATH_FUNCS(isa, isa_target, VF, VI) \
+  __attribute__((target(isa_target))) void exp_##isa(const int n, \
+      const float* a, float* y) { \
+    vector_apply<VF>(n, a, y, VectorExp<VF, VI>()); \
+  } \
+  __attribute__((target(isa_target))) void log_##isa(const int n, \
+      const float* a, float* y) { \
+    vector_apply<VF>(n, a, y, VectorLog<VF, VI>()); \
+  } \
+  __attribute__((target(isa_target))) void tanh_##isa(const int n, \
+      const float* a, float* y) { \
+    vector_apply<VF>(n, a, y, VectorTanh<VF, VI>()); \
+  } \
+  __attribute__((target(isa_target))) void powx_##isa(const int n, \
+      const float* a, const float b, bool integer, bool odd, float* y) { \
+    vector_apply<VF>(n, a, y, VectorPowx<VF, VI>(b, integer, odd)); \
+  }
+
+DEFINE_VECTOR_MATH_FUNCS(sse2, "sse2", v4sf, v4si)
+DEFINE_VECTOR_MATH_FUNCS(avx2, "avx2,fma", v8sf, v8si)
+DEFINE_VECTOR_MATH_FUNCS(avx512, "avx512f", v16sf, v16si)
+
+#undef DEFINE_VECTOR_MATH_FUNCS
+#undef VECTOR_MATH_INLINE
+
+#endif  // CAFFE_VECTOR_MATH_X86
+
+VectorMathISA best_isa() {
+#ifdef CAFFE_VECTOR_MATH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return VECTOR_MATH_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return VECTOR_MATH_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return VECTOR_MATH_SSE2;
+  }
+#endif
+  return VECTOR_MATH_SCALAR;
+}
+
+VectorMathISA& current_isa() {
+  static VectorMathISA isa = best_isa();
+  return isa;
+}
+
+}  // namespace
+
+VectorMathISA vector_math_isa() {
+  return current_isa();
+}
+
+bool vector_math_supports(VectorMathISA isa) {
+  return isa <= best_isa();
+}
+
+void set_vector_math_isa(VectorMathISA isa) {
+  CHECK(vector_math_supports(isa)) << "The CPU does not support "
+      << vector_math_isa_name(isa);
+  current_isa() = isa;
+}
+
+const char* vector_math_isa_name(VectorMathISA isa) {
+  switch (isa) {
+  case VECTOR_MATH_SCALAR:
+    return "scalar";
+  case VECTOR_MATH_SSE2:
+    return "SSE2";
+  case VECTOR_MATH_AVX2:
+    return "AVX2";
+  case VECTOR_MATH_AVX512:
+    return "AVX-512";
+  default:
+    LOG(FATAL) << "Unknown vector math instruction set " << isa;
+  }
+  return "";
+}
+
+#ifdef CAFFE_VECTOR_MATH_X86
+#define DISPATCH_VECTOR_MATH(func, args, scalar) \
+  switch (current_isa()) { \
+  case VECTOR_MATH_AVX512: \
+    func##_avx512 args; \
+    break; \
+  case VECTOR_MATH_AVX2: \
+    func##_avx2 args; \
+    break; \
+  case VECTOR_MATH_SSE2: \
+    func##_sse2 args; \
+    break; \
+  default: \
+    scalar; \
+  }
+#else
+#define DISPATCH_VECTOR_MATH(func, args, scalar) scalar;
+#endif
+
+void vector_exp(const int n, const float* a, float* y) {
+  DISPATCH_VECTOR_MATH(exp, (n, a, y), scalar_apply(n, a, y, ScalarExp()));
+}
+
+void vector_log(const int n, const float* a, float* y) {
+  DISPATCH_VECTOR_MATH(log, (n, a, y), scalar_apply(n, a, y, ScalarLog()));
+}
+
+void vector_tanh(const int n, const float* a, float* y) {
+  DISPATCH_VECTOR_MATH(tanh, (n, a, y), scalar_apply(n, a, y, ScalarTanh()));
+}
+
+void vector_powx(const int n, const float* a, const float b, float* y) {
+  // the common exponents are computed exactly
+  if (b == 1.f) {
+    memmove(y, a, n * sizeof(float));
+  } else if (b == 2.f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = a[i] * a[i];
+    }
+  } else if (b == 0.5f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::sqrt(a[i]);
+    }
+  } else if (b == -1.f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1.f / a[i];
+    }
+  } else if (b == 0.f || !(b == b)) {
+    scalar_apply(n, a, y, ScalarPowx(b));
+  } else {
+    const bool integer = std::floor(b) == b;
+    const bool odd = integer && std::fmod(b, 2.f) != 0.f;
+    DISPATCH_VECTOR_MATH(powx, (n, a, b, integer, odd, y),
+        scalar_apply(n, a, y, ScalarPowx(b)));
+  }
+}
+
+#undef DISPATCH_VECTOR_MATH
+
+}  // namespace caffe
@@ -0,0 +1,43 @@
+#include <algorithm>
+#include <map>
+
+#include "caffe/util/workspace.hpp"
+
+namespace caffe {
+
+void Workspace::Reserve(const void* owner, size_t size) {
+  size_t& reservation = reservations_[owner];
+  reservation = std::max(reservation, size);
+  Grow(size);
+}
+
+void* Workspace::mutable_cpu_data(size_t size) {
+  Grow(size);
+  return memory_->mutable_cpu_data();
+}
+
+#ifndef CPU_ONLY
+void* Workspace::mutable_gpu_data(size_t size) {
+  Grow(size);
+  return memory_->mutable_gpu_data();
+}
+#endif
+
+size_t Workspace::reserved() const {
+  size_t total = 0;
+  for (std::map<const void*, size_t>::const_iterator it =
+       reservations_.begin(); it != reservations_.end(); ++it) {
+    total += it->second;
+  }
+  return total;
+}
+
+void Workspace::Grow(size_t size) {
+  // the contents are temporary, so they are not copied
+  if (!memory_ || size > size_) {
+    size_ = std::max(size_, size);
+    memory_.reset(new SyncedMemory(size_));
+  }
+}
+
+}  // namespace caffe
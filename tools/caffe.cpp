@@ -7,12 +7,15 @@ namespace bp = boost::python;
 #include <glog/logging.h>
 
 #include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/layer_cost.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -23,6 +26,8 @@ using caffe::Solver;
 using caffe::shared_ptr;
 using caffe::string;
 using caffe::Timer;
+using caffe::GetTimeStats;
+using caffe::TimeStats;
 using caffe::vector;
 using std::ostringstream;
 
@@ -48,6 +53,18 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(warmup, 5,
+    "Optional; the number of untimed iterations before 'time' measures.");
+DEFINE_bool(forward_only, false,
+    "Optional; only time the forward pass in 'time'.");
+DEFINE_string(json, "",
+    "Optional; the file to write the results of 'time' to as JSON.");
+DEFINE_string(host_allocator, "",
+    "Optional; the allocator of the host memory: malloc, pool or "
+    "pool_hugepages (default: $CAFFE_HOST_ALLOCATOR or malloc).");
+DEFINE_int32(cpu_threads, -1,
+    "Optional; the number of threads of the CPU element-wise kernels, 0 for "
+    "one per hardware thread (default: $CAFFE_CPU_THREADS or 1).");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -335,6 +352,38 @@ int test() {
 RegisterBrewFunction(test);
 
 
+static std::string FormatTimeStats(const TimeStats& stats) {
+  ostringstream out;
+  out << "mean " << stats.mean << " ms, median " << stats.median
+      << " ms, p99 " << stats.p99 << " ms";
+  return out.str();
+}
+
+// GFLOP/s for the given number of operations in the given time in ms.
+static double GFlopsPerSecond(double flops, double ms) {
+  return ms > 0 ? flops / ms / 1e6 : 0;
+}
+
+static std::string JsonString(const std::string& value) {
+  ostringstream out;
+  out << '"';
+  for (int i = 0; i < value.size(); ++i) {
+    if (value[i] == '"' || value[i] == '\\') {
+      out << '\\';
+    }
+    out << value[i];
+  }
+  out << '"';
+  return out.str();
+}
+
+static std::string JsonTimeStats(const TimeStats& stats) {
+  ostringstream out;
+  out << "{\"mean\": " << stats.mean << ", \"median\": " << stats.median
+      << ", \"p99\": " << stats.p99 << "}";
+  return out.str();
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -363,14 +412,33 @@ int time() {
   float initial_loss;
   caffe_net.Forward(&initial_loss);
   LOG(INFO) << "Initial loss: " << initial_loss;
-  LOG(INFO) << "Performing Backward";
-  caffe_net.Backward();
+  if (!FLAGS_forward_only) {
+    LOG(INFO) << "Performing Backward";
+    caffe_net.Backward();
+  }
+  LOG(INFO) << "Warming up for " << FLAGS_warmup << " iterations.";
+  for (int j = 0; j < FLAGS_warmup; ++j) {
+    caffe_net.Forward();
+    if (!FLAGS_forward_only) {
+      caffe_net.Backward();
+    }
+  }
 
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
   const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
   const vector<vector<Blob<float>*> >& top_vecs = caffe_net.top_vecs();
   const vector<vector<bool> >& bottom_need_backward =
       caffe_net.bottom_need_backward();
+  vector<caffe::LayerCost> costs(layers.size());
+  caffe::LayerCost total_cost;
+  for (int i = 0; i < layers.size(); ++i) {
+    costs[i] = caffe::EstimateLayerCost(layers[i].get(), bottom_vecs[i],
+                                        top_vecs[i]);
+    total_cost.forward_flops += costs[i].forward_flops;
+    total_cost.backward_flops += costs[i].backward_flops;
+    total_cost.forward_bytes += costs[i].forward_bytes;
+    total_cost.backward_bytes += costs[i].backward_bytes;
+  }
   LOG(INFO) << "*** Benchmark begins ***";
   LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
   Timer total_timer;
@@ -378,10 +446,12 @@ int time() {
   Timer forward_timer;
   Timer backward_timer;
   Timer timer;
-  std::vector<double> forward_time_per_layer(layers.size(), 0.0);
-  std::vector<double> backward_time_per_layer(layers.size(), 0.0);
-  double forward_time = 0.0;
-  double backward_time = 0.0;
+  // times of each iteration in ms
+  vector<vector<double> > forward_time_per_layer(layers.size());
+  vector<vector<double> > backward_time_per_layer(layers.size());
+  vector<double> forward_times;
+  vector<double> backward_times;
+  vector<double> iteration_times;
   for (int j = 0; j < FLAGS_iterations; ++j) {
     Timer iter_timer;
     iter_timer.Start();
@@ -389,39 +459,112 @@ int time() {
     for (int i = 0; i < layers.size(); ++i) {
       timer.Start();
       layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
-      forward_time_per_layer[i] += timer.MicroSeconds();
+      forward_time_per_layer[i].push_back(timer.MilliSeconds());
     }
-    forward_time += forward_timer.MicroSeconds();
-    backward_timer.Start();
-    for (int i = layers.size() - 1; i >= 0; --i) {
-      timer.Start();
-      layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
-                          bottom_vecs[i]);
-      backward_time_per_layer[i] += timer.MicroSeconds();
+    forward_times.push_back(forward_timer.MilliSeconds());
+    if (!FLAGS_forward_only) {
+      backward_timer.Start();
+      for (int i = layers.size() - 1; i >= 0; --i) {
+        timer.Start();
+        layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
+                            bottom_vecs[i]);
+        backward_time_per_layer[i].push_back(timer.MilliSeconds());
+      }
+      backward_times.push_back(backward_timer.MilliSeconds());
     }
-    backward_time += backward_timer.MicroSeconds();
+    iteration_times.push_back(iter_timer.MilliSeconds());
     LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
-      << iter_timer.MilliSeconds() << " ms.";
+      << iteration_times.back() << " ms.";
   }
-  LOG(INFO) << "Average time per layer: ";
+  total_timer.Stop();
+
+  vector<TimeStats> forward_stats(layers.size());
+  vector<TimeStats> backward_stats(layers.size());
+  LOG(INFO) << "Time per layer: ";
   for (int i = 0; i < layers.size(); ++i) {
     const caffe::string& layername = layers[i]->layer_param().name();
+    forward_stats[i] = GetTimeStats(forward_time_per_layer[i]);
     LOG(INFO) << std::setfill(' ') << std::setw(10) << layername <<
-      "\tforward: " << forward_time_per_layer[i] / 1000 /
-      FLAGS_iterations << " ms.";
-    LOG(INFO) << std::setfill(' ') << std::setw(10) << layername  <<
-      "\tbackward: " << backward_time_per_layer[i] / 1000 /
-      FLAGS_iterations << " ms.";
+      "\tforward: " << FormatTimeStats(forward_stats[i]) << ", " <<
+      GFlopsPerSecond(costs[i].forward_flops, forward_stats[i].mean) <<
+      " GFLOP/s.";
+    if (!FLAGS_forward_only) {
+      backward_stats[i] = GetTimeStats(backward_time_per_layer[i]);
+      LOG(INFO) << std::setfill(' ') << std::setw(10) << layername  <<
+        "\tbackward: " << FormatTimeStats(backward_stats[i]) << ", " <<
+        GFlopsPerSecond(costs[i].backward_flops, backward_stats[i].mean) <<
+        " GFLOP/s.";
+    }
+  }
+  const TimeStats forward_total = GetTimeStats(forward_times);
+  const TimeStats backward_total = GetTimeStats(backward_times);
+  const TimeStats iteration_total = GetTimeStats(iteration_times);
+  LOG(INFO) << "Average Forward pass: " << forward_total.mean << " ms.";
+  LOG(INFO) << "Forward pass: " << FormatTimeStats(forward_total) << ", "
+    << GFlopsPerSecond(total_cost.forward_flops, forward_total.mean)
+    << " GFLOP/s.";
+  if (!FLAGS_forward_only) {
+    LOG(INFO) << "Average Backward pass: " << backward_total.mean << " ms.";
+    LOG(INFO) << "Backward pass: " << FormatTimeStats(backward_total) << ", "
+      << GFlopsPerSecond(total_cost.backward_flops, backward_total.mean)
+      << " GFLOP/s.";
   }
-  total_timer.Stop();
-  LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
-    FLAGS_iterations << " ms.";
-  LOG(INFO) << "Average Backward pass: " << backward_time / 1000 /
-    FLAGS_iterations << " ms.";
   LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+  const caffe::HostAllocatorStats host_stats =
+      caffe::GetHostAllocator()->stats();
+  LOG(INFO) << "Host allocator " << caffe::GetHostAllocator()->type() << ": "
+    << host_stats.allocations << " allocations, " << host_stats.pool_hits
+    << " from the pool, peak " << host_stats.peak_bytes_in_use / (1 << 20)
+    << " MB in use.";
+
+  if (!FLAGS_json.empty()) {
+    std::ofstream json(FLAGS_json.c_str());
+    CHECK(json) << "Could not open " << FLAGS_json;
+    json.precision(10);
+    json << "{\n"
+         << "  \"model\": " << JsonString(FLAGS_model) << ",\n"
+         << "  \"phase\": \"" << (phase == caffe::TRAIN ? "TRAIN" : "TEST")
+         << "\",\n"
+         << "  \"mode\": \"" << (Caffe::mode() == Caffe::GPU ? "GPU" : "CPU")
+         << "\",\n"
+         << "  \"warmup\": " << FLAGS_warmup << ",\n"
+         << "  \"iterations\": " << FLAGS_iterations << ",\n"
+         << "  \"forward_ms\": " << JsonTimeStats(forward_total) << ",\n";
+    if (!FLAGS_forward_only) {
+      json << "  \"backward_ms\": " << JsonTimeStats(backward_total) << ",\n"
+           << "  \"forward_backward_ms\": " << JsonTimeStats(iteration_total)
+           << ",\n";
+    }
+    json << "  \"forward_flops\": " << total_cost.forward_flops << ",\n"
+         << "  \"forward_gflops_per_s\": "
+         << GFlopsPerSecond(total_cost.forward_flops, forward_total.mean)
+         << ",\n"
+         << "  \"layers\": [";
+    for (int i = 0; i < layers.size(); ++i) {
+      json << (i ? "," : "") << "\n    {"
+           << "\"name\": " << JsonString(layers[i]->layer_param().name())
+           << ", \"type\": " << JsonString(layers[i]->type())
+           << ", \"forward_ms\": " << JsonTimeStats(forward_stats[i])
+           << ", \"forward_flops\": " << costs[i].forward_flops
+           << ", \"forward_bytes\": " << costs[i].forward_bytes
+           << ", \"forward_gflops_per_s\": "
+           << GFlopsPerSecond(costs[i].forward_flops, forward_stats[i].mean);
+      if (!FLAGS_forward_only) {
+        json << ", \"backward_ms\": " << JsonTimeStats(backward_stats[i])
+             << ", \"backward_flops\": " << costs[i].backward_flops
+             << ", \"backward_bytes\": " << costs[i].backward_bytes
+             << ", \"backward_gflops_per_s\": "
+             << GFlopsPerSecond(costs[i].backward_flops,
+                                backward_stats[i].mean);
+      }
+      json << "}";
+    }
+    json << "\n  ]\n}\n";
+    LOG(INFO) << "Wrote results to " << FLAGS_json;
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -441,6 +584,12 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  if (!FLAGS_host_allocator.empty()) {
+    caffe::SetHostAllocator(FLAGS_host_allocator);
+  }
+  if (FLAGS_cpu_threads >= 0) {
+    caffe::Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,391 @@
+// This program computes the statistics of a DeepDriving leveldb/lmdb in a
+// single pass: the image mean (stored like compute_image_mean does) and the
+// standard deviation per channel, min, max, mean, standard deviation and
+// histogram of every float_data label and the distribution of the number of
+// lanes. From the label ranges it derives label_transform parameters for
+// the data layer.
+// The database is read by one thread and the records are decoded and
+// accumulated by --threads workers.
+// Usage:
+//    compute_dataset_stats [FLAGS] INPUT_DB [MEAN_FILE]
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+
+#include "torcs/Indicators.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using boost::scoped_ptr;
+using std::string;
+using std::vector;
+
+DEFINE_string(backend, "leveldb",
+        "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(threads, 0,
+        "The number of worker threads (0 = number of cores)");
+DEFINE_int32(chunk_size, 256,
+        "The number of records passed to a worker at once");
+DEFINE_int32(label_dim, 14,
+        "The number of float_data labels per datum");
+DEFINE_int32(bins, 20,
+        "The number of histogram bins between min and max of each label");
+DEFINE_double(histogram_resolution, 0.01,
+        "The labels are counted in steps of this size for the histograms");
+DEFINE_double(target_min, 0.1,
+        "The value the label_transform maps the minimum of a label to");
+DEFINE_double(target_max, 0.9,
+        "The value the label_transform maps the maximum of a label to");
+DEFINE_string(label_transform, "",
+        "Optional file to write the label_transform parameters to");
+
+// The labels in the order of torcs/Database.cpp.
+static const char* kDeepDrivingLabels[] = {
+  "angle", "toMarking_L", "toMarking_M", "toMarking_R", "dist_L", "dist_R",
+  "toMarking_LL", "toMarking_ML", "toMarking_MR", "toMarking_RR", "dist_LL",
+  "dist_MM", "dist_RR", "fast"
+};
+static const int kDeepDrivingLabelDim = 14;
+// getNumberOfLanes() returns 0 to 3 lanes
+static const int kMaxLanes = 3;
+// the histogram steps of larger labels are clamped to this magnitude
+static const double kMaxHistogramStep = 1e15;
+
+class DatasetStats {
+ public:
+  DatasetStats(int channels, int data_size, int label_dim)
+      : count_(0), channels_(channels), pixel_sum_(data_size, 0),
+        channel_sum_sq_(channels, 0), label_min_(label_dim, 0),
+        label_max_(label_dim, 0), label_sum_(label_dim, 0),
+        label_sum_sq_(label_dim, 0), label_count_(label_dim, 0),
+        label_invalid_(label_dim, 0), label_hist_(label_dim),
+        lanes_(kMaxLanes + 1, 0) {}
+
+  void Add(const Datum& datum) {
+    const string& data = datum.data();
+    CHECK_EQ(data.size(), pixel_sum_.size()) << "Incorrect data field size";
+    CHECK_GE(datum.float_data_size(), label_sum_.size())
+        << "Not enough float_data labels";
+    const int dim = pixel_sum_.size() / channels_;
+    for (int c = 0; c < channels_; ++c) {
+      const uint8_t* pixels =
+          reinterpret_cast<const uint8_t*>(data.data()) + c * dim;
+      uint64_t* sum = &pixel_sum_[c * dim];
+      uint64_t sum_sq = 0;
+      for (int i = 0; i < dim; ++i) {
+        sum[i] += pixels[i];
+        sum_sq += pixels[i] * pixels[i];
+      }
+      channel_sum_sq_[c] += sum_sq;
+    }
+
+    for (int i = 0; i < label_sum_.size(); ++i) {
+      const float label = datum.float_data(i);
+      // a corrupt record may contain NaN or infinite labels
+      if (!std::isfinite(label)) {
+        ++label_invalid_[i];
+        continue;
+      }
+      if (label_count_[i] == 0 || label < label_min_[i]) {
+        label_min_[i] = label;
+      }
+      if (label_count_[i] == 0 || label > label_max_[i]) {
+        label_max_[i] = label;
+      }
+      label_sum_[i] += label;
+      label_sum_sq_[i] += static_cast<double>(label) * label;
+      const double step = std::floor(label / FLAGS_histogram_resolution);
+      ++label_hist_[i][static_cast<int64_t>(std::min(std::max(step,
+          -kMaxHistogramStep), kMaxHistogramStep))];
+      ++label_count_[i];
+    }
+
+    if (label_sum_.size() == kDeepDrivingLabelDim) {
+      Indicators indicators;
+      indicators.Angle                              = datum.float_data(0);
+      indicators.DistanceToLeftMarking              = datum.float_data(1);
+      indicators.DistanceToCenterMarking            = datum.float_data(2);
+      indicators.DistanceToRightMarking             = datum.float_data(3);
+      indicators.DistanceToLeftObstacle             = datum.float_data(4);
+      indicators.DistanceToRightObstacle            = datum.float_data(5);
+      indicators.DistanceToLeftMarkingOfLeftLane    = datum.float_data(6);
+      indicators.DistanceToLeftMarkingOfCenterLane  = datum.float_data(7);
+      indicators.DistanceToRightMarkingOfCenterLane = datum.float_data(8);
+      indicators.DistanceToRightMarkingOfRightLane  = datum.float_data(9);
+      indicators.DistanceToLeftObstacleInLane       = datum.float_data(10);
+      indicators.DistanceToCenterObstacleInLane     = datum.float_data(11);
+      indicators.DistanceToRightObstacleInLane      = datum.float_data(12);
+      indicators.Fast                               = datum.float_data(13);
+      ++lanes_[std::min(indicators.getNumberOfLanes(), kMaxLanes)];
+    }
+    ++count_;
+  }
+
+  void Merge(const DatasetStats& other) {
+    if (other.count_ == 0) {
+      return;
+    }
+    for (int i = 0; i < pixel_sum_.size(); ++i) {
+      pixel_sum_[i] += other.pixel_sum_[i];
+    }
+    for (int c = 0; c < channels_; ++c) {
+      channel_sum_sq_[c] += other.channel_sum_sq_[c];
+    }
+    for (int i = 0; i < label_sum_.size(); ++i) {
+      label_invalid_[i] += other.label_invalid_[i];
+      if (other.label_count_[i] == 0) {
+        continue;
+      }
+      if (label_count_[i] == 0 || other.label_min_[i] < label_min_[i]) {
+        label_min_[i] = other.label_min_[i];
+      }
+      if (label_count_[i] == 0 || other.label_max_[i] > label_max_[i]) {
+        label_max_[i] = other.label_max_[i];
+      }
+      label_count_[i] += other.label_count_[i];
+      label_sum_[i] += other.label_sum_[i];
+      label_sum_sq_[i] += other.label_sum_sq_[i];
+      for (std::map<int64_t, uint64_t>::const_iterator it =
+           other.label_hist_[i].begin(); it != other.label_hist_[i].end();
+           ++it) {
+        label_hist_[i][it->first] += it->second;
+      }
+    }
+    for (int i = 0; i < lanes_.size(); ++i) {
+      lanes_[i] += other.lanes_[i];
+    }
+    count_ += other.count_;
+  }
+
+  uint64_t count_;
+  int channels_;
+  vector<uint64_t> pixel_sum_;
+  vector<uint64_t> channel_sum_sq_;
+  vector<float> label_min_;
+  vector<float> label_max_;
+  vector<double> label_sum_;
+  vector<double> label_sum_sq_;
+  // number of finite labels, which the statistics are computed of, and of
+  // the skipped NaN or infinite ones
+  vector<uint64_t> label_count_;
+  vector<uint64_t> label_invalid_;
+  // number of labels per histogram_resolution step
+  vector<std::map<int64_t, uint64_t> > label_hist_;
+  vector<uint64_t> lanes_;
+};
+
+typedef BlockingQueue<vector<string>*> ChunkQueue;
+
+// Decodes the chunks of records until it gets a NULL chunk.
+void Work(ChunkQueue* full, ChunkQueue* free, DatasetStats* stats) {
+  Datum datum;
+  for (vector<string>* chunk = full->pop(); chunk; chunk = full->pop()) {
+    for (int i = 0; i < chunk->size(); ++i) {
+      datum.ParseFromString((*chunk)[i]);
+#ifdef USE_OPENCV
+      DecodeDatumNative(&datum);
+#else
+      CHECK(!datum.encoded()) << "Encoded records require OpenCV.";
+#endif  // USE_OPENCV
+      stats->Add(datum);
+    }
+    free->push(chunk);
+  }
+}
+
+static string LabelName(int i) {
+  if (FLAGS_label_dim == kDeepDrivingLabelDim) {
+    return kDeepDrivingLabels[i];
+  }
+  std::ostringstream name;
+  name << "label " << i;
+  return name.str();
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Compute the image mean and the label statistics "
+        "of a DeepDriving leveldb/lmdb\n"
+        "Usage:\n"
+        "    compute_dataset_stats [FLAGS] INPUT_DB [MEAN_FILE]\n");
+
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 2 || argc > 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_dataset_stats");
+    return 1;
+  }
+  CHECK_GT(FLAGS_chunk_size, 0);
+  CHECK_GT(FLAGS_bins, 0);
+  CHECK_GT(FLAGS_histogram_resolution, 0);
+
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+
+  // load first datum
+  Datum datum;
+  datum.ParseFromString(cursor->value());
+#ifdef USE_OPENCV
+  if (DecodeDatumNative(&datum)) {
+    LOG(INFO) << "Decoding Datum";
+  }
+#endif  // USE_OPENCV
+  const int channels = datum.channels();
+  const int data_size = datum.channels() * datum.height() * datum.width();
+
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max<int>(1, boost::thread::hardware_concurrency());
+  LOG(INFO) << "Starting Iteration with " << threads << " threads";
+  ChunkQueue free;
+  ChunkQueue full;
+  // Two chunks per worker keep them busy while the db is read.
+  vector<shared_ptr<vector<string> > > chunks(2 * threads);
+  for (int i = 0; i < chunks.size(); ++i) {
+    chunks[i].reset(new vector<string>());
+    free.push(chunks[i].get());
+  }
+  vector<shared_ptr<DatasetStats> > stats(threads);
+  boost::thread_group workers;
+  for (int i = 0; i < threads; ++i) {
+    stats[i].reset(new DatasetStats(channels, data_size, FLAGS_label_dim));
+    workers.create_thread(boost::bind(&Work, &full, &free, stats[i].get()));
+  }
+
+  int count = 0;
+  while (cursor->valid()) {
+    vector<string>* chunk = free.pop();
+    chunk->clear();
+    for (; cursor->valid() && chunk->size() < FLAGS_chunk_size;
+         cursor->Next()) {
+      chunk->push_back(cursor->value());
+    }
+    full.push(chunk);
+    const int last_count = count;
+    count += chunk->size();
+    if (count / 10000 != last_count / 10000) {
+      LOG(INFO) << "Processed " << count << " files.";
+    }
+  }
+  for (int i = 0; i < threads; ++i) {
+    full.push(NULL);
+  }
+  workers.join_all();
+  LOG(INFO) << "Processed " << count << " files.";
+  CHECK_GT(count, 0) << "The database is empty.";
+
+  DatasetStats total(channels, data_size, FLAGS_label_dim);
+  for (int i = 0; i < threads; ++i) {
+    total.Merge(*stats[i]);
+  }
+
+  // image mean and standard deviation
+  BlobProto mean_blob;
+  mean_blob.set_num(1);
+  mean_blob.set_channels(datum.channels());
+  mean_blob.set_height(datum.height());
+  mean_blob.set_width(datum.width());
+  for (int i = 0; i < data_size; ++i) {
+    mean_blob.add_data(static_cast<double>(total.pixel_sum_[i]) / count);
+  }
+  if (argc == 3) {
+    LOG(INFO) << "Write to " << argv[2];
+    WriteProtoToBinaryFile(mean_blob, argv[2]);
+  }
+  const int dim = data_size / channels;
+  LOG(INFO) << "Number of channels: " << channels;
+  for (int c = 0; c < channels; ++c) {
+    double sum = 0;
+    for (int i = 0; i < dim; ++i) {
+      sum += total.pixel_sum_[c * dim + i];
+    }
+    const double n = static_cast<double>(count) * dim;
+    const double mean = sum / n;
+    const double stddev = std::sqrt(std::max(0.0,
+        total.channel_sum_sq_[c] / n - mean * mean));
+    LOG(INFO) << "mean_value channel [" << c << "]:" << mean
+              << " std: " << stddev;
+  }
+
+  // labels
+  std::ostringstream transforms;
+  for (int i = 0; i < FLAGS_label_dim; ++i) {
+    const float min = total.label_min_[i];
+    const float max = total.label_max_[i];
+    if (total.label_invalid_[i] > 0) {
+      LOG(WARNING) << LabelName(i) << ": skipped " << total.label_invalid_[i]
+                   << " NaN or infinite labels";
+    }
+    const double label_count = std::max<uint64_t>(total.label_count_[i], 1);
+    const double mean = total.label_sum_[i] / label_count;
+    const double stddev = std::sqrt(std::max(0.0,
+        total.label_sum_sq_[i] / label_count - mean * mean));
+    LOG(INFO) << LabelName(i) << ": min " << min << " max " << max
+              << " mean " << mean << " std " << stddev;
+
+    vector<uint64_t> bins(FLAGS_bins, 0);
+    for (std::map<int64_t, uint64_t>::const_iterator it =
+         total.label_hist_[i].begin(); it != total.label_hist_[i].end();
+         ++it) {
+      const double value = it->first * FLAGS_histogram_resolution;
+      const int bin = max > min ?
+          static_cast<int>((value - min) / (max - min) * FLAGS_bins) : 0;
+      bins[std::min(std::max(bin, 0), FLAGS_bins - 1)] += it->second;
+    }
+    std::ostringstream hist;
+    for (int b = 0; b < FLAGS_bins; ++b) {
+      hist << " " << bins[b];
+    }
+    LOG(INFO) << "  histogram [" << min << ", " << max << "]:" << hist.str();
+
+    // map [min, max] to [target_min, target_max]
+    const double scale = max > min ?
+        (FLAGS_target_max - FLAGS_target_min) / (max - min) : 1;
+    const double shift = FLAGS_target_min - min * scale;
+    transforms << "    label_transform { scale: " << scale << " shift: "
+               << shift << " }  # " << LabelName(i) << " range ~ [" << min
+               << ", " << max << "]\n";
+  }
+
+  if (FLAGS_label_dim == kDeepDrivingLabelDim) {
+    for (int lanes = 0; lanes <= kMaxLanes; ++lanes) {
+      LOG(INFO) << "Records with " << lanes << " lanes: "
+                << total.lanes_[lanes] << " ("
+                << 100.0 * total.lanes_[lanes] / count << "%)";
+    }
+  }
+
+  LOG(INFO) << "label_transform for the data layer:\n" << transforms.str();
+  if (!FLAGS_label_transform.empty()) {
+    LOG(INFO) << "Write to " << FLAGS_label_transform;
+    std::ofstream file(FLAGS_label_transform.c_str());
+    CHECK(file) << "Could not open " << FLAGS_label_transform;
+    file << transforms.str();
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// This program measures the CPU forward and backward pass of each
+// convolution of a model (by default the DeepDriving run model) with the
+// input shapes of the model, for each of the --threads counts of the
+// cpu_threads of the convolution_param, and prints the size of the column
+// buffer of each convolution.
+// Usage:
+//    conv_benchmark [FLAGS]
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "torcs/pre_trained/driving_run_1F.prototxt",
+        "The model whose convolutions are measured");
+DEFINE_int32(batch_size, 1,
+        "The batch size of the inputs of the convolutions");
+DEFINE_int32(iterations, 10,
+        "The number of timed passes of each convolution");
+DEFINE_string(threads, "1,2,4",
+        "The cpu_threads of the forward passes, separated by ','");
+DEFINE_bool(backward, true,
+        "Whether to measure the backward pass");
+DEFINE_string(cpu_algorithm, "",
+        "The cpu_algorithm of the convolutions, e.g. TILED, instead of the "
+        "one of the model");
+
+// Returns the milliseconds of a forward (or backward) pass of layer.
+static double TimePass(Layer<float>* layer, const vector<Blob<float>*>& bottom,
+    const vector<Blob<float>*>& top, bool backward) {
+  const vector<bool> propagate_down(bottom.size(), true);
+  CPUTimer timer;
+  // warm up
+  for (int i = -1; i < FLAGS_iterations; ++i) {
+    if (i == 0) {
+      timer.Start();
+    }
+    if (backward) {
+      layer->Backward(top, propagate_down, bottom);
+    } else {
+      layer->Forward(bottom, top);
+    }
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure the convolutions of a model.\n"
+        "Usage:\n"
+        "    conv_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  CHECK_GT(FLAGS_batch_size, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+  vector<int> thread_counts;
+  std::istringstream thread_list(FLAGS_threads);
+  for (string item; std::getline(thread_list, item, ','); ) {
+    thread_counts.push_back(atoi(item.c_str()));
+    CHECK_GE(thread_counts.back(), 0) << "Invalid thread count " << item;
+  }
+  ConvolutionParameter::CPUAlgorithm cpu_algorithm =
+      ConvolutionParameter_CPUAlgorithm_GEMM;
+  CHECK(FLAGS_cpu_algorithm.empty() || ConvolutionParameter::
+      CPUAlgorithm_Parse(FLAGS_cpu_algorithm, &cpu_algorithm))
+      << "Unknown cpu_algorithm " << FLAGS_cpu_algorithm;
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(1701);
+
+  // the shapes of the inputs of the convolutions
+  Net<float> net(FLAGS_model, TEST);
+  printf("%-8s %-22s %-6s %10s %8s %12s %12s\n", "layer", "input", "group",
+      "col MB", "threads", "forward ms", "backward ms");
+  for (int l = 0; l < net.layers().size(); ++l) {
+    const LayerParameter& model_param = net.layers()[l]->layer_param();
+    if (model_param.type() != "Convolution") {
+      continue;
+    }
+    vector<int> input_shape = net.bottom_vecs()[l][0]->shape();
+    input_shape[0] = FLAGS_batch_size;
+    Blob<float> input(input_shape);
+    caffe_rng_gaussian<float>(input.count(), 0, 1, input.mutable_cpu_data());
+    const vector<Blob<float>*> bottom(1, &input);
+    Blob<float> output;
+    const vector<Blob<float>*> top(1, &output);
+    const int group = model_param.convolution_param().group();
+    for (int t = 0; t < thread_counts.size(); ++t) {
+      LayerParameter layer_param(model_param);
+      layer_param.mutable_convolution_param()->set_cpu_threads(
+          thread_counts[t]);
+      layer_param.mutable_convolution_param()->mutable_weight_filler()
+          ->set_type("gaussian");
+      if (!FLAGS_cpu_algorithm.empty()) {
+        layer_param.mutable_convolution_param()->set_cpu_algorithm(
+            cpu_algorithm);
+      }
+      layer_param.clear_relu_param();
+      layer_param.set_phase(TRAIN);
+      shared_ptr<Layer<float> > layer =
+          LayerRegistry<float>::CreateLayer(layer_param);
+      layer->SetUp(bottom, top);
+      caffe_rng_gaussian<float>(output.count(), 0, 1,
+          output.mutable_cpu_diff());
+      // the columns of one group of one image
+      const double col_mb = static_cast<double>(layer->blobs()[0]->count(1))
+          * output.count(2) * sizeof(float) / (1 << 20);
+      const double forward_ms = TimePass(layer.get(), bottom, top, false);
+      const double backward_ms = FLAGS_backward ?
+          TimePass(layer.get(), bottom, top, true) : 0;
+      printf("%-8s %-22s %-6d %10.2f %8d %12.3f %12.3f\n",
+          model_param.name().c_str(), input.shape_string().c_str(), group,
+          col_mb, thread_counts[t], forward_ms, backward_ms);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,301 @@
+// This program copies the records of one or more leveldb/lmdb databases into
+// new databases, optionally of another backend. It can
+//  - concatenate several recordings, whose keys are renumbered to follow
+//    each other (like torcs_record continues after the last key), or merge
+//    them by their original keys (the first input wins for duplicate keys),
+//  - select a range of keys and
+//  - split the (renumbered) key range into shards of equal size.
+// The databases are read and written by one thread each, while --threads
+// workers parse and check (and optionally decode) the records in between.
+// Usage:
+//    convert_db [FLAGS] OUTPUT_DB INPUT_DB [INPUT_DB ...]
+// With --shards=N the outputs are OUTPUT_DB_0 ... OUTPUT_DB_<N-1>.
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using boost::scoped_ptr;
+using std::string;
+using std::vector;
+
+DEFINE_string(input_backend, "leveldb",
+        "The backend {leveldb, lmdb} of the input databases");
+DEFINE_string(output_backend, "lmdb",
+        "The backend {leveldb, lmdb} of the output databases");
+DEFINE_int32(threads, 0,
+        "The number of worker threads (0 = number of cores)");
+DEFINE_int32(chunk_size, 256,
+        "The number of records passed to a worker at once");
+DEFINE_int32(batch_mb, 64,
+        "The size of a write transaction in MB");
+DEFINE_bool(renumber, true,
+        "Renumber the keys, so that each input follows the previous one "
+        "(otherwise a key which is already copied from a previous input is "
+        "skipped)");
+DEFINE_int32(start_key, 0,
+        "The first key of the output if --renumber is set");
+DEFINE_int32(first_key, -1,
+        "The first (output) key to copy (-1 = from the beginning)");
+DEFINE_int32(last_key, -1,
+        "The last (output) key to copy (-1 = until the end)");
+DEFINE_int32(shards, 1,
+        "Split the output key range into this number of databases");
+DEFINE_int32(label_dim, 14,
+        "Check that each datum has this number of float_data labels "
+        "(0 = no check)");
+DEFINE_bool(decode, false,
+        "Store encoded records decoded (requires OpenCV)");
+
+// A chunk holds pairs of output key and value: key, value, key, value, ...
+typedef BlockingQueue<vector<string>*> ChunkQueue;
+
+struct Input {
+  string source;
+  int first_key;
+  int last_key;
+  // added to the input key to get the output key
+  int offset;
+};
+
+// Checks and converts the records of a chunk until it gets a NULL chunk.
+void Work(ChunkQueue* full, ChunkQueue* done) {
+  Datum datum;
+  for (vector<string>* chunk = full->pop(); chunk; chunk = full->pop()) {
+    for (int i = 0; i < chunk->size(); i += 2) {
+      string& value = (*chunk)[i + 1];
+      CHECK(datum.ParseFromString(value))
+          << "Record " << (*chunk)[i] << " is not a Datum.";
+      if (FLAGS_label_dim > 0) {
+        CHECK_EQ(datum.float_data_size(), FLAGS_label_dim)
+            << "Record " << (*chunk)[i] << " has a wrong number of labels.";
+      }
+      if (FLAGS_decode && datum.encoded()) {
+#ifdef USE_OPENCV
+        CHECK(DecodeDatumNative(&datum))
+            << "Could not decode record " << (*chunk)[i];
+        CHECK(datum.SerializeToString(&value));
+#else
+        LOG(FATAL) << "Decoding records requires OpenCV.";
+#endif  // USE_OPENCV
+      }
+    }
+    done->push(chunk);
+  }
+  done->push(NULL);
+}
+
+// Reads all inputs and passes the selected records to the workers. Without
+// renumbering the inputs may share keys, only the first record of a key is
+// passed on and the others are counted in duplicates.
+void Read(const vector<Input>& inputs, int min_key, int max_key,
+    ChunkQueue* free, ChunkQueue* full, int threads, int* duplicates) {
+  vector<string>* chunk = free->pop();
+  chunk->clear();
+  vector<bool> copied(FLAGS_renumber ? 0 : max_key - min_key + 1, false);
+  *duplicates = 0;
+  for (int i = 0; i < inputs.size(); ++i) {
+    scoped_ptr<db::DB> db(db::GetDB(FLAGS_input_backend));
+    db->Open(inputs[i].source, db::READ);
+    scoped_ptr<db::Cursor> cursor(db->NewCursor());
+    if (FLAGS_first_key >= 0) {
+      cursor->Seek(format_int(FLAGS_first_key - inputs[i].offset, 8));
+    }
+    int skipped = 0;
+    for (; cursor->valid(); cursor->Next()) {
+      const string key = cursor->key();
+      const int output_key = std::atoi(key.c_str()) + inputs[i].offset;
+      if (FLAGS_last_key >= 0 && output_key > FLAGS_last_key) {
+        break;
+      }
+      if (!FLAGS_renumber && output_key >= min_key &&
+          output_key <= max_key) {
+        if (copied[output_key - min_key]) {
+          ++skipped;
+          continue;
+        }
+        copied[output_key - min_key] = true;
+      }
+      chunk->push_back(FLAGS_renumber ? format_int(output_key, 8) : key);
+      chunk->push_back(cursor->value());
+      if (chunk->size() >= 2 * FLAGS_chunk_size) {
+        full->push(chunk);
+        chunk = free->pop();
+        chunk->clear();
+      }
+    }
+    if (skipped > 0) {
+      LOG(WARNING) << inputs[i].source << ": skipped " << skipped
+                   << " records whose keys are already copied.";
+      *duplicates += skipped;
+    }
+  }
+  full->push(chunk);
+  for (int i = 0; i < threads; ++i) {
+    full->push(NULL);
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Copy and concatenate leveldb/lmdb databases, "
+        "optionally into another\n"
+        "backend or split into several shards.\n"
+        "Usage:\n"
+        "    convert_db [FLAGS] OUTPUT_DB INPUT_DB [INPUT_DB ...]\n");
+
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_db");
+    return 1;
+  }
+  CHECK_GT(FLAGS_chunk_size, 0);
+  CHECK_GT(FLAGS_batch_mb, 0);
+  CHECK_GT(FLAGS_shards, 0);
+
+  // The key ranges of the inputs give the output key range.
+  vector<Input> inputs(argc - 2);
+  int next_key = FLAGS_start_key;
+  int min_key = 0;
+  int max_key = 0;
+  for (int i = 0; i < inputs.size(); ++i) {
+    scoped_ptr<db::DB> db(db::GetDB(FLAGS_input_backend));
+    db->Open(argv[i + 2], db::READ);
+    scoped_ptr<db::Cursor> cursor(db->NewCursor());
+    CHECK(cursor->valid()) << "The database " << argv[i + 2] << " is empty.";
+    inputs[i].source = argv[i + 2];
+    inputs[i].first_key = std::atoi(cursor->key().c_str());
+    cursor->SeekToLast();
+    inputs[i].last_key = std::atoi(cursor->key().c_str());
+    inputs[i].offset = FLAGS_renumber ? next_key - inputs[i].first_key : 0;
+    next_key = inputs[i].last_key + inputs[i].offset + 1;
+    LOG(INFO) << inputs[i].source << ": keys " << inputs[i].first_key
+              << " to " << inputs[i].last_key << " -> "
+              << inputs[i].first_key + inputs[i].offset << " to "
+              << inputs[i].last_key + inputs[i].offset;
+    if (i == 0 || inputs[i].first_key + inputs[i].offset < min_key) {
+      min_key = inputs[i].first_key + inputs[i].offset;
+    }
+    max_key = std::max(max_key, inputs[i].last_key + inputs[i].offset);
+  }
+  if (FLAGS_first_key >= 0) {
+    min_key = std::max(min_key, FLAGS_first_key);
+  }
+  if (FLAGS_last_key >= 0) {
+    max_key = std::min(max_key, FLAGS_last_key);
+  }
+  CHECK_LE(min_key, max_key) << "No key is in the selected range.";
+  // Each shard gets an equal part of the selected key range.
+  const int64_t shard_keys =
+      (static_cast<int64_t>(max_key) - min_key) / FLAGS_shards + 1;
+
+  vector<shared_ptr<db::DB> > outputs(FLAGS_shards);
+  vector<shared_ptr<db::Transaction> > txns(FLAGS_shards);
+  vector<size_t> txn_bytes(FLAGS_shards, 0);
+  vector<int> counts(FLAGS_shards, 0);
+  for (int i = 0; i < FLAGS_shards; ++i) {
+    string output = argv[1];
+    if (FLAGS_shards > 1) {
+      output += "_" + format_int(i);
+      LOG(INFO) << output << ": keys " << min_key + i * shard_keys << " to "
+                << std::min<int64_t>(max_key, min_key + (i + 1) * shard_keys
+                   - 1);
+    }
+    outputs[i].reset(db::GetDB(FLAGS_output_backend));
+    outputs[i]->Open(output, db::NEW);
+    txns[i].reset(outputs[i]->NewTransaction());
+  }
+
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max<int>(1, boost::thread::hardware_concurrency());
+  LOG(INFO) << "Starting conversion with " << threads << " threads";
+  ChunkQueue free;
+  ChunkQueue full;
+  ChunkQueue done;
+  // Two chunks per worker keep them busy while the dbs are read and written.
+  vector<shared_ptr<vector<string> > > chunks(2 * threads + 1);
+  for (int i = 0; i < chunks.size(); ++i) {
+    chunks[i].reset(new vector<string>());
+    free.push(chunks[i].get());
+  }
+  boost::thread_group workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.create_thread(boost::bind(&Work, &full, &done));
+  }
+  int duplicates = 0;
+  workers.create_thread(boost::bind(&Read, boost::cref(inputs), min_key,
+      max_key, &free, &full, threads, &duplicates));
+
+  // Write the records in the order they are done, the databases sort them.
+  const size_t batch_bytes = static_cast<size_t>(FLAGS_batch_mb) << 20;
+  int count = 0;
+  for (int finished = 0; finished < threads; ) {
+    vector<string>* chunk = done.pop();
+    if (chunk == NULL) {
+      ++finished;
+      continue;
+    }
+    for (int i = 0; i < chunk->size(); i += 2) {
+      const string& key = (*chunk)[i];
+      const string& value = (*chunk)[i + 1];
+      const int shard = FLAGS_shards == 1 ? 0 :
+          (std::atoi(key.c_str()) - min_key) / shard_keys;
+      CHECK_LT(shard, FLAGS_shards);
+      txns[shard]->Put(key, value);
+      txn_bytes[shard] += key.size() + value.size();
+      ++counts[shard];
+      if (txn_bytes[shard] >= batch_bytes) {
+        txns[shard]->Commit();
+        txns[shard].reset(outputs[shard]->NewTransaction());
+        txn_bytes[shard] = 0;
+      }
+      if (++count % 10000 == 0) {
+        LOG(INFO) << "Processed " << count << " files.";
+      }
+    }
+    free.push(chunk);
+  }
+  workers.join_all();
+
+  // write the last batches
+  for (int i = 0; i < FLAGS_shards; ++i) {
+    if (txn_bytes[i] > 0) {
+      txns[i]->Commit();
+    }
+    txns[i].reset();
+    outputs[i]->Close();
+    if (FLAGS_shards > 1) {
+      LOG(INFO) << "Shard " << i << ": " << counts[i] << " files.";
+    }
+  }
+  LOG(INFO) << "Processed " << count << " files.";
+  if (duplicates > 0) {
+    LOG(WARNING) << "Skipped " << duplicates << " files with duplicate keys.";
+  }
+  return 0;
+}
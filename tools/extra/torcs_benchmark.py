@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+
+"""
+CPU performance regression suite for the DeepDriving model
+
+run:     runs the torcs_benchmark tool once for each thread count (the BLAS and
+         Caffe CPU threads are set by the environment) and merges the results
+         into a single JSON file, optionally comparing it against a baseline.
+compare: compares two result files and fails if a result got slower than the
+         tolerance allows.
+
+Example:
+    torcs_benchmark.py run --bin build/tools/torcs_benchmark --threads 1,4 \\
+        --output current.json --baseline baseline.json
+    torcs_benchmark.py compare baseline.json current.json --tolerance 0.1
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+FORMAT_VERSION = 1
+THREAD_VARIABLES = ['OMP_NUM_THREADS', 'OPENBLAS_NUM_THREADS',
+                    'MKL_NUM_THREADS', 'CAFFE_CPU_THREADS']
+
+
+def result_key(result):
+    return (result['name'], result['batch_size'], result['threads'])
+
+
+def load_results(path):
+    with open(path) as f:
+        results = json.load(f)
+    if results.get('format') != FORMAT_VERSION:
+        raise ValueError('%s has format %s, expected %d'
+                         % (path, results.get('format'), FORMAT_VERSION))
+    return results
+
+
+def run(args):
+    merged = None
+    for threads in args.threads.split(','):
+        env = dict(os.environ)
+        for variable in THREAD_VARIABLES:
+            env[variable] = threads
+        handle, output = tempfile.mkstemp(suffix='.json')
+        os.close(handle)
+        try:
+            command = [args.bin, '--threads=' + threads,
+                       '--output=' + output,
+                       '--batch_sizes=' + args.batch_sizes,
+                       '--iterations=%d' % args.iterations,
+                       '--warmup=%d' % args.warmup] + args.extra
+            print(' '.join(command))
+            subprocess.check_call(command, env=env)
+            results = load_results(output)
+        finally:
+            os.remove(output)
+        if merged is None:
+            merged = results
+            merged['threads'] = []
+        else:
+            merged['results'].extend(results['results'])
+        merged['threads'].append(int(threads))
+
+    with open(args.output, 'w') as f:
+        json.dump(merged, f, indent=2, sort_keys=True)
+    print('Wrote results to %s' % args.output)
+    if args.baseline:
+        return compare_files(args.baseline, args.output, args.tolerance,
+                             args.metric)
+    return 0
+
+
+def compare_files(baseline_path, current_path, tolerance, metric):
+    baseline = dict((result_key(r), r)
+                    for r in load_results(baseline_path)['results'])
+    current = load_results(current_path)['results']
+    regressions = 0
+    print('%-28s %6s %7s %12s %12s %8s' % ('name', 'batch', 'threads',
+                                           'baseline', 'current', 'change'))
+    for result in sorted(current, key=result_key):
+        key = result_key(result)
+        if key not in baseline:
+            print('%-28s %6d %7d %12s %12.3f %8s' % (key + ('-', result[metric],
+                                                            'new')))
+            continue
+        old = baseline[key][metric]
+        new = result[metric]
+        change = (new - old) / old if old > 0 else 0.0
+        status = ''
+        if change > tolerance:
+            status = 'REGRESSION'
+            regressions += 1
+        print('%-28s %6d %7d %12.3f %12.3f %+7.1f%% %s'
+              % (key + (old, new, 100 * change, status)))
+    missing = set(baseline) - set(result_key(r) for r in current)
+    for key in sorted(missing):
+        print('%-28s %6d %7d missing in %s' % (key + (current_path,)))
+    if regressions:
+        print('%d results are more than %.0f%% slower than the baseline.'
+              % (regressions, 100 * tolerance))
+        return 1
+    return 0
+
+
+def compare(args):
+    return compare_files(args.baseline, args.current, args.tolerance,
+                         args.metric)
+
+
+def add_compare_arguments(parser):
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='Allowed relative slowdown (default 0.1)')
+    parser.add_argument('--metric', default='median_ms',
+                        choices=['mean_ms', 'median_ms', 'p99_ms'],
+                        help='The time that is compared (default median_ms)')
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    subparsers = parser.add_subparsers(dest='command')
+    subparsers.required = True
+
+    run_parser = subparsers.add_parser('run', help='Run the benchmarks')
+    run_parser.add_argument('--bin', default='build/tools/torcs_benchmark',
+                            help='The torcs_benchmark tool')
+    run_parser.add_argument('--threads', default='1,2,4',
+                            help='The thread counts, separated by ","')
+    run_parser.add_argument('--batch_sizes', default='1,8,64,128',
+                            help='The batch sizes, separated by ","')
+    run_parser.add_argument('--iterations', type=int, default=20)
+    run_parser.add_argument('--warmup', type=int, default=3)
+    run_parser.add_argument('--output', default='torcs_benchmark.json',
+                            help='The merged result file')
+    run_parser.add_argument('--baseline',
+                            help='Optional; compare the results against it')
+    run_parser.add_argument('extra', nargs='*',
+                            help='Further flags for torcs_benchmark '
+                                 '(after --)')
+    add_compare_arguments(run_parser)
+    run_parser.set_defaults(function=run)
+
+    compare_parser = subparsers.add_parser('compare',
+                                           help='Compare two result files')
+    compare_parser.add_argument('baseline')
+    compare_parser.add_argument('current')
+    add_compare_arguments(compare_parser)
+    compare_parser.set_defaults(function=compare)
+    return parser.parse_args()
+
+
+if __name__ == '__main__':
+    args = parse_args()
+    sys.exit(args.function(args))
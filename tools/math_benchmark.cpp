@@ -0,0 +1,192 @@
+// This program measures the float exp, log, pow and tanh of math_functions
+// with each instruction set of the vectorized backend supported by the CPU,
+// and their speedup to the scalar libm path, then the element-wise functions
+// with each of the --threads counts of parallel_for and their speedup to the
+// first count.
+// Usage:
+//    math_benchmark [FLAGS]
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using std::string;
+using std::vector;
+
+DEFINE_int32(count, 1 << 20,
+        "The number of values of each call");
+DEFINE_int32(iterations, 20,
+        "The number of timed calls of each function");
+DEFINE_double(power, 0.75,
+        "The exponent of caffe_powx");
+DEFINE_string(threads, "1,2,4",
+        "The thread counts of the element-wise functions");
+DEFINE_int32(grain_size, 0,
+        "The grain size of parallel_for, 0 keeps the default");
+
+enum Function { EXP, LOG, POWX, TANH, NUM_FUNCTIONS };
+static const char* kFunctionNames[] = {"exp", "log", "powx", "tanh"};
+
+enum ElementwiseFunction { ADD, MUL, AXPY, SCALE, SET, EXP_ELEMENTWISE,
+                           NUM_ELEMENTWISE_FUNCTIONS };
+static const char* kElementwiseNames[] = {"add", "mul", "axpy", "scale", "set",
+                                          "exp"};
+
+// Returns the milliseconds of a call of function on x.
+static double TimeFunction(Function function, const vector<float>& x,
+    vector<float>* y) {
+  CPUTimer timer;
+  // warm up
+  for (int i = -1; i < FLAGS_iterations; ++i) {
+    if (i == 0) {
+      timer.Start();
+    }
+    switch (function) {
+    case EXP:
+      caffe_exp<float>(x.size(), &x[0], &(*y)[0]);
+      break;
+    case LOG:
+      caffe_log<float>(x.size(), &x[0], &(*y)[0]);
+      break;
+    case POWX:
+      caffe_powx<float>(x.size(), &x[0], FLAGS_power, &(*y)[0]);
+      break;
+    case TANH:
+      caffe_tanh<float>(x.size(), &x[0], &(*y)[0]);
+      break;
+    default:
+      LOG(FATAL) << "Unknown function " << function;
+    }
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+// Returns the milliseconds of a call of the element-wise function on a and b.
+static double TimeElementwise(ElementwiseFunction function,
+    const vector<float>& a, const vector<float>& b, vector<float>* y) {
+  const int n = a.size();
+  CPUTimer timer;
+  for (int i = -1; i < FLAGS_iterations; ++i) {
+    if (i == 0) {
+      timer.Start();
+    }
+    switch (function) {
+    case ADD:
+      caffe_add<float>(n, &a[0], &b[0], &(*y)[0]);
+      break;
+    case MUL:
+      caffe_mul<float>(n, &a[0], &b[0], &(*y)[0]);
+      break;
+    case AXPY:
+      caffe_axpy<float>(n, 0.5f, &a[0], &(*y)[0]);
+      break;
+    case SCALE:
+      caffe_cpu_scale<float>(n, 0.5f, &a[0], &(*y)[0]);
+      break;
+    case SET:
+      caffe_set<float>(n, 1.f, &(*y)[0]);
+      break;
+    case EXP_ELEMENTWISE:
+      caffe_exp<float>(n, &a[0], &(*y)[0]);
+      break;
+    default:
+      LOG(FATAL) << "Unknown function " << function;
+    }
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure the vectorized float math functions.\n"
+        "Usage:\n"
+        "    math_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  CHECK_GT(FLAGS_count, 0);
+  CHECK_GT(FLAGS_iterations, 0);
+  Caffe::set_random_seed(1701);
+#ifdef USE_MKL
+  LOG(WARNING) << "Built with MKL, all instruction sets measure MKL";
+#endif
+
+  // inputs in the ranges of the layers: exp of softmax and ELU inputs, log
+  // of probabilities, pow of LRN scales and tanh of activations
+  vector<float> inputs[NUM_FUNCTIONS];
+  for (int f = 0; f < NUM_FUNCTIONS; ++f) {
+    inputs[f].resize(FLAGS_count);
+  }
+  caffe_rng_uniform<float>(FLAGS_count, -20, 20, &inputs[EXP][0]);
+  caffe_rng_uniform<float>(FLAGS_count, 1e-6, 1, &inputs[LOG][0]);
+  caffe_rng_uniform<float>(FLAGS_count, 1, 10, &inputs[POWX][0]);
+  caffe_rng_uniform<float>(FLAGS_count, -5, 5, &inputs[TANH][0]);
+  vector<float> y(FLAGS_count);
+
+  const VectorMathISA best_isa = vector_math_isa();
+  double scalar_ms[NUM_FUNCTIONS];
+  printf("%-8s %-6s %12s %10s\n", "isa", "func", "ms/call", "speedup");
+  for (int isa = VECTOR_MATH_SCALAR; isa <= VECTOR_MATH_AVX512; ++isa) {
+    if (!vector_math_supports(static_cast<VectorMathISA>(isa))) {
+      continue;
+    }
+    set_vector_math_isa(static_cast<VectorMathISA>(isa));
+    for (int f = 0; f < NUM_FUNCTIONS; ++f) {
+      const double ms = TimeFunction(static_cast<Function>(f), inputs[f], &y);
+      if (isa == VECTOR_MATH_SCALAR) {
+        scalar_ms[f] = ms;
+      }
+      printf("%-8s %-6s %12.3f %10.2f\n",
+          vector_math_isa_name(static_cast<VectorMathISA>(isa)),
+          kFunctionNames[f], ms, scalar_ms[f] / ms);
+    }
+  }
+  set_vector_math_isa(best_isa);
+
+  if (FLAGS_grain_size > 0) {
+    Caffe::set_parallel_grain_size(FLAGS_grain_size);
+  }
+  vector<float> b(FLAGS_count);
+  caffe_rng_uniform<float>(FLAGS_count, 1, 2, &b[0]);
+  double baseline_ms[NUM_ELEMENTWISE_FUNCTIONS];
+  printf("\n%-8s %-6s %12s %10s\n", "threads", "func", "ms/call",
+      "speedup");
+  vector<int> thread_counts;
+  std::istringstream thread_list(FLAGS_threads);
+  for (string item; std::getline(thread_list, item, ','); ) {
+    thread_counts.push_back(atoi(item.c_str()));
+    CHECK_GT(thread_counts.back(), 0) << "Invalid thread count " << item;
+  }
+  for (int t = 0; t < thread_counts.size(); ++t) {
+    Caffe::set_cpu_threads(thread_counts[t]);
+    for (int f = 0; f < NUM_ELEMENTWISE_FUNCTIONS; ++f) {
+      const double ms = TimeElementwise(static_cast<ElementwiseFunction>(f),
+          inputs[EXP], b, &y);
+      if (t == 0) {
+        baseline_ms[f] = ms;
+      }
+      printf("%-8d %-6s %12.3f %10.2f\n", thread_counts[t],
+          kElementwiseNames[f], ms, baseline_ms[f] / ms);
+    }
+  }
+  return 0;
+}
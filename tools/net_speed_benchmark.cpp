@@ -2,6 +2,7 @@
 
 int main(int argc, char** argv) {
   LOG(FATAL) << "Deprecated. Use caffe time --model=... "
-             "[--iterations=50] [--gpu] [--device_id=0]";
+             "[--iterations=50] [--gpu] [--device_id=0] or, for the "
+             "DeepDriving model, torcs_benchmark";
   return 0;
 }
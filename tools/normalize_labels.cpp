@@ -0,0 +1,107 @@
+// This program applies the label_transform of a net's data layer to all
+// float_data labels of a leveldb/lmdb and stores the result in a new db.
+// Training on the normalized db does not need a label_transform anymore.
+// Usage:
+//    normalize_labels [FLAGS] NET_PROTO INPUT_DB OUTPUT_DB
+
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using boost::scoped_ptr;
+using std::string;
+
+DEFINE_string(backend, "leveldb",
+        "The backend {leveldb, lmdb} of the input and output db");
+DEFINE_int32(label_dim, 14,
+        "The number of float_data labels per datum");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Apply the label_transform of the first layer in "
+        "NET_PROTO which specifies one\n"
+        "to the labels of INPUT_DB and store the result in OUTPUT_DB.\n"
+        "Usage:\n"
+        "    normalize_labels [FLAGS] NET_PROTO INPUT_DB OUTPUT_DB\n");
+
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/normalize_labels");
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &net_param);
+  TransformationParameter transform_param;
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    const TransformationParameter& layer_transform =
+        net_param.layer(i).transform_param();
+    if (layer_transform.label_transform_size() > 0) {
+      LOG(INFO) << "Using label_transform of layer "
+                << net_param.layer(i).name();
+      // Only the label transformation is needed, which also avoids loading
+      // the mean file.
+      transform_param.mutable_label_transform()->CopyFrom(
+          layer_transform.label_transform());
+      break;
+    }
+  }
+  CHECK_EQ(transform_param.label_transform_size(), FLAGS_label_dim)
+      << "No layer in " << argv[1] << " specifies a label_transform for all "
+      << FLAGS_label_dim << " labels.";
+  DataTransformer<float> transformer(transform_param, TEST);
+
+  scoped_ptr<db::DB> input_db(db::GetDB(FLAGS_backend));
+  input_db->Open(argv[2], db::READ);
+  scoped_ptr<db::Cursor> cursor(input_db->NewCursor());
+
+  scoped_ptr<db::DB> output_db(db::GetDB(FLAGS_backend));
+  output_db->Open(argv[3], db::NEW);
+  scoped_ptr<db::Transaction> txn(output_db->NewTransaction());
+
+  Datum datum;
+  std::vector<float> labels(FLAGS_label_dim);
+  string out;
+  int count = 0;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+    datum.ParseFromString(cursor->value());
+    transformer.TransformLabel(datum, FLAGS_label_dim, &labels[0]);
+    for (int i = 0; i < FLAGS_label_dim; ++i) {
+      datum.set_float_data(i, labels[i]);
+    }
+    CHECK(datum.SerializeToString(&out));
+    txn->Put(cursor->key(), out);
+
+    if (++count % 1000 == 0) {
+      txn->Commit();
+      txn.reset(output_db->NewTransaction());
+      LOG(INFO) << "Processed " << count << " files.";
+    }
+  }
+  // write the last batch
+  if (count % 1000 != 0) {
+    txn->Commit();
+    LOG(INFO) << "Processed " << count << " files.";
+  }
+  LOG(INFO) << "Remove the label_transform from the data layer when training "
+            << "on " << argv[3] << ", but keep it in the deploy model.";
+  return 0;
+}
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <iomanip>
 
 void ErrorSummary_t::reset()
 {
@@ -69,6 +70,30 @@ void ErrorSummary_t::print(std::ostream &rStream) const
   std::cout << "Loss         : " << calcLoss() << std::endl;
 }
 
+void ErrorSummary_t::printComparison(std::ostream &rStream, ErrorSummary_t const &rReference) const
+{
+  char const * Names[] = {"DistLL", "DistMM", "DistRR", "LL", "ML", "MR", "RR",
+                          "DistL", "DistR", "L", "M", "R", "Angle", "Fast"};
+  float const Errors[] = {DistLL, DistMM, DistRR, LL, ML, MR, RR, DistL, DistR, L, M, R, Angle, Fast};
+  float const References[] = {rReference.DistLL, rReference.DistMM, rReference.DistRR, rReference.LL,
+                              rReference.ML, rReference.MR, rReference.RR, rReference.DistL,
+                              rReference.DistR, rReference.L, rReference.M, rReference.R,
+                              rReference.Angle, rReference.Fast};
+
+  rStream << "Indicator     Reference      Error      Delta" << std::endl;
+  for (int i = 0; i < 14; i++)
+  {
+    rStream << std::left << std::setw(10) << Names[i] << std::right
+            << std::setw(13) << References[i]
+            << std::setw(11) << Errors[i]
+            << std::setw(11) << Errors[i] - References[i] << std::endl;
+  }
+  rStream << std::left << std::setw(10) << "Loss" << std::right
+          << std::setw(13) << rReference.calcLoss()
+          << std::setw(11) << calcLoss()
+          << std::setw(11) << calcLoss() - rReference.calcLoss() << std::endl;
+}
+
 CErrorMeasurement::CErrorMeasurement():
   NumberOfMeasurements(0)
 {
@@ -35,6 +35,9 @@ typedef struct ErrorSummary_t
     float calcLoss() const;
     void print(std::ostream &rStream) const;
 
+    /// @brief Prints the errors next to the reference errors and their difference.
+    void printComparison(std::ostream &rStream, ErrorSummary_t const &rReference) const;
+
 } ErrorSummary_t;
 
 class CErrorMeasurement
@@ -13,13 +13,13 @@
 
 using namespace caffe;
 
-CNeuralNet::CNeuralNet(std::string &rModelPath, std::string &rWeightsPath, std::string &rMeanPath, int GPUDevice)
+CNeuralNet::CNeuralNet(std::string &rModelPath, std::string &rWeightsPath, std::string &rMeanPath, int GPUDevice, bool IsFused)
 {
   boost::filesystem::path ModelPath(rModelPath);
   boost::filesystem::path WeightsPath(rWeightsPath);
   boost::filesystem::path MeanPath(rMeanPath);
 
-  initNetwork(ModelPath, WeightsPath, MeanPath, GPUDevice);
+  initNetwork(ModelPath, WeightsPath, MeanPath, GPUDevice, IsFused);
 
   ProcessTime = 0;
   MaxProcessTime = 0;
@@ -28,9 +28,9 @@ CNeuralNet::CNeuralNet(std::string &rModelPath, std::string &rWeightsPath, std::
   NumberOfInferences = 0;
 }
 
-CNeuralNet::CNeuralNet(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice)
+CNeuralNet::CNeuralNet(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice, bool IsFused)
 {
-  initNetwork(rModelPath, rWeightsPath, rMeanPath, GPUDevice);
+  initNetwork(rModelPath, rWeightsPath, rMeanPath, GPUDevice, IsFused);
 }
 
 CNeuralNet::~CNeuralNet()
@@ -41,7 +41,7 @@ CNeuralNet::~CNeuralNet()
   }
 }
 
-void CNeuralNet::initNetwork(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice)
+void CNeuralNet::initNetwork(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice, bool IsFused)
 {
   if (GPUDevice >= 0)
   {
@@ -53,17 +53,106 @@ void CNeuralNet::initNetwork(boost::filesystem::path &rModelPath, boost::filesys
     Caffe::set_mode(Caffe::CPU);
   }
 
-  pNetwork = new Net<float>(rModelPath.string(), TEST);
+  // Only the output is read after a forward pass, thus the activations can share memory.
+  NetParameter NetParam;
+  ReadNetParamsFromTextFileOrDie(rModelPath.string(), &NetParam);
+  NetParam.mutable_state()->set_phase(TEST);
+  NetParam.set_optimize_memory(true);
+
+  // No backward pass runs, thus max pooling needs no mask.
+  for (int i = 0; i < NetParam.layer_size(); i++)
+  {
+    if (NetParam.layer(i).type() == "Pooling")
+    {
+      NetParam.mutable_layer(i)->mutable_pooling_param()->set_store_mask(false);
+    }
+  }
+
+  // On the CPU the images are copied interleaved to the input, without splitting their channels,
+  // and the first convolution reads them directly.
+  IsInterleaved = GPUDevice < 0 && setInterleavedInput(&NetParam);
+
+  // Quantized weights (of torcs_quantize) store the precision of their layers.
+  NetParameter WeightsParam;
+  bool const IsHDF5 = rWeightsPath.extension() == ".h5";
+  if (!rWeightsPath.empty() && !IsHDF5)
+  {
+    ReadNetParamsFromBinaryFileOrDie(rWeightsPath.string(), &WeightsParam);
+    CopyQuantizationParams(WeightsParam, &NetParam);
+  }
+
+  // On the CPU the ReLUs, BatchNorm and LRN layers are fused into the previous layers,
+  // the fused net already contains the weights.
+  IsFused = IsFused && GPUDevice < 0 && !rWeightsPath.empty() && !IsHDF5;
+  if (IsFused)
+  {
+    NetParameter FusedParam;
+    FuseLayers(NetParam, WeightsParam, &FusedParam);
+    pNetwork = new Net<float>(FusedParam);
+  }
+  else
+  {
+    pNetwork = new Net<float>(NetParam);
+  }
 
   CHECK(pNetwork) << "Could not create a network object!";
 
-  pNetwork->CopyTrainedLayersFrom(rWeightsPath.string());
+  // without weights the initial (filler) weights are kept, e.g. for benchmarks
+  if (IsHDF5)
+  {
+    pNetwork->CopyTrainedLayersFrom(rWeightsPath.string());
+  }
+  else if (!rWeightsPath.empty() && !IsFused)
+  {
+    pNetwork->CopyTrainedLayersFrom(WeightsParam);
+  }
 
   setMean(rMeanPath);
+  setLabelTransform();
+}
+
+bool CNeuralNet::setInterleavedInput(NetParameter * pNetParam)
+{
+  if (pNetParam->layer_size() == 0 || pNetParam->layer(0).type() != "Input")
+  {
+    return false;
+  }
+
+  InputParameter * pInputParam = pNetParam->mutable_layer(0)->mutable_input_param();
+  if (pInputParam->layout() == NHWC)
+  {
+    return true;
+  }
+
+  // N x C x H x W to N x H x W x C
+  for (int i = 0; i < pInputParam->shape_size(); i++)
+  {
+    BlobShape * pShape = pInputParam->mutable_shape(i);
+    if (pShape->dim_size() != 4)
+    {
+      return false;
+    }
+    int const Channels = pShape->dim(1);
+    pShape->set_dim(1, pShape->dim(2));
+    pShape->set_dim(2, pShape->dim(3));
+    pShape->set_dim(3, Channels);
+  }
+  pInputParam->set_layout(NHWC);
+  return true;
 }
 
 void CNeuralNet::setMean(boost::filesystem::path &rMeanPath)
 {
+  if (rMeanPath.empty())
+  {
+    // no mean file, the images are not normalized
+    Blob<float>* pInputLayer = pNetwork->input_blobs()[0];
+    int const Height = pInputLayer->shape(IsInterleaved ? 1 : 2);
+    int const Width  = pInputLayer->shape(IsInterleaved ? 2 : 3);
+    MeanImage = cv::Mat::zeros(Height, Width, CV_32FC3);
+    return;
+  }
+
   BlobProto MeanBinaryBlob;
   ReadProtoFromBinaryFileOrDie(rMeanPath.c_str(), &MeanBinaryBlob);
 
@@ -86,6 +175,29 @@ void CNeuralNet::setMean(boost::filesystem::path &rMeanPath)
   cv::merge(MeanChannels, MeanImage);
 }
 
+void CNeuralNet::setLabelTransform()
+{
+  // The net was trained on labels normalized by the label_transform of the data layer,
+  // thus the inverse transformation must be applied to its output. The run model
+  // stores the same label_transform in its input layer.
+  TransformationParameter const &rTransformParam = pNetwork->layers()[0]->layer_param().transform_param();
+  CHECK_EQ(rTransformParam.label_transform_size(), 14) << "The input layer of the model must specify a label_transform for each of the 14 indicators.";
+
+  LabelScale.clear();
+  LabelShift.clear();
+  for (int i = 0; i < rTransformParam.label_transform_size(); i++)
+  {
+    CHECK_NE(rTransformParam.label_transform(i).scale(), 0) << "The label_transform " << i << " is not invertible.";
+    LabelScale.push_back(rTransformParam.label_transform(i).scale());
+    LabelShift.push_back(rTransformParam.label_transform(i).shift());
+  }
+}
+
+float CNeuralNet::denormalize(const float * pResult, int Index) const
+{
+  return (pResult[Index] - LabelShift[Index]) / LabelScale[Index];
+}
+
 bool CNeuralNet::processBatch(Indicators_t * pResultArray, CLabel * pLabelArray, caffe::db::LevelDBCursor * pCursor, int BatchSize)
 {
   Timer ProcessTimer;
@@ -127,8 +239,9 @@ bool CNeuralNet::processBatch(Indicators_t * pResultArray, CLabel * pLabelArray,
 
   pNetwork->Forward();
 
+  // the times are per image, the sums over all images of the batch
   float Time = (ForwardTimer.MicroSeconds() / 1000000)/BatchSize;
-  ForwardTime += Time;
+  ForwardTime += Time * BatchSize;
   MaxForwardTime = std::max(MaxForwardTime, Time);
 
   for (int i = 0; i < BatchSize; i++)
@@ -137,7 +250,7 @@ bool CNeuralNet::processBatch(Indicators_t * pResultArray, CLabel * pLabelArray,
   }
 
   Time = (ProcessTimer.MicroSeconds() / 1000000)/BatchSize;
-  ProcessTime += Time;
+  ProcessTime += Time * BatchSize;
   MaxProcessTime = std::max(MaxProcessTime, Time);
 
   NumberOfInferences += BatchSize;
@@ -172,6 +285,31 @@ void CNeuralNet::process(Indicators_t * pOutput, CImage &rInputImage)
   NumberOfInferences++;
 }
 
+void CNeuralNet::setInputBatch(CImage * pImageArray, int BatchSize)
+{
+  CHECK(BatchSize > 0) << "Invalid Batch Size";
+
+  resizeInput(pImageArray[0].getImage(), BatchSize);
+
+  for (int i = 0; i < BatchSize; i++)
+  {
+    copyImageToInput(pImageArray[i].getImage(), i);
+  }
+}
+
+void CNeuralNet::forward()
+{
+  pNetwork->Forward();
+}
+
+void CNeuralNet::getOutputBatch(Indicators_t * pOutputArray, int BatchSize)
+{
+  for (int i = 0; i < BatchSize; i++)
+  {
+    copyOutputToIndicators(&pOutputArray[i], i);
+  }
+}
+
 void CNeuralNet::resizeInput(IplImage * pExampleImage, int BatchSize)
 {
   int Height = pExampleImage->height;
@@ -180,10 +318,16 @@ void CNeuralNet::resizeInput(IplImage * pExampleImage, int BatchSize)
   // reshape input layer if necessary
   Blob<float>* pInputLayer = pNetwork->input_blobs()[0];
 
-  if (pInputLayer->num() != BatchSize || pInputLayer->width() != Width || pInputLayer->height() != Height || pInputLayer->channels() != 3)
+  std::vector<int> Shape(4);
+  Shape[0] = BatchSize;
+  Shape[1] = IsInterleaved ? Height : 3;
+  Shape[2] = IsInterleaved ? Width : Height;
+  Shape[3] = IsInterleaved ? 3 : Width;
+
+  if (pInputLayer->shape() != Shape)
   {
     std::cout << "Reshape of input-layer to 3 channels, height " << Height << " and width " << Width << ", witch batch-size " << BatchSize << "." << std::endl;
-    pInputLayer->Reshape(BatchSize, 3, Height, Width);
+    pInputLayer->Reshape(Shape);
     pNetwork->Reshape();
   }
 
@@ -199,19 +343,30 @@ void CNeuralNet::copyImageToInput(IplImage * pImage, int BatchElement)
 
   CHECK(pInputLayer->num() > BatchElement) << "BatchElement Index higher than batch-size of input-layer";
 
-  int BatchOffset = BatchElement * Height * Width * pInputLayer->channels();
+  int BatchOffset = BatchElement * Height * Width * 3;
+  float * pInputData = pInputLayer->mutable_cpu_data();
+  cv::Mat Image(pImage);
+
+  if (IsInterleaved)
+  {
+    // the interleaved input is converted and normalized in place
+    cv::Mat Input(Height, Width, CV_32FC3, &pInputData[BatchOffset]);
+    Image.convertTo(Input, CV_32FC3);
+    Input -= MeanImage;
+
+    CHECK(reinterpret_cast<float*>(Input.data) == &pInputLayer->cpu_data()[BatchOffset]) << "Could not copy the input image to the network!";
+    return;
+  }
 
   // create channels for the input image
-  float * pInputData = pInputLayer->mutable_cpu_data();
   std::vector<cv::Mat> InputChannels;
-  for (int ChannelNumber = 0; ChannelNumber < pInputLayer->channels(); ChannelNumber++)
+  for (int ChannelNumber = 0; ChannelNumber < 3; ChannelNumber++)
   {
     cv::Mat Channel(Height, Width, CV_32FC1, &pInputData[BatchOffset + ChannelNumber * Height * Width]);
     InputChannels.push_back(Channel);
   }
 
   // convert image to float values
-  cv::Mat Image(pImage);
   cv::Mat FloatImage;
   Image.convertTo(FloatImage, CV_32FC3);
 
@@ -234,23 +389,23 @@ void CNeuralNet::copyOutputToIndicators(Indicators_t * pOutput, int BatchElement
 
   int const BatchOffset = BatchElement * 14;
 
-  pOutput->Angle                              = (pResult[BatchOffset + 0]-0.5)*1.1;
+  pOutput->Angle                              = denormalize(&pResult[BatchOffset], 0);
 
-  pOutput->DistanceToLeftMarking              = (pResult[BatchOffset + 1]-1.34445)*5.6249;
-  pOutput->DistanceToCenterMarking            = (pResult[BatchOffset + 2]-0.39091)*6.8752;
-  pOutput->DistanceToRightMarking             = (pResult[BatchOffset + 3]+0.34445)*5.6249;
+  pOutput->DistanceToLeftMarking              = denormalize(&pResult[BatchOffset], 1);
+  pOutput->DistanceToCenterMarking            = denormalize(&pResult[BatchOffset], 2);
+  pOutput->DistanceToRightMarking             = denormalize(&pResult[BatchOffset], 3);
 
-  pOutput->DistanceToLeftObstacle             = (pResult[BatchOffset + 4]-0.12)*95;
-  pOutput->DistanceToRightObstacle            = (pResult[BatchOffset + 5]-0.12)*95;
+  pOutput->DistanceToLeftObstacle             = denormalize(&pResult[BatchOffset], 4);
+  pOutput->DistanceToRightObstacle            = denormalize(&pResult[BatchOffset], 5);
 
-  pOutput->DistanceToLeftMarkingOfLeftLane    = (pResult[BatchOffset + 6]-1.48181)*6.8752;
-  pOutput->DistanceToLeftMarkingOfCenterLane  = (pResult[BatchOffset + 7]-0.98)*6.25;
-  pOutput->DistanceToRightMarkingOfCenterLane = (pResult[BatchOffset + 8]-0.02)*6.25;
-  pOutput->DistanceToRightMarkingOfRightLane  = (pResult[BatchOffset + 9]+0.48181)*6.8752;
+  pOutput->DistanceToLeftMarkingOfLeftLane    = denormalize(&pResult[BatchOffset], 6);
+  pOutput->DistanceToLeftMarkingOfCenterLane  = denormalize(&pResult[BatchOffset], 7);
+  pOutput->DistanceToRightMarkingOfCenterLane = denormalize(&pResult[BatchOffset], 8);
+  pOutput->DistanceToRightMarkingOfRightLane  = denormalize(&pResult[BatchOffset], 9);
 
-  pOutput->DistanceToLeftObstacleInLane       = (pResult[BatchOffset + 10]-0.12)*95;
-  pOutput->DistanceToCenterObstacleInLane     = (pResult[BatchOffset + 11]-0.12)*95;
-  pOutput->DistanceToRightObstacleInLane      = (pResult[BatchOffset + 12]-0.12)*95;
+  pOutput->DistanceToLeftObstacleInLane       = denormalize(&pResult[BatchOffset], 10);
+  pOutput->DistanceToCenterObstacleInLane     = denormalize(&pResult[BatchOffset], 11);
+  pOutput->DistanceToRightObstacleInLane      = denormalize(&pResult[BatchOffset], 12);
 
   if (pResult[BatchOffset + 13]>0.5)
   {
@@ -11,10 +11,13 @@
 #include <boost/filesystem/path.hpp>
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 #include <caffe/caffe.hpp>
 #include "caffe/util/db_leveldb.hpp"
+#include "caffe/util/fuse_layers.hpp"
+#include "caffe/util/quantize.hpp"
 
 #include "Image.hpp"
 #include "Indicators.hpp"
@@ -24,10 +27,11 @@ class CNeuralNet
 {
   public:
     /// @brief Constructor.
-    CNeuralNet(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice);
+    /// @param IsFused If set, the layers of a CPU network with weights are fused (see caffe::FuseLayers()).
+    CNeuralNet(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice, bool IsFused = true);
 
     /// @brief Constructor.
-    CNeuralNet(std::string &rModelPath, std::string &rWeightsPath, std::string &rMeanPath, int GPUDevice);
+    CNeuralNet(std::string &rModelPath, std::string &rWeightsPath, std::string &rMeanPath, int GPUDevice, bool IsFused = true);
 
     /// @brief Destructor.
     ~CNeuralNet();
@@ -39,6 +43,19 @@ class CNeuralNet
     /// @return Returns true, if the last batch was processed.
     bool processBatch(Indicators_t * pResultArray, CLabel * pLabelArray, caffe::db::LevelDBCursor * pCursor, int BatchSize);
 
+    /// @brief Copies a batch of images to the input of the network, the single stages
+    ///        of process() can be measured with this, forward() and getOutputBatch().
+    void setInputBatch(CImage * pImageArray, int BatchSize);
+
+    /// @brief Runs the network on the current input.
+    void forward();
+
+    /// @brief Delivers the output indicators of the last forward().
+    void getOutputBatch(Indicators_t * pOutputArray, int BatchSize);
+
+    /// @return Returns the network.
+    caffe::Net<float> * getNetwork() { return pNetwork; }
+
     float getMaxProcessTime() const;
     float getMeanProcessTime() const;
     float getMaxForwardTime() const;
@@ -48,16 +65,27 @@ class CNeuralNet
   private:
     caffe::Net<float> * pNetwork;
     cv::Mat             MeanImage;
+    /// If set, the input is NHWC, to which the images are copied interleaved.
+    bool  IsInterleaved;
     float ProcessTime;
     float MaxProcessTime;
     float ForwardTime;
     float MaxForwardTime;
     long  NumberOfInferences;
+    std::vector<float> LabelScale;
+    std::vector<float> LabelShift;
 
-    void initNetwork(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice);
+    void initNetwork(boost::filesystem::path &rModelPath, boost::filesystem::path &rWeightsPath, boost::filesystem::path &rMeanPath, int GPUDevice, bool IsFused);
+
+    /// @brief Changes the input layer to the NHWC layout, see caffe::InsertReorders().
+    static bool setInterleavedInput(caffe::NetParameter * pNetParam);
 
     void setMean(boost::filesystem::path &rMeanPath);
 
+    void setLabelTransform();
+
+    float denormalize(const float * pResult, int Index) const;
+
     void copyImageToInput(IplImage * pImage, int BatchElement);
 
     void copyOutputToIndicators(Indicators_t * pOutput, int BatchElement);
@@ -0,0 +1,305 @@
+// This program measures the CPU performance of the DeepDriving model with
+// synthetic inputs, so it needs neither a database nor a GPU:
+//  - the stages of CNeuralNet::process() for the run model (reading the
+//    image from a Datum, copying it to the input, the forward pass, copying
+//    the output to the indicators and the CErrorMeasurement) and
+//  - the forward and backward pass of the train model, whose data layer is
+//    replaced by DummyData,
+// for every batch size of --batch_sizes. The results are written as JSON
+// (see tools/extra/torcs_benchmark.py, which runs it for several thread
+// counts and compares the results against a baseline).
+// Usage:
+//    torcs_benchmark [FLAGS]
+
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iostream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/scoped_array.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/layer_cost.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+#include "torcs/Database.hpp"
+#include "torcs/ErrorMeasurement.hpp"
+#include "torcs/Image.hpp"
+#include "torcs/NeuralNet.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using boost::scoped_array;
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "torcs/pre_trained/driving_run_1F.prototxt",
+        "The run model (empty = skip)");
+DEFINE_string(train_model, "torcs/pre_trained/driving_train_1F.prototxt",
+        "The train model (empty = skip)");
+DEFINE_string(weights, "",
+        "Optional; the weights of the run model (default: random weights)");
+DEFINE_string(mean, "",
+        "Optional; the mean file of the run model (default: zero mean)");
+DEFINE_string(batch_sizes, "1,8,64,128",
+        "The batch sizes to measure, separated by ','");
+DEFINE_int32(iterations, 20,
+        "The number of timed iterations per batch size");
+DEFINE_int32(warmup, 3,
+        "The number of untimed iterations per batch size");
+DEFINE_int32(threads, 0,
+        "The number of BLAS and Caffe CPU threads the benchmark runs with, "
+        "only used to label the results (set OMP_NUM_THREADS, "
+        "CAFFE_CPU_THREADS etc. to change it)");
+DEFINE_string(output, "",
+        "The JSON file to write the results to (default: stdout)");
+
+// The JSON format version, increase it if the meaning of a result changes.
+static const int kFormatVersion = 1;
+static const int kLabelDim = 14;
+// the image size of torcs_record
+static const int kImageHeight = 210;
+static const int kImageWidth = 280;
+
+// Collects the results as JSON objects.
+class Results {
+ public:
+  // Adds the statistics of the times of a stage in ms.
+  void Add(const string& name, int batch_size, const vector<double>& times,
+      double flops) {
+    const TimeStats stats = GetTimeStats(times);
+    std::ostringstream result;
+    result << "{\"name\": \"" << name << "\", \"batch_size\": " << batch_size
+           << ", \"threads\": " << FLAGS_threads
+           << ", \"mean_ms\": " << stats.mean
+           << ", \"median_ms\": " << stats.median
+           << ", \"p99_ms\": " << stats.p99
+           << ", \"median_ms_per_image\": " << stats.median / batch_size;
+    if (flops > 0) {
+      result << ", \"gflops_per_s\": "
+             << (stats.median > 0 ? flops / stats.median / 1e6 : 0);
+    }
+    result << "}";
+    results_.push_back(result.str());
+    LOG(INFO) << name << " batch " << batch_size << ": mean " << stats.mean
+              << " ms, median " << stats.median << " ms, p99 " << stats.p99
+              << " ms";
+  }
+
+  void Write(std::ostream* out) const {
+    *out << "{\n"
+         << "  \"format\": " << kFormatVersion << ",\n"
+         << "  \"threads\": " << FLAGS_threads << ",\n"
+         << "  \"iterations\": " << FLAGS_iterations << ",\n"
+         << "  \"warmup\": " << FLAGS_warmup << ",\n"
+         << "  \"results\": [";
+    for (int i = 0; i < results_.size(); ++i) {
+      *out << (i ? "," : "") << "\n    " << results_[i];
+    }
+    *out << "\n  ]\n}\n";
+  }
+
+ private:
+  vector<string> results_;
+};
+
+// Returns the forward FLOPs of the net.
+static double ForwardFlops(Net<float>* net) {
+  double flops = 0;
+  for (int i = 0; i < net->layers().size(); ++i) {
+    flops += EstimateLayerCost(net->layers()[i].get(), net->bottom_vecs()[i],
+                               net->top_vecs()[i]).forward_flops;
+  }
+  return flops;
+}
+
+// Fills a Datum like torcs_record stores it: a planar BGR image and the
+// 14 indicators as float_data.
+static void FillSyntheticDatum(int height, int width, Datum* datum) {
+  datum->set_channels(3);
+  datum->set_height(height);
+  datum->set_width(width);
+  string* data = datum->mutable_data();
+  data->resize(3 * height * width);
+  for (int i = 0; i < data->size(); ++i) {
+    (*data)[i] = static_cast<char>(caffe_rng_rand() & 0xFF);
+  }
+  datum->clear_float_data();
+  for (int i = 0; i < kLabelDim; ++i) {
+    datum->add_float_data((caffe_rng_rand() % 1000) / 100.0f - 5);
+  }
+}
+
+static void BenchmarkRunModel(int batch_size, Results* results) {
+  string model = FLAGS_model;
+  string weights = FLAGS_weights;
+  string mean = FLAGS_mean;
+  CNeuralNet net(model, weights, mean, -1);
+  if (weights.empty()) {
+    FillerParameter filler_param;
+    filler_param.set_std(0.01);
+    GaussianFiller<float> filler(filler_param);
+    const vector<Blob<float>*>& params = net.getNetwork()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      filler.Fill(params[i]);
+    }
+  }
+
+  vector<Datum> datums(batch_size);
+  for (int i = 0; i < batch_size; ++i) {
+    FillSyntheticDatum(kImageHeight, kImageWidth, &datums[i]);
+  }
+  scoped_array<CImage> images(new CImage[batch_size]);
+  scoped_array<CLabel> labels(new CLabel[batch_size]);
+  scoped_array<Indicators_t> outputs(new Indicators_t[batch_size]);
+  CErrorMeasurement error;
+
+  vector<double> read_times;
+  vector<double> input_times;
+  vector<double> forward_times;
+  vector<double> output_times;
+  vector<double> error_times;
+  vector<double> total_times;
+  CPUTimer timer;
+  CPUTimer total_timer;
+  for (int j = 0; j < FLAGS_warmup + FLAGS_iterations; ++j) {
+    total_timer.Start();
+    timer.Start();
+    for (int i = 0; i < batch_size; ++i) {
+      images[i].readFromDatum(datums[i]);
+      labels[i].readFromDatum(datums[i]);
+    }
+    const double read_time = timer.MicroSeconds() / 1000;
+    timer.Start();
+    net.setInputBatch(images.get(), batch_size);
+    const double input_time = timer.MicroSeconds() / 1000;
+    timer.Start();
+    net.forward();
+    const double forward_time = timer.MicroSeconds() / 1000;
+    timer.Start();
+    net.getOutputBatch(outputs.get(), batch_size);
+    const double output_time = timer.MicroSeconds() / 1000;
+    timer.Start();
+    error.measureBatch(outputs.get(), labels.get(), batch_size);
+    const double error_time = timer.MicroSeconds() / 1000;
+    const double total_time = total_timer.MicroSeconds() / 1000;
+    if (j >= FLAGS_warmup) {
+      read_times.push_back(read_time);
+      input_times.push_back(input_time);
+      forward_times.push_back(forward_time);
+      output_times.push_back(output_time);
+      error_times.push_back(error_time);
+      total_times.push_back(total_time);
+    }
+  }
+  results->Add("run/read_datum", batch_size, read_times, 0);
+  results->Add("run/copy_image_to_input", batch_size, input_times, 0);
+  results->Add("run/forward", batch_size, forward_times,
+               ForwardFlops(net.getNetwork()));
+  results->Add("run/copy_output", batch_size, output_times, 0);
+  results->Add("run/error_measurement", batch_size, error_times, 0);
+  results->Add("run/total", batch_size, total_times, 0);
+}
+
+static void BenchmarkTrainModel(int batch_size, Results* results) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_train_model, &param);
+  param.mutable_state()->set_phase(TRAIN);
+  // The data layers produce constant synthetic images and labels.
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer = param.mutable_layer(i);
+    if (layer->type() != "Data") {
+      continue;
+    }
+    CHECK_EQ(layer->top_size(), 2) << "The data layer " << layer->name()
+                                   << " must have an image and a label top.";
+    layer->set_type("DummyData");
+    layer->clear_data_param();
+    layer->clear_transform_param();
+    DummyDataParameter* dummy_param = layer->mutable_dummy_data_param();
+    FillerParameter* filler = dummy_param->add_data_filler();
+    filler->set_type("constant");
+    filler->set_value(0.5);
+    BlobShape* image_shape = dummy_param->add_shape();
+    image_shape->add_dim(batch_size);
+    image_shape->add_dim(3);
+    image_shape->add_dim(kImageHeight);
+    image_shape->add_dim(kImageWidth);
+    BlobShape* label_shape = dummy_param->add_shape();
+    label_shape->add_dim(batch_size);
+    label_shape->add_dim(kLabelDim);
+  }
+  Net<float> net(param);
+
+  vector<double> times;
+  CPUTimer timer;
+  for (int j = 0; j < FLAGS_warmup + FLAGS_iterations; ++j) {
+    timer.Start();
+    net.ForwardBackward();
+    if (j >= FLAGS_warmup) {
+      times.push_back(timer.MicroSeconds() / 1000);
+    }
+  }
+  double flops = 0;
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const LayerCost cost = EstimateLayerCost(net.layers()[i].get(),
+        net.bottom_vecs()[i], net.top_vecs()[i]);
+    flops += cost.forward_flops + cost.backward_flops;
+  }
+  results->Add("train/forward_backward", batch_size, times, flops);
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure the CPU performance of the DeepDriving "
+        "model with synthetic inputs.\n"
+        "Usage:\n"
+        "    torcs_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  CHECK_GT(FLAGS_iterations, 0);
+  CHECK_GE(FLAGS_warmup, 0);
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(1701);
+
+  vector<int> batch_sizes;
+  std::istringstream batch_list(FLAGS_batch_sizes);
+  for (string item; std::getline(batch_list, item, ','); ) {
+    batch_sizes.push_back(atoi(item.c_str()));
+    CHECK_GT(batch_sizes.back(), 0) << "Invalid batch size " << item;
+  }
+
+  Results results;
+  for (int i = 0; i < batch_sizes.size(); ++i) {
+    if (!FLAGS_model.empty()) {
+      BenchmarkRunModel(batch_sizes[i], &results);
+    }
+    if (!FLAGS_train_model.empty()) {
+      BenchmarkTrainModel(batch_sizes[i], &results);
+    }
+  }
+
+  if (FLAGS_output.empty()) {
+    results.Write(&std::cout);
+  } else {
+    std::ofstream output(FLAGS_output.c_str());
+    CHECK(output) << "Could not open " << FLAGS_output;
+    results.Write(&output);
+    LOG(INFO) << "Wrote results to " << FLAGS_output;
+  }
+  return 0;
+}
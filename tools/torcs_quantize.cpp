@@ -0,0 +1,254 @@
+/*
+ * torcs_quantize.cpp
+ *
+ *  Quantizes the weights of the DeepDriving model after training.
+ */
+
+////////////////////////////////////////////////
+//
+//  Calibrates the input ranges of the InnerProduct
+//  and Convolution layers on a recorded data set,
+//  writes their weights with reduced precision
+//  (int8 or fp16) and compares the error and the
+//  forward time of the quantized and the float
+//  model.
+//
+////////////////////////////////////////////////
+
+#include <glog/logging.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/db_leveldb.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "torcs/Arguments.hpp"
+#include "torcs/NeuralNet.hpp"
+#include "torcs/Database.hpp"
+#include "torcs/ErrorMeasurement.hpp"
+
+using namespace caffe;
+using std::string;
+
+static void printUsage(char * pName)
+{
+  std::cout << "Example: " << std::endl << std::endl;
+  std::cout << pName << " --data pre_trained/TORCS_Training_1F --model pre_trained/driving_run_1F.prototxt --weights pre_trained/weightsfile.caffemodel --mean pre_trained/meanfile.binaryproto --output pre_trained/weightsfile_int8.caffemodel" << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --precision int8|fp16   The precision of the weights (default: int8)." << std::endl;
+  std::cout << "  --layers fc6,fc7        The quantized layers (default: all InnerProduct and Convolution layers)." << std::endl;
+  std::cout << "  --calibration N         The number of images to calibrate the input ranges with (default: 1024)." << std::endl;
+  std::cout << "  --test_data PATH        The data set to compare the errors with (default: --data)." << std::endl;
+  std::cout << "  --images N              The number of images to compare the errors with (default: 2048, 0 = all)." << std::endl;
+  std::cout << "  --batch N               The batch size of the comparison (default: 1)." << std::endl;
+}
+
+/// @brief Reads the next batch from the database and copies it to the input of the network.
+static void readBatch(CNeuralNet &rNeuralNet, db::LevelDBCursor * pCursor, int BatchSize)
+{
+  boost::scoped_array<CImage> Images(new CImage[BatchSize]);
+
+  for (int i = 0; i < BatchSize; i++)
+  {
+    Datum Data;
+    Data.ParseFromString(pCursor->value());
+    Images[i].readFromDatum(Data);
+
+    pCursor->Next();
+    if (!pCursor->valid())
+    {
+      pCursor->SeekToFirst();
+    }
+  }
+
+  rNeuralNet.setInputBatch(Images.get(), BatchSize);
+}
+
+/// @brief Determines the maximum absolute input value of the quantized layers.
+static std::vector<float> calibrate(CNeuralNet &rNeuralNet, std::vector<bool> const &rIsQuantized, string const &rDataPath, int Images)
+{
+  int const BatchSize = 64;
+  Net<float> * pNetwork = rNeuralNet.getNetwork();
+  std::vector<float> InputMax(pNetwork->layers().size(), 0);
+
+  db::LevelDB Database;
+  Database.Open(rDataPath, db::READ);
+  boost::scoped_ptr<db::LevelDBCursor> pCursor(Database.NewCursor());
+  CHECK(pCursor->valid()) << "Database \'" << rDataPath << "\' is empty.";
+
+  for (int Image = 0; Image < Images; Image += BatchSize)
+  {
+    readBatch(rNeuralNet, pCursor.get(), std::min(BatchSize, Images - Image));
+
+    // The layers run one by one, since the memory of their inputs is reused by later layers.
+    for (int i = 0; i < pNetwork->layers().size(); i++)
+    {
+      if (rIsQuantized[i])
+      {
+        Blob<float> const * pBottom = pNetwork->bottom_vecs()[i][0];
+        InputMax[i] = std::max(InputMax[i], caffe_cpu_amax(pBottom->count(), pBottom->cpu_data()));
+      }
+      pNetwork->ForwardFromTo(i, i);
+    }
+  }
+
+  return InputMax;
+}
+
+/// @brief Measures the error of the network on a data set.
+static void evaluate(CNeuralNet &rNeuralNet, CErrorMeasurement &rErrorMeas, string const &rDataPath, int Images, int BatchSize)
+{
+  boost::scoped_array<CLabel> Labels(new CLabel[BatchSize]);
+  boost::scoped_array<Indicators_t> EstimatedIndicators(new Indicators_t[BatchSize]);
+
+  db::LevelDB Database;
+  Database.Open(rDataPath, db::READ);
+  boost::scoped_ptr<db::LevelDBCursor> pCursor(Database.NewCursor());
+  CHECK(pCursor->valid()) << "Database \'" << rDataPath << "\' is empty.";
+
+  bool IsEnd = false;
+  for (int Image = 0; !IsEnd && (Images <= 0 || Image < Images); Image += BatchSize)
+  {
+    IsEnd = rNeuralNet.processBatch(EstimatedIndicators.get(), Labels.get(), pCursor.get(), BatchSize);
+    rErrorMeas.measureBatch(EstimatedIndicators.get(), Labels.get(), BatchSize);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::google::InitGoogleLogging(argv[0]);
+
+  string DataPath    = getArgument(argc, argv, "--data");
+  string ModelPath   = getArgument(argc, argv, "--model");
+  string WeightsPath = getArgument(argc, argv, "--weights");
+  string MeanPath    = getArgument(argc, argv, "--mean");
+  string OutputPath  = getArgument(argc, argv, "--output");
+
+  if (DataPath.empty() || ModelPath.empty() || WeightsPath.empty() || MeanPath.empty() || OutputPath.empty())
+  {
+    std::cout << "Please define the data, the model, its weights and mean file and the output path." << std::endl;
+    printUsage(argv[0]);
+    return -1;
+  }
+
+  string const PrecisionString = getArgument(argc, argv, "--precision");
+  QuantizationParameter::Precision Precision = QuantizationParameter_Precision_INT8;
+  if (PrecisionString == "fp16")
+  {
+    Precision = QuantizationParameter_Precision_FP16;
+  }
+  else if (!PrecisionString.empty() && PrecisionString != "int8")
+  {
+    std::cout << "Unknown precision " << PrecisionString << "." << std::endl;
+    printUsage(argv[0]);
+    return -1;
+  }
+
+  std::set<string> Layers;
+  std::istringstream LayerList(getArgument(argc, argv, "--layers"));
+  for (string Layer; std::getline(LayerList, Layer, ','); )
+  {
+    Layers.insert(Layer);
+  }
+
+  string const CalibrationString = getArgument(argc, argv, "--calibration");
+  int const CalibrationImages = CalibrationString.empty() ? 1024 : atoi(CalibrationString.c_str());
+  string const ImagesString = getArgument(argc, argv, "--images");
+  int const Images = ImagesString.empty() ? 2048 : atoi(ImagesString.c_str());
+  string const BatchString = getArgument(argc, argv, "--batch");
+  int const BatchSize = BatchString.empty() ? 1 : atoi(BatchString.c_str());
+  string TestDataPath = getArgument(argc, argv, "--test_data");
+  if (TestDataPath.empty())
+  {
+    TestDataPath = DataPath;
+  }
+  CHECK_GT(CalibrationImages, 0) << "Invalid number of calibration images.";
+  CHECK_GT(BatchSize, 0) << "Invalid batch size.";
+
+  // not fused, since the weights of its layers are written
+  CNeuralNet FloatNet(ModelPath, WeightsPath, MeanPath, -1, false);
+  Net<float> * pNetwork = FloatNet.getNetwork();
+
+  bool const QuantizeAll = Layers.empty();
+  std::vector<bool> IsQuantized(pNetwork->layers().size(), false);
+  for (int i = 0; i < pNetwork->layers().size(); i++)
+  {
+    LayerParameter const &rLayerParam = pNetwork->layers()[i]->layer_param();
+    if (QuantizeAll)
+    {
+      IsQuantized[i] = rLayerParam.type() == "InnerProduct" || rLayerParam.type() == "Convolution";
+    }
+    else if (Layers.erase(rLayerParam.name()) > 0)
+    {
+      CHECK(rLayerParam.type() == "InnerProduct" || rLayerParam.type() == "Convolution")
+          << "The layer " << rLayerParam.name() << " is no InnerProduct or Convolution layer.";
+      IsQuantized[i] = true;
+    }
+  }
+  CHECK(Layers.empty()) << "Unknown layer " << *Layers.begin() << ".";
+
+  std::vector<float> InputMax;
+  if (Precision == QuantizationParameter_Precision_INT8)
+  {
+    std::cout << "* Calibrate with " << CalibrationImages << " images of " << DataPath << std::endl;
+    InputMax = calibrate(FloatNet, IsQuantized, DataPath, CalibrationImages);
+  }
+
+  NetParameter WeightsParam;
+  pNetwork->ToProto(&WeightsParam, false);
+  CHECK_EQ(WeightsParam.layer_size(), pNetwork->layers().size());
+  for (int i = 0; i < WeightsParam.layer_size(); i++)
+  {
+    if (!IsQuantized[i])
+    {
+      continue;
+    }
+
+    LayerParameter * pLayerParam = WeightsParam.mutable_layer(i);
+    QuantizationParameter * pQuantizationParam = pLayerParam->mutable_quantization_param();
+    pQuantizationParam->set_precision(Precision);
+    if (Precision == QuantizationParameter_Precision_INT8)
+    {
+      pQuantizationParam->set_input_max(InputMax[i]);
+    }
+    // only the weights, the biases are small
+    QuantizeBlobProto(Precision, pLayerParam->mutable_blobs(0));
+
+    std::cout << "* Quantize layer " << pLayerParam->name();
+    if (Precision == QuantizationParameter_Precision_INT8)
+    {
+      std::cout << " (input maximum " << InputMax[i] << ")";
+    }
+    std::cout << std::endl;
+  }
+  WriteProtoToBinaryFile(WeightsParam, OutputPath);
+  std::cout << "* Wrote " << OutputPath << " (" << boost::filesystem::file_size(OutputPath) / 1024
+            << " KB instead of " << boost::filesystem::file_size(WeightsPath) / 1024 << " KB)" << std::endl;
+
+  std::cout << "* Compare the models on " << TestDataPath << std::endl;
+  CErrorMeasurement FloatError;
+  evaluate(FloatNet, FloatError, TestDataPath, Images, BatchSize);
+
+  CNeuralNet QuantizedNet(ModelPath, OutputPath, MeanPath, -1);
+  CErrorMeasurement QuantizedError;
+  evaluate(QuantizedNet, QuantizedError, TestDataPath, Images, BatchSize);
+
+  std::cout << std::endl << "Mean absolute error of " << QuantizedError.getMeasurements() << " images (float model as reference):" << std::endl;
+  QuantizedError.getMeanAbsoluteError().printComparison(std::cout, FloatError.getMeanAbsoluteError());
+  std::cout << std::endl << "Mean forward time per image with batch size " << BatchSize << ": "
+            << FloatNet.getMeanForwardTime() * 1000 << " ms (float), "
+            << QuantizedNet.getMeanForwardTime() * 1000 << " ms (quantized)" << std::endl;
+
+  return 0;
+}